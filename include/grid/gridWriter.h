@@ -30,7 +30,7 @@ class gridWriter
     std::string filename;
  public:
     /** @brief CTor */
-    gridWriter(std::string file);
+    gridWriter(std::string file, std::ios_base::openmode mode = std::ios_base::out);
 
     /** @brief Copy-CTor */
     gridWriter(std::ofstream &stream);
@@ -65,6 +65,7 @@ class ppmWriter : public gridWriter
 /**
  * Class for writing the grid in the parcel-file-format
  * (this writer is used to store each parcel during the convert)
+ * The format is binary, see parcelheader.
  *
  * @author Sebastian Stock, Andre Schemschatt, Uwe Hebbelmann
  * @date 20.2.08
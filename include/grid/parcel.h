@@ -5,6 +5,22 @@
 #include <string>
 using std::string;
 
+/** Identifies a parcel file in the binary format */
+#define PARCEL_MAGIC "3DTKPCL"
+
+/**
+ * Header of a parcel file in the binary format. It is followed by
+ * sizeX * sizeZ pairs of unsigned int (count, occupied), ordered
+ * by x first.
+ */
+struct parcelheader {
+    char magic[8];
+    long long offsetX;
+    long long offsetZ;
+    long long sizeX;
+    long long sizeZ;
+};
+
 /**
  * The class represents a section of the map and inherrits grid.
  * The grids will be added to the parcel
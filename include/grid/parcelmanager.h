@@ -2,23 +2,35 @@
 #define __PARCELMANAGER_H_
 
 #include <string>
-#include <map>
-using std::map;
+#include <list>
+#include <utility>
+#include <unordered_map>
 
 #include "grid/parcel.h"
 #include "grid/parcelinfo.h"
 #include <string>
 using std::string;
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 
 #define PARCELINFOFILE "parcelinfo.conf"
 
+/** Default memory for the parcels kept in memory (bytes) */
+#define PARCELMEMORY (512*1024*1024)
+
 /**
  * The parcelmanager manages all views of the map 
  * (Views are represented as parcels)
  * It provides methods for adding scangrids and creating the entire map.
  * It contains an internal memorymanagment for managing the parcels 
  * during runtime.
+ * The parcels are hashed by their integer tile coordinates. Loaded
+ * parcels are kept in an LRU list until the memory budget is exhausted.
+ * Evicted parcels that have been changed are written back by a
+ * background thread, unchanged parcels are simply dropped.
  * 
  * 
  * @author Uwe Hebbelmann, Sebastian Stock, Andre Schemschat
@@ -27,12 +39,55 @@ using std::string;
 class parcelmanager
 {
  private:
+    /** Tile coordinates of a parcel (offset divided by the parcel size) */
+    typedef std::pair<long, long> tilekey;
+
+    /** Hash function for the tile coordinates */
+    struct tilehash {
+	inline size_t operator()(const tilekey &k) const {
+	    return (size_t)k.first * 73856093u ^ (size_t)k.second * 19349663u;
+	}
+    };
+
+    /** A parcel known to the parcelmanager */
+    struct tile {
+	/** The information about the parcel */
+	parcelinfo *info;
+	/** The parcel, NULL if it is not in memory */
+	parcel *data;
+	/** true if data has been changed since it was read */
+	bool dirty;
+	/** Position in the LRU list, valid if data is loaded */
+	std::list<tilekey>::iterator lru;
+    };
+
     /** Typedef for the map */
-    typedef map<parcelinfo*, parcel*> parcelmap;
+    typedef std::unordered_map<tilekey, tile, tilehash> parcelmap;
     
     /** The map for all parcelinfos and parcels */
     parcelmap parcels;
 
+    /** Loaded parcels, most recently used first */
+    std::list<tilekey> lru;
+
+    /** Maximal number of parcels kept in memory, including queued ones */
+    size_t cachesize;
+
+    /** Evicted parcels waiting to be written (filename, parcel) */
+    std::list<std::pair<string, parcel*> > pending;
+    /** The file the writer thread is writing at the moment */
+    string writing;
+    /** Set to terminate the writer thread */
+    bool stop;
+    /** Protects pending, writing and stop */
+    boost::mutex mutex;
+    /** Signals new work for the writer thread */
+    boost::condition_variable wakeup;
+    /** Signals a finished write */
+    boost::condition_variable written;
+    /** The writer thread */
+    boost::thread writer;
+
     /** The width of each parcel */
     int parcelwidth;
     /** The height of each parcel */
@@ -60,24 +115,40 @@ class parcelmanager
     /** The path where all infos should be stored */
     string path;
 
-    /** @brief The method frees each (not used) parcel */ 
+    /** @brief The method frees least recently used parcels */ 
     void freeMemory(bool all);
 
+    /** @brief Number of loaded and queued parcels */
+    size_t parcelsInMemory() const;
+
     /** @brief The method clears all internal data */
     void clear();
 
-    /** @brief The method loads a parcel specified by info */
-    void loadParcel(parcelinfo *info);
+    /** @brief The method loads a parcel specified by its tile */
+    parcel* loadParcel(const tilekey &key, tile &t);
 
     /** @brief The method creates a new parcel */
-    void createParcel(long x, long z);
+    tile& createParcel(const tilekey &key);
+
+    /** @brief Queues a parcel for writing */
+    void writeParcel(const string &filename, parcel *p);
+
+    /** @brief Takes a parcel back from the write queue */
+    parcel* reclaimParcel(const string &filename);
+
+    /** @brief Waits until all queued parcels are written */
+    void flush();
+
+    /** @brief Writes the queued parcels in the background */
+    void writerThread();
 
     /** @brief Method keeps min/Max-X/Z up to date */
     void updateOuterPoints(const grid* g);
 
  public:
     /** @brief CTor */
-    parcelmanager(long width, long height, string path, int resolution, bool resume);
+    parcelmanager(long width, long height, string path, int resolution,
+		  bool resume, size_t memory = PARCELMEMORY);
 
     /** @brief Dtor */
     ~parcelmanager();
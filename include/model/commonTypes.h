@@ -16,6 +16,7 @@
 #include "model/rotation3d.h"
 
 #include <utility>
+#include <vector>
 
 //==============================================================================
 //  Typedefs
@@ -27,6 +28,40 @@ typedef std::pair<model::Point3d, model::Rotation3d> Pose6d;
 // the maximum image value
 static const int MAX_IMG_VAL = 255;
 
+/**
+ * A matrix stored row by row in one contiguous buffer, so it can be wrapped
+ * by a cv::Mat without copying. m[i][j] is the element in row i, column j.
+ */
+template <class T>
+class Matrix2d {
+private:
+    int nrows;
+    int ncols;
+    std::vector<T> buf;
+
+public:
+    Matrix2d() : nrows(0), ncols(0) {}
+
+    /**
+     * Resizes the matrix, all elements are set to the given value.
+     */
+    void resize(int rows, int cols, const T& value = T()) {
+        nrows = rows;
+        ncols = cols;
+        buf.assign(static_cast<size_t>(rows) * cols, value);
+    }
+
+    inline int rows() const { return nrows; }
+    inline int cols() const { return ncols; }
+    inline bool empty() const { return buf.empty(); }
+
+    inline T* operator[](int i) { return &buf[static_cast<size_t>(i) * ncols]; }
+    inline const T* operator[](int i) const { return &buf[static_cast<size_t>(i) * ncols]; }
+
+    inline T* data() { return buf.empty() ? NULL : &buf[0]; }
+    inline const T* data() const { return buf.empty() ? NULL : &buf[0]; }
+};
+
 } /* namespace model */
 
 #endif /* COMMONTYPES_H_ */
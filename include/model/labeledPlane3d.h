@@ -73,15 +73,20 @@ private:
 
 public:
     /**
-     * Each discrete patch is described in this matrix.
+     * The center of each discrete patch.
      */
-    std::vector<std::vector<std::pair<model::Point3d, Label> > > patches;
+    Matrix2d<model::Point3d> patches;
+
+    /**
+     * The Label of each discrete patch.
+     */
+    Matrix2d<unsigned char> labels;
 
     /**
      * Remember a depth map of the plane to be used when detecting the windows.
      * To be built in the same time when applying labels.
      */
-    std::vector<std::vector<double> > depthMap;
+    Matrix2d<double> depthMap;
 
     /**
      * The OpenCV image of the depthMap.
@@ -110,6 +115,22 @@ public:
     // operators
     LabeledPlane3d& operator=(const LabeledPlane3d& other);
 
+    /**
+     * Returns the labels as CV_8UC1 image, sharing the memory of the labels.
+     */
+    inline cv::Mat getLabelImg() const {
+        return cv::Mat(labels.rows(), labels.cols(), CV_8UC1,
+                const_cast<unsigned char*>(labels.data()));
+    }
+
+    /**
+     * Returns the depth map as CV_64FC1 image, sharing the memory of the depth map.
+     */
+    inline cv::Mat getDepthMapImg() const {
+        return cv::Mat(depthMap.rows(), depthMap.cols(), CV_64FC1,
+                const_cast<double*>(depthMap.data()));
+    }
+
     /**
      * Computes the Canny for this wall using the depth image.
      */
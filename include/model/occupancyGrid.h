@@ -0,0 +1,126 @@
+/**
+ * @file occupancyGrid.h
+ *
+ * @date 18 Oct 2026
+ *
+ */
+
+#ifndef OCCUPANCYGRID_H_
+#define OCCUPANCYGRID_H_
+
+//==============================================================================
+//  Includes
+//==============================================================================
+#include "model/point3d.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace model {
+
+/**
+ * A sparse voxel grid over the lattice of a discrete line, i.e. the points
+ * n / 10^precision for integer n. A lattice point is marked if some point of
+ * the cloud lies in the cube of the given width centered at it, or close to
+ * its border, so unmarked lattice points are certainly empty. The lattice is
+ * stored in bricks of BRICK^3 bits, empty bricks are not stored at all.
+ */
+class OccupancyGrid {
+public:
+    static const int BRICK = 8;                //!< Edge length of a brick in lattice points.
+
+    /** A triple of lattice or brick coordinates. */
+    struct Key {
+        long long x, y, z;
+
+        inline bool operator==(const Key& other) const {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    /** BRICK^3 bits, x varies slowest. */
+    struct Brick {
+        unsigned long long bits[BRICK * BRICK * BRICK / 64];
+    };
+
+private:
+    struct KeyHash {
+        inline size_t operator()(const Key& k) const {
+            return (size_t)(k.x * 73856093LL ^ k.y * 19349663LL ^ k.z * 83492791LL);
+        }
+    };
+
+    double coef;                                        //!< 10^precision, lattice points per unit.
+    std::vector<Brick> bricks;                          //!< All non-empty bricks.
+    std::unordered_map<Key, unsigned int, KeyHash> index; //!< Brick coordinates to position in bricks.
+
+public:
+    /**
+     * Marks all lattice points whose cube of the given width may contain
+     * one of the points.
+     */
+    OccupancyGrid(double **points, unsigned int nrPoints, double precision, double width);
+
+    /**
+     * @return the lattice points per unit
+     */
+    inline double getCoef() const { return coef; }
+
+    /**
+     * @return the brick containing the lattice point, NULL if it is empty
+     */
+    const Brick* getBrick(const Key& pt) const;
+
+    /**
+     * @return true if the lattice point is marked in its brick
+     */
+    static bool isMarked(const Brick* brick, const Key& pt);
+
+    /**
+     * @return the brick coordinate of a lattice coordinate
+     */
+    static inline long long brickOf(long long n) {
+        return n >= 0 ? n / BRICK : -((BRICK - 1 - n) / BRICK);
+    }
+};
+
+/**
+ * The 3d Bresenham line of GraphicsAlg::getDiscreteLine, walked through an
+ * OccupancyGrid. The line is not materialized, empty bricks are skipped in
+ * one step in the manner of Amanatides and Woo, only with the positions of
+ * the discrete line computed in closed form instead of the exact ray.
+ */
+class DiscreteRay {
+private:
+    long long start[3];     //!< First lattice point.
+    long long sign[3];      //!< Direction of each axis.
+    long long delta[3];     //!< Twice the absolute difference along each axis.
+    long long err[3];       //!< Initial decision variable of each axis.
+    int dom;                //!< Index of the dominant axis.
+    long long length;       //!< Number of steps along the dominant axis.
+    long long step;         //!< Index of the current lattice point.
+    double coef;            //!< 10^precision, lattice points per unit.
+
+    /** @return number of steps along axis a before lattice point k */
+    long long moved(int a, long long k) const;
+
+    /** @return the first lattice point with at least m steps along axis a */
+    long long reached(int a, long long m) const;
+
+public:
+    /**
+     * Prepares the same line as GraphicsAlg::getDiscreteLine would compute.
+     * Only a non-negative precision is supported.
+     */
+    DiscreteRay(Point3d src, Point3d dest, double precision, const double& extraDist);
+
+    /**
+     * Advances to the next point of the line that is marked in the grid.
+     * @return false if the end of the line has been reached
+     */
+    bool nextCandidate(const OccupancyGrid& grid, Point3d& pt);
+};
+
+} /* namespace model */
+
+#endif /* OCCUPANCYGRID_H_ */
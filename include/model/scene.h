@@ -15,6 +15,7 @@
 #include "model/point3d.h"
 #include "model/vector3d.h"
 #include "model/labeledPlane3d.h"
+#include "model/occupancyGrid.h"
 
 #include "shapes/hough.h"
 #include "shapes/shape.h"
@@ -55,6 +56,7 @@ public:
     SearchTree *octTree;               //!< An efficient octree containing the points.
     double **octTreePoints;            //!< Used to construct the octree.
     unsigned int nrPoints;             //!< The total number of points in the octree.
+    OccupancyGrid *occupancy;          //!< Lattice points of the rays that may hit a point.
 
     std::vector<Point3d> points;       //!< The 3d point cloud.
     std::vector<Plane3d> planes;       //!< The list of planes in our scene.
@@ -80,6 +82,7 @@ public:
     {
         if (!quiet) cout << "== Creating scene..." << endl;
         this->nrPoints = 0;
+        this->occupancy = NULL;
     };
 
     Scene(const IOType& type,
@@ -121,11 +124,12 @@ public:
 
     /**
      * Performs ray casting from source point to destination and returns true
-     * if the ray successfully reached the destination point, returning the
-     * point it hit along the way.
+     * if the ray hit something before reaching the destination point, returning
+     * the point it hit along the way. Only the points of the line marked in the
+     * occupancy grid are looked up in the octree.
      */
     bool castRay(const model::Point3d& src, const model::Point3d& dest, const double& extraDist,
-            Point3d& ptHit);
+            Point3d& ptHit, int threadNum = 0);
 
     /**
      * Applies labels to the given plane.
@@ -189,7 +193,7 @@ private:
     /**
      * Returns true if the cube centered at the given coordinates is occupied.
      */
-    bool isOccupied(const Point3d& center, const double& width);
+    bool isOccupied(const Point3d& center, const double& width, int threadNum = 0);
 
 };
 
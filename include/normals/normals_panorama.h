@@ -23,8 +23,7 @@ using std::vector;
 
 void calculateNormalsPANORAMA(vector<Point> &normals,
                               vector<Point> &points,
-                              const vector< vector< vector< cv::Vec3f > > >
-                              extendedMap,
+                              const fbr::extended_map &extendedMap,
                               const double _rPos[3]);
 
 // see paper
@@ -35,8 +34,7 @@ void calculateNormalsFAST(vector<Point> &normals,
                           const cv::Mat &img,
                           const float max,
 					 const double _rPos[3],
-                          const vector< vector< vector <cv::Vec3f> > >
-                          &extendedMap);
+                          const fbr::extended_map &extendedMap);
 
 // TODO should be exported to separate library
 /*
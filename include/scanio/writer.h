@@ -2,10 +2,16 @@
 #define __SCAN_IO_WRITER_H__
 
 #include <iostream>
+#include <vector>
+#include <list>
 #include "slam6d/pointfilter.h"
 #include "slam6d/io_types.h"
 #include "slam6d/fbr/scan_cv.h"
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 void createdirectory(string dir);
 void write_uos(vector<cv::Vec4f> &points, string &dir, string id);
 void write_uosr(vector<cv::Vec4f> &points, string &dir, string id);
@@ -21,4 +27,87 @@ void writeposefile(string &dir, const double* rPos, const double* rPosTheta, str
 void writeTrajectoryXYZ(ofstream &posesout, const double * transMat, bool mat, double scaleFac = 0.01);
 void writeTrajectoryUOS(ofstream &posesout, const double * transMat, bool mat);
 
+/** Default memory for formatted points waiting to be written (bytes) */
+#define EXPORTMEMORY (256*1024*1024)
+
+/**
+ * Writes the points of a sequence of scans into one file, either as text
+ * in the same format as write_uos, write_uosr, write_uos_rgb, write_xyz,
+ * write_xyzr and write_xyz_rgb or as binary little endian PLY.
+ * The points of each scan are formatted in blocks on all threads, the
+ * finished blocks are written in order by a separate writer thread.
+ */
+class ExportWriter {
+public:
+  /** Attributes written after the coordinates of a point */
+  enum Attributes { NONE, REFLECTANCE, COLOR };
+
+  /**
+   * @param file the output file, opened in binary mode for PLY
+   * @param attributes the attributes of each point
+   * @param xyz convert the coordinates like write_xyz
+   * @param scaleFac the scale factor for xyz
+   * @param ply write binary PLY instead of text
+   * @param memory the memory for blocks waiting to be written (bytes)
+   */
+  ExportWriter(ofstream &file, Attributes attributes, bool xyz,
+               double scaleFac, bool ply, size_t memory = EXPORTMEMORY);
+
+  /** Writes all remaining blocks */
+  ~ExportWriter();
+
+  /**
+   * Writes the PLY header, has to be called before the first scan. The
+   * vertex count is a fixed width field that flush() fills in with the
+   * number of points written so far.
+   */
+  void writeHeader();
+
+  /**
+   * Formats the points of a scan and queues them for writing. As in
+   * write_uosr and write_uos_rgb, nothing is written if the attributes
+   * don't match the points.
+   */
+  void write(DataXYZ &xyz, DataReflectance *reflectance = 0, DataRGB *rgb = 0);
+
+  /**
+   * Waits until all queued blocks are written and updates the vertex
+   * count of the PLY header
+   */
+  void flush();
+
+private:
+  void writerThread();
+  void push(std::vector<char> *block);
+  char *format(char *out, DataXYZ &xyz, DataReflectance *reflectance,
+               DataRGB *rgb, unsigned int i);
+
+  ofstream &file;
+  Attributes attributes;
+  bool xyz;
+  double scaleFac;
+  bool ply;
+  size_t memory;
+
+  /** Number of points passed to the writer thread */
+  unsigned long long nrPoints;
+  /** Position of the vertex count in the file, -1 without header */
+  std::streamoff countPos;
+
+  /** Formatted blocks waiting to be written, in order */
+  std::list<std::vector<char>*> pending;
+  /** Bytes in pending and in the block being written */
+  size_t pendingBytes;
+  /** Set to terminate the writer thread */
+  bool stop;
+  /** Protects pending, pendingBytes and stop */
+  boost::mutex mutex;
+  /** Signals new work for the writer thread */
+  boost::condition_variable wakeup;
+  /** Signals a finished write */
+  boost::condition_variable written;
+  /** The writer thread */
+  boost::thread writer;
+};
+
 #endif
@@ -14,19 +14,17 @@
 #define __FHGRAPH_H__
 
 #include <vector>
-#include <list>
 
 #include <slam6d/point.h>
 #include <slam6d/scan.h>
 #include <segmentation/segment-graph.h>
-#include <ANN/ANN.h>
+#include <slam6d/kdIndexed.h>
 
 class FHGraph {
 public:
   FHGraph(std::vector< Point > *ps,
 		double weight(Point, Point),
 		double sigma,
-		double eps,
 		int neighbors,
 		float radius);
   edge* getGraph();
@@ -37,9 +35,10 @@ public:
   void dispose();
 
 private:
-  void compute_neighbors(double weight(Point, Point), double eps);
+  void compute_neighbors(double weight(Point, Point));
   void do_gauss(double sigma);
   void without_gauss();
+  void dispose_adjency();
 
   std::vector<edge> edges;
   std::vector< Point > *pts;
@@ -50,7 +49,10 @@ private:
   float radius;
 
   struct he{ int x; float w; };
-  std::vector< std::list<he> > adjency_list;
+  // the neighbors of point i are adjency[adjency_start[i]] up to
+  // adjency[adjency_start[i+1]]
+  std::vector<size_t> adjency_start;
+  std::vector<he> adjency;
 };
 
 #endif
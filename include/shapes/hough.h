@@ -52,8 +52,8 @@ public:
   void APHT();
 
   //vector<ConvexPlane>& getPlanes();
-  bool distanceOK(Point p1, Point p2, Point p3);
-  bool calculatePlane(Point p1, Point p2, Point p3, double &theta, double &phi, double &rho); 
+  bool distanceOK(const Point &p1, const Point &p2, const Point &p3);
+  bool calculatePlane(const Point &p1, const Point &p2, const Point &p3, double &theta, double &phi, double &rho); 
 
   double * const* deletePoints(vector<ConvexPlane*> &model, int &size); 
   double * const* getPoints(int &size);
@@ -5,35 +5,126 @@
 #include "slam6d/scan.h"
 #include "shapes/ransac_Boctree.h"
 
-// TODO implement some parameters to modify ransac (maybe in CollisionShape?)
+#include <math.h>
+
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+/**
+ * Parameters of the RANSAC engine
+ */
+struct RansacParameters {
+  RansacParameters()
+    : maxIterations(5000), confidence(0.99), preTest(1), batch(64) {}
+
+  /** upper bound for the number of hypotheses */
+  int maxIterations;
+  /** probability to have drawn at least one sample of inliers only */
+  double confidence;
+  /** d of the T(d,d) test, a hypothesis is scored only if d random points
+   *  all lie on it, 0 scores every hypothesis */
+  int preTest;
+  /** hypotheses evaluated in parallel before the iteration count is
+   *  updated from the best inlier ratio */
+  int batch;
+};
+
+/**
+ * Number of hypotheses needed to draw a sample of m inliers with the given
+ * confidence, if a fraction w of all points are inliers. With the T(d,d)
+ * test a good hypothesis survives only with probability w^d.
+ */
+inline int RansacIterations(double confidence, double w, int m, int d,
+                            int maxIterations)
+{
+  double good = pow(w, m + d);
+  if (good <= 0.0) return maxIterations;
+  if (good >= 1.0) return 1;
+  double n = log(1.0 - confidence) / log(1.0 - good);
+  return n < maxIterations ? (int)ceil(n) : maxIterations;
+}
+
+/**
+ * Fits the shape to the reduced points of the scan. The hypotheses are
+ * evaluated in parallel, each thread on its own copy of the shape. Before
+ * a hypothesis is scored against all points in the octree it has to pass
+ * the T(d,d) test of Chum and Matas, and the number of hypotheses shrinks
+ * with the inlier ratio of the best shape found so far.
+ */
 template <class T>
-void Ransac(CollisionShape<T> &shape, Scan *scan, vector<T*> *best_points = 0) {
-  int best_score = 0;
+void Ransac(CollisionShape<T> &shape, Scan *scan, vector<T*> *best_points = 0,
+            const RansacParameters &param = RansacParameters()) {
+  long best_score = 0;
   CollisionShape<T> *best = shape.copy();
 
-  // stores 3 sample points    
-  vector<T *> ps;
   // create octree from the points
   DataXYZ xyz(scan->get("xyz reduced"));
-  RansacOctTree<T> *oct = new RansacOctTree<T>(PointerArray<double>(xyz).get(), xyz.size(), 50.0 );
-  cout << "start 5000 iterations" << endl;
-  for(int i = 0; i < 5000; i++) {
-    ps.clear();
-    // randomly select points from the octree
-    oct->DrawPoints(ps, shape.getNrPoints());
-    // compute shape parameters from points
-    if ( shape.hypothesize(ps) ) {
-      // count number of points on the shape
-      int r = oct->PointsOnShape(shape);
-      if (r > best_score) {
-        if (best) delete best;
-        // remember this best fitted shape
-        best_score = r;
-        best = shape.copy();
+  PointerArray<double> pts(xyz);
+  double * const* points = pts.get();
+  int nrpts = xyz.size();
+  RansacOctTree<T> *oct = new RansacOctTree<T>(points, nrpts, 50.0 );
+
+  int needed = param.maxIterations;
+  int done = 0;
+  cout << "start at most " << needed << " iterations" << endl;
+  while (done < needed && nrpts > 0) {
+    int nr = needed - done < param.batch ? needed - done : param.batch;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+      CollisionShape<T> *hypothesis = shape.copy();
+      // stores 3 sample points
+      vector<T *> ps;
+      unsigned int seed;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      seed = rand();
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+      for (int i = 0; i < nr; i++) {
+        ps.clear();
+        // randomly select points from the octree
+        oct->DrawPoints(ps, shape.getNrPoints(), seed);
+        // compute shape parameters from points
+        if ( !hypothesis->hypothesize(ps) ) continue;
+
+        // test a few random points before counting all of them
+        bool pass = true;
+        for (int k = 0; k < param.preTest && pass; k++) {
+          seed = seed * 1103515245u + 12345u;
+          pass = hypothesis->containsPoint(points[(seed >> 8) % nrpts]);
+        }
+        if (!pass) continue;
+
+        // count number of points on the shape
+        long r = oct->PointsOnShape(*hypothesis);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        if (r > best_score) {
+          if (best) delete best;
+          // remember this best fitted shape
+          best_score = r;
+          best = hypothesis->copy();
+        }
       }
+      delete hypothesis;
     }
+
+    done += nr;
+    needed = RansacIterations(param.confidence, (double)best_score / nrpts,
+                              shape.getNrPoints(), param.preTest,
+                              param.maxIterations);
   }
-  cout << "5000 iterations done" << endl;
+  cout << done << " iterations done" << endl;
   if (best_points) {
     best_points->clear();
     oct->PointsOnShape(*best, *best_points);
@@ -48,7 +48,15 @@ public:
   RansacOctTree(std::string filename) : BOctTree<T> (filename) {}
 
   void DrawPoints(vector<T *> &p, unsigned char nrp) {
-    DrawPoints(p, *BOctTree<T>::root, nrp);
+    DrawPoints(p, *BOctTree<T>::root, nrp, 0);
+  }
+
+  /**
+   * Same as above, but draws from the given random state instead of the
+   * global rand(), so that several threads can draw at the same time.
+   */
+  void DrawPoints(vector<T *> &p, unsigned char nrp, unsigned int &seed) {
+    DrawPoints(p, *BOctTree<T>::root, nrp, &seed);
   }
  
 
@@ -167,11 +175,20 @@ void showbits(char a)
   }
 
 
-  void DrawPoints(vector<T *> &p, bitoct &node, unsigned char nrp) {
+  /**
+   * random number in [0..rnd], from the global rand() if there is no seed
+   */
+  static inline int drawIndex(int rnd, unsigned int *seed) {
+    if (!seed) return rand(rnd);
+    *seed = *seed * 1103515245u + 12345u;
+    return (int) ((double)rnd * (*seed >> 8) * (1.0/16777216.0));
+  }
+
+  void DrawPoints(vector<T *> &p, bitoct &node, unsigned char nrp, unsigned int *seed) {
     bitunion<T> *children;
     bitoct::getChildren(node, children);
     unsigned char n_children = POPCOUNT(node.valid);
-    unsigned char r = randUC(n_children);
+    unsigned char r = drawIndex(n_children, seed);
     if (r == n_children) r--;
 
 /*    cout << (unsigned int)r << " nc " << (unsigned int)n_children << endl;
@@ -230,7 +247,7 @@ void showbits(char a)
       }
       // randomly get nrp points, we will not check if this succeeds in getting nrp distinct points
       for (char c = 0; c < nrp; c++) {
-        int tmp = rand(points[0].length);
+        int tmp = drawIndex(points[0].length, seed);
         p.push_back(&(points[BOctTree<T>::POINTDIM*tmp+1].v));
       }
     } else {
@@ -240,7 +257,7 @@ void showbits(char a)
     showbits(node.leaf);
     cout << endl;
       cout << "RECURSED" << endl;*/
-      DrawPoints(p, children[r].node, nrp);
+      DrawPoints(p, children[r].node, nrp, seed);
     }
   }
 
@@ -197,6 +197,39 @@ class ColorManager {
       glTexCoord1f( (float)((val[currentdim]-min)/extent) );
     }
 
+    /**
+     * Enables coloring of points drawn by glDrawArrays, the texture matrix
+     * maps the raw values the same way setColor() does.
+     * Call between load() and unload().
+     */
+    virtual void enableArrays() {
+      glMatrixMode(GL_TEXTURE);
+      glPushMatrix();
+      glLoadIdentity();
+      glScalef(1.0/extent, 1.0, 1.0);
+      glTranslatef(-min, 0.0, 0.0);
+      glMatrixMode(GL_MODELVIEW);
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+
+    virtual void disableArrays() {
+      glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+      glMatrixMode(GL_TEXTURE);
+      glPopMatrix();
+      glMatrixMode(GL_MODELVIEW);
+    }
+
+    /**
+     * Sets the color source for glDrawArrays to interleaved points
+     * @param type GL_FLOAT or GL_DOUBLE
+     * @param stride distance between two points in bytes
+     * @param pts first point, or offset in the bound vertex buffer
+     */
+    virtual void setColorPointer(GLenum type, GLsizei stride, const GLvoid *pts) {
+      unsigned int size = type == GL_DOUBLE ? sizeof(GLdouble) : sizeof(GLfloat);
+      glTexCoordPointer(1, type, stride, (const char*)pts + currentdim*size);
+    }
+
     virtual void setColorMap(ColorMap &cm) {
       for (unsigned int i = 0; i < buckets; i++) {
         cm.calcColor(colormap[i], i, buckets);
@@ -313,6 +346,20 @@ class CColorManager : public ColorManager {
       glColor3ubv(color); 
     }
 
+    virtual void enableArrays() {
+      glEnableClientState(GL_COLOR_ARRAY);
+    }
+
+    virtual void disableArrays() {
+      glDisableClientState(GL_COLOR_ARRAY);
+    }
+
+    // the color bytes are stored in place of the value at colordim
+    virtual void setColorPointer(GLenum type, GLsizei stride, const GLvoid *pts) {
+      unsigned int size = type == GL_DOUBLE ? sizeof(GLdouble) : sizeof(GLfloat);
+      glColorPointer(3, GL_UNSIGNED_BYTE, stride, (const char*)pts + colordim*size);
+    }
+
   private:
     unsigned int colordim;
     GLboolean color_state;
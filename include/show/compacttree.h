@@ -194,6 +194,8 @@ public:
   inline long countNodes();
   inline long countLeaves(); 
   void setColorManager(ColorManager *_cm);
+  //! Register a tree that was constructed without a ScanColorManager
+  void registerColorManager(ScanColorManager *scm);
   void drawLOD(float lod);
   void draw();
   void displayOctTree(double minsize = FLT_MAX);
@@ -205,6 +207,11 @@ public:
   inline void getCenter(double center[3]) const;
 
   void serialize(std::string filename);
+
+  //! Memory occupied by the tree in bytes
+  unsigned long int getMemorySize() const {
+    return sizeof(*this) + alloc->getSize();
+  }
 protected:
   
   Allocator* alloc;
@@ -0,0 +1,147 @@
+/**
+ * @file
+ * @brief Out-of-core level of detail hierarchy for show
+ *
+ * The point cloud of a whole campaign is split offline by lod_build into
+ * nested octree nodes. Each node holds a sparse subsample of the points in
+ * its cell and its children hold the remaining points, i.e., a node drawn
+ * together with any subset of its descendants never duplicates points.
+ * show keeps the small node index in memory and streams the point chunks
+ * of the visible nodes from disk by their screen space error.
+ *
+ * The files are written in native byte order:
+ *   lod.idx  LODHeader followed by LODHeader::nrnodes LODNode records,
+ *            the root node comes first
+ *   lod.pts  LODPoint records of all nodes, one contiguous run per node
+ */
+
+#ifndef __PAGEDLOD_H__
+#define __PAGEDLOD_H__
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <list>
+#include <utility>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#define LOD_INDEX_FILE "lod.idx"
+#define LOD_POINT_FILE "lod.pts"
+#define LOD_MAGIC "3DTKLOD"
+#define LOD_VERSION 1
+
+/** the points carry a color */
+#define LOD_HAS_COLOR 1
+
+struct LODHeader {
+  char magic[8];
+  unsigned int version;
+  unsigned int flags;
+  unsigned int nrnodes;
+  unsigned int capacity;
+  unsigned long long nrpts;
+};
+
+struct LODNode {
+  /** center of the cell */
+  float center[3];
+  /** half of the edge length of the cell */
+  float size;
+  /** estimated distance between neighbouring points of this node */
+  float spacing;
+  /** number of points stored in this node */
+  unsigned int nrpts;
+  /** index of the first point of this node in the point file */
+  unsigned long long offset;
+  /** node indices of the children, -1 for empty octants */
+  int child[8];
+};
+
+struct LODPoint {
+  float x[3];
+  unsigned char rgb[4];
+};
+
+/**
+ * @brief Renders a lod_build hierarchy within a fixed memory budget
+ *
+ * Nodes are loaded by background threads in the order of their screen
+ * space error and cached in an LRU list. Until the children of a node have
+ * arrived, the coarser node alone is drawn.
+ */
+class PagedLOD {
+public:
+  /**
+   * @param dir directory containing lod.idx and lod.pts
+   * @param memBudget maximal size of the cached points in bytes
+   * @param pointBudget maximal number of points drawn per frame
+   * @param nrLoaders number of background loader threads
+   */
+  PagedLOD(const std::string& dir, size_t memBudget,
+           unsigned int pointBudget, unsigned int nrLoaders);
+  ~PagedLOD();
+
+  /**
+   * Draws the visible nodes whose parents show gaps larger than pixelError
+   * pixels and queues missing nodes for loading. The frustum has to be
+   * extracted for the current modelview matrix beforehand.
+   */
+  void display(float pixelError);
+
+  /** @return true, if nodes have arrived since the last call */
+  bool update();
+
+  inline bool hasColor() const { return (flags & LOD_HAS_COLOR) != 0; }
+  inline unsigned long long size() const { return nrpts; }
+  inline const LODNode& root() const { return nodes[0].rec; }
+
+private:
+  enum NodeState { EMPTY, LOADING, RESIDENT, FAILED };
+
+  struct Node {
+    LODNode rec;
+    NodeState state;
+    /** last frame the node has been drawn in */
+    unsigned int drawn;
+    std::vector<LODPoint> pts;
+    std::list<unsigned int>::iterator lru;
+  };
+
+  void loaderThread();
+  void evict(unsigned int id);
+  float projectedSize(const LODNode& n);
+
+  std::vector<Node> nodes;
+  /** resident nodes, most recently drawn first */
+  std::list<unsigned int> lru;
+  /** missing nodes of the last frame, heap ordered by screen size */
+  std::vector<std::pair<float, unsigned int> > requests;
+
+  std::string pointfile;
+  unsigned int flags;
+  unsigned long long nrpts;
+  size_t budget;
+  size_t used;
+  unsigned int pointBudget;
+  unsigned int frame;
+  bool loaded;
+  bool stop;
+
+  boost::mutex mutex;
+  boost::condition_variable wakeup;
+  boost::thread_group loaders;
+};
+
+#endif
@@ -43,6 +43,10 @@ class ScanColorManager {
     ScanColorManager(unsigned int _buckets, PointType type, bool animation_color = true);
     
     void registerTree(colordisplay *b);
+
+    //! Number of scans the scan index colors are distributed over, for
+    //  trees that are registered one by one while loading
+    void setNumberOfScans(unsigned int n);
     
     void setColorMap(ColorMap &cm);
     void setColorMap(ColorMap::CM &cm);
@@ -75,9 +79,16 @@ class ScanColorManager {
     vector<CColorManager *> colorsManager;
 
     unsigned int currenttype;
+
+    /** settings applied to the managers of trees registered later on */
+    unsigned int currentmode;
+    float currentmin, currentmax;
+    bool minmaxset;
     
     unsigned int buckets;
 
+    unsigned int nrScans;
+
     /** stores minima and maxima for each point dimension */ 
     float *mins;
     float *maxs;
@@ -15,8 +15,13 @@
 #include "show/colordisplay.h"
 #include "slam6d/scan.h"
 
+#include <vector>
+
 using namespace show;
 
+/** maximal number of points packed into one vertex buffer */
+#define SHOW_CHUNK_SIZE 65536
+
 /**
  * @brief Octree for show
  * 
@@ -44,6 +49,19 @@ protected:
   Scan* m_scan;
   ScanColorManager* scm;
 
+  //! A subtree packed into one vertex buffer
+  struct Chunk {
+    //! bounding cube of the subtree
+    T center[3];
+    T size;
+    unsigned int length;
+    //! buffer object, 0 if the points are drawn from the host copy
+    GLuint vbo;
+    std::vector<T> points;
+  };
+  std::vector<Chunk> chunks;
+  bool chunks_created;
+
   void init(ScanColorManager* _scm) {
     scm = _scm;
     setColorManager(0);
@@ -57,6 +75,7 @@ protected:
     current_lod_mode = 0;
     m_cache_access = 0;
     m_scan = 0;
+    chunks_created = false;
   }
   
 public:
@@ -114,6 +133,11 @@ public:
   }
   
   virtual ~Show_BOctTree() {
+#ifdef WITH_GLEE
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+      if (chunks[i].vbo) glDeleteBuffersARB(1, &chunks[i].vbo);
+    }
+#endif
     // only delete cache access if created via this method
     if(m_cache_access) {
       delete m_cache_access;
@@ -133,6 +157,9 @@ public:
         return base * pow(base, exponent - 1);
   }
   BOctTree<T>* getTree() const { return m_tree; }
+
+  //! Draw from vertex buffers of whole subtrees instead of point by point
+  static bool batched;
   
   void serialize(const std::string& filename) const { m_tree->serialize(filename); }
   
@@ -157,6 +184,10 @@ public:
   }
 
   void drawLOD(float ratio) {
+    if (batched) {
+      displayChunks(ratio);
+      return;
+    }
     switch (current_lod_mode) {
       case 0:
         glBegin(GL_POINTS);
@@ -189,6 +220,10 @@ public:
   }
   
   void draw() {
+    if (batched) {
+      displayChunks(0.0);
+      return;
+    }
     glBegin(GL_POINTS);
     displayOctTreeAllCulled(m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
     glEnd();
@@ -200,6 +235,179 @@ public:
   }
   
 protected:
+
+  static GLenum glType() { return sizeof(T) == sizeof(GLdouble) ? GL_DOUBLE : GL_FLOAT; }
+
+  /**
+   * Draws the chunks within the frustum with one glDrawArrays each.
+   * With a ratio > 0 only as many points as the chunk covers pixels times
+   * ratio are drawn, like displayOctTreeCulledLOD2 does.
+   */
+  void displayChunks(float ratio) {
+    if (!chunks_created) {
+      createChunks(m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
+      chunks_created = true;
+    }
+
+    GLsizei stride = POINTDIM * sizeof(T);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (cm) cm->enableArrays();
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+      const Chunk &c = chunks[i];
+      if (!CubeInFrustum(c.center[0], c.center[1], c.center[2], c.size)) continue;
+      if (CubeOccluded(c.center[0], c.center[1], c.center[2], c.size)) continue;
+
+      unsigned int count = c.length;
+      if (ratio > 0.0) {
+        int l = LOD2(c.center[0], c.center[1], c.center[2], c.size);
+        l = max((int)(l*l*ratio), 1);
+        if ((unsigned int)l < count) count = l;
+      }
+
+      const T *base = 0;
+#ifdef WITH_GLEE
+      if (c.vbo) {
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, c.vbo);
+      } else {
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        base = &c.points[0];
+      }
+#else
+      base = &c.points[0];
+#endif
+      glVertexPointer(3, glType(), stride, base);
+      if (cm) cm->setColorPointer(glType(), stride, base);
+      glDrawArrays(GL_POINTS, 0, count);
+    }
+#ifdef WITH_GLEE
+    if (GLEE_ARB_vertex_buffer_object) glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+#endif
+    if (cm) cm->disableArrays();
+    glDisableClientState(GL_VERTEX_ARRAY);
+  }
+
+  /**
+   * Packs subtrees of at most SHOW_CHUNK_SIZE points into chunks. The leaves
+   * of a larger node are packed together into a chunk with the node's bounds.
+   */
+  void createChunks(const bitoct &node, const T* center, T size) {
+    if (countPoints(node) <= SHOW_CHUNK_SIZE) {
+      std::vector<T> pts;
+      collectPoints(node, pts);
+      addChunk(pts, center, size);
+      return;
+    }
+
+    T ccenter[3];
+    std::vector<T> leaves;
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    for (short i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
+        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
+          pointrep *points = children->getPointreps();
+          unsigned int length = points[0].length;
+          T *point = &(points[1].v);  // first point
+          if ((leaves.size() / POINTDIM) + length > SHOW_CHUNK_SIZE) {
+            addChunk(leaves, center, size);
+            leaves.clear();
+          }
+          leaves.insert(leaves.end(), point, point + length*POINTDIM);
+        } else { // recurse
+          createChunks(children->node, ccenter, size/2.0);
+        }
+        ++children; // next child
+      }
+    }
+    addChunk(leaves, center, size);
+  }
+
+  /**
+   * Stores the points of a chunk in a spread out order, so that any prefix
+   * of it is an even subsample, and uploads them if buffer objects exist.
+   */
+  void addChunk(const std::vector<T> &pts, const T* center, T size) {
+    unsigned int n = pts.size() / POINTDIM;
+    if (n == 0) return;
+
+    chunks.push_back(Chunk());
+    Chunk &c = chunks.back();
+    for (int j = 0; j < 3; j++) c.center[j] = center[j];
+    c.size = size;
+    c.length = n;
+    c.vbo = 0;
+
+    // golden ratio step, coprime to n, visits every point once
+    unsigned long step = (unsigned long)(0.618034 * n) + 1;
+    while (gcd(step, n) != 1) step++;
+    c.points.resize(pts.size());
+    unsigned long index = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      for (unsigned int j = 0; j < POINTDIM; j++)
+        c.points[i*POINTDIM + j] = pts[index*POINTDIM + j];
+      index = (index + step) % n;
+    }
+
+#ifdef WITH_GLEE
+    if (GLEE_ARB_vertex_buffer_object) {
+      glGenBuffersARB(1, &c.vbo);
+      glBindBufferARB(GL_ARRAY_BUFFER_ARB, c.vbo);
+      glBufferDataARB(GL_ARRAY_BUFFER_ARB, c.points.size() * sizeof(T),
+                      &c.points[0], GL_STATIC_DRAW_ARB);
+      glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+      std::vector<T>().swap(c.points);
+    }
+#endif
+  }
+
+  static unsigned long gcd(unsigned long a, unsigned long b) {
+    while (b != 0) {
+      unsigned long t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+
+  unsigned long countPoints(const bitoct &node) {
+    unsigned long result = 0;
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    for (short i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
+          pointrep *points = children->getPointreps();
+          result += points[0].length;
+        } else { // recurse
+          result += countPoints(children->node);
+        }
+        ++children; // next child
+      }
+    }
+    return result;
+  }
+
+  void collectPoints(const bitoct &node, std::vector<T> &pts) {
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    for (short i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
+          pointrep *points = children->getPointreps();
+          unsigned int length = points[0].length;
+          T *point = &(points[1].v);  // first point
+          pts.insert(pts.end(), point, point + length*POINTDIM);
+        } else { // recurse
+          collectPoints(children->node, pts);
+        }
+        ++children; // next child
+      }
+    }
+  }
   
   //! ?
   unsigned long maxTargetPoints(const bitoct &node) {
@@ -250,14 +458,29 @@ protected:
   }
 
   void displayOctTreeAllCulled(const bitoct &node, const T* center, T size ) {
-    int res = CubeInFrustum2(center[0], center[1], center[2], size);
-    if (res==0) return;  // culled do not continue with this branch of the tree
+    unsigned char planes = FRUSTUM_PLANES;
+    if (!CubeInFrustumMask(center[0], center[1], center[2], size, planes)) return;
+    if (CubeOccluded(center[0], center[1], center[2], size)) return;
+    displayOctTreeAllCulled(node, center, size, planes);
+  }
 
-    if (res == 2) { // if entirely within frustrum discontinue culling
+  /**
+   * Draws the children of a visible node. planes are the frustum planes
+   * the node intersects, the children are tested against these only.
+   */
+  void displayOctTreeAllCulled(const bitoct &node, const T* center, T size,
+                               unsigned char planes) {
+    // entirely within frustum and nothing to occlude, discontinue culling
+    if (planes == 0 && !occlusion_culling) {
       displayOctTreeAll(node);
       return;
     }
 
+    float fcenter[3] = { (float)center[0], (float)center[1], (float)center[2] };
+    unsigned char childplanes[8];
+    unsigned char visible = ChildrenInFrustum(fcenter, size, node.valid, planes, childplanes);
+    if (!visible) return;
+
     T ccenter[3];
     bitunion<T> *children;
     bitoct::getChildren(node, children);
@@ -265,9 +488,9 @@ protected:
     for (short i = 0; i < 8; i++) {
       if (  ( 1 << i ) & node.valid ) {   // if ith node exists
         BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
-        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
-          // check if leaf is visible
-       //   if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
+        if ( ( ( 1 << i ) & visible ) &&
+             !CubeOccluded(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
+          if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
             pointrep *points = children->getPointreps();
             unsigned int length = points[0].length;
             T *point = &(points[1].v);  // first point
@@ -276,9 +499,9 @@ protected:
               glVertex3f( point[0], point[1], point[2]);
               point+=POINTDIM;
             }
-          //}
-        } else { // recurse
-          displayOctTreeAllCulled( children->node, ccenter, size/2.0);
+          } else { // recurse
+            displayOctTreeAllCulled( children->node, ccenter, size/2.0, childplanes[i]);
+          }
         }
         ++children; // next child
       }
@@ -483,10 +706,12 @@ protected:
     }
   }
 
-  void displayOctTreeCulledLOD(long targetpts, const bitoct &node, const T* center, T size ) {
+  void displayOctTreeCulledLOD(long targetpts, const bitoct &node, const T* center, T size,
+                               unsigned char planes = FRUSTUM_PLANES) {
     if (targetpts <= 0) return; // no need to display anything
 
-    int res = CubeInFrustum2(center[0], center[1], center[2], size);
+    // only the planes the parent intersects are left to be tested
+    int res = CubeInFrustumMask(center[0], center[1], center[2], size, planes);
     if (res==0) return;  // culled do not continue with this branch of the tree
 
     if (res == 2) { // if entirely within frustrum discontinue culling
@@ -505,12 +730,16 @@ protected:
       if (newtargetpts <= 0 ) return;
     }
 
+    float fcenter[3] = { (float)center[0], (float)center[1], (float)center[2] };
+    unsigned char childplanes[8];
+    unsigned char visible = ChildrenInFrustum(fcenter, size, node.valid, planes, childplanes);
+
     for (short i = 0; i < 8; i++) {
       if (  ( 1 << i ) & node.valid ) {   // if ith node exists
         BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
         if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
           // check if leaf is visible
-          if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
+          if ( ( 1 << i ) & visible ) {
             pointrep *points = children->getPointreps();
             unsigned int length = points[0].length;
             T *point = &(points[1].v);  // first point
@@ -539,8 +768,8 @@ protected:
             }
           }
 
-        } else { // recurse
-          displayOctTreeCulledLOD(newtargetpts, children->node, ccenter, size/2.0);
+        } else if ( ( 1 << i ) & visible ) { // recurse
+          displayOctTreeCulledLOD(newtargetpts, children->node, ccenter, size/2.0, childplanes[i]);
         }
         ++children; // next child
       }
@@ -942,4 +1171,6 @@ protected:
   }
 };
 
+template <class T> bool Show_BOctTree<T>::batched = false;
+
 #endif
@@ -162,6 +162,54 @@ bool CubeInFrustum( float x, float y, float z, float size );
 int  CubeInFrustum2( float x, float y, float z, float size );
 char PlaneAABB( float x, float y, float z, float size, float *plane );
 
+/** bit mask of all six planes of the viewing frustum */
+#define FRUSTUM_PLANES 0x3f
+
+/**
+ * Like CubeInFrustum2, but only the planes in the bit mask are tested.
+ * Planes the cube is entirely inside of are removed from the mask, so the
+ * children of the cube need not test them again.
+ * @return 0 if not in frustum, 1 if partial overlap, 2 if entirely within
+ */
+int CubeInFrustumMask( float x, float y, float z, float size,
+                       unsigned char &planes );
+
+/**
+ * Tests all eight children of an octree node at once, using SSE where
+ * available. The children inherit the planes of their parent.
+ * @param center center of the parent cell
+ * @param size half edge length of the parent cell
+ * @param valid bit mask of the existing children
+ * @param planes planes the parent cell intersects
+ * @param childplanes receives the planes each visible child intersects
+ * @return bit mask of the children that are at least partially visible
+ */
+unsigned char ChildrenInFrustum( const float center[3], float size,
+                                 unsigned char valid, unsigned char planes,
+                                 unsigned char childplanes[8] );
+
+/** test the octree nodes against the depth buffer of the previous frame */
+extern bool occlusion_culling;
+
+/**
+ * Starts a frame, has to be called with the camera matrices before any
+ * model transformation. The depth of the previous frame is used only if
+ * the camera has not changed since then.
+ */
+void BeginOcclusion();
+
+/**
+ * Reads the depth buffer after all points have been drawn and reduces it
+ * to a pyramid of the farthest depth of screen tiles.
+ */
+void EndOcclusion();
+
+/**
+ * @return true, if the cube lies behind everything drawn at its onscreen
+ * position in the previous frame, false if unknown
+ */
+bool CubeOccluded( float x, float y, float z, float size );
+
 void remViewport();
 bool LOD(float x, float y, float z, float size);
 int LOD2(float x, float y, float z, float size);
@@ -18,6 +18,9 @@ public:
   
   virtual void printSize() const = 0;
 
+  //! Number of bytes taken by the allocator
+  virtual unsigned long int getSize() const = 0;
+
 protected:
   virtual unsigned char* allocate(unsigned int size) = 0;
 };
@@ -29,6 +32,7 @@ public:
   ChunkAllocator(unsigned int _csize = (1 << 20));
   ~ChunkAllocator();
   void printSize() const;
+  unsigned long int getSize() const;
 protected:
   unsigned char* allocate(unsigned int size);
 private:
@@ -46,6 +50,7 @@ public:
   PackedChunkAllocator(unsigned int _csize = (1<<20));
   ~PackedChunkAllocator();
   void printSize() const;
+  unsigned long int getSize() const;
 protected:
   unsigned char* allocate(unsigned int size);
 private:
@@ -63,6 +68,7 @@ public:
   SequentialAllocator(unsigned char* base_ptr, unsigned int max_size);
   ~SequentialAllocator();
   void printSize() const;
+  unsigned long int getSize() const;
 protected:
   unsigned char* allocate(unsigned int size);
 private:
@@ -8,6 +8,11 @@
 
 #include "loopSlam6D.h"
 
+#include <map>
+#include <utility>
+
+#include "newmat/newmat.h"
+
 class elch6D : public loopSlam6D {
 
   public:
@@ -22,6 +27,27 @@ class elch6D : public loopSlam6D {
     static void graph_pos_out(graph_t &g, const vector <Scan *> &allScans);
     static void graph_pos_out(graph_t &g, const vector <Scan *> &allScans, string &out_file);
     static void dot_pos_out(graph_t &g, const vector <Scan *> &allScans, string &out_file);
+
+  protected:
+    void edge_covariances(const vector <Scan *> &allScans, graph_t &g,
+                          vector <NEWMAT::Matrix> &C);
+
+    /**
+     * inverse covariance of the pose difference of two scans in the
+     * parametrization of the respective ELCH variant
+     */
+    virtual void edge_covariance(Scan *first, Scan *second, NEWMAT::Matrix &C) = 0;
+
+  private:
+    struct CachedEdge {
+      NEWMAT::Matrix C;
+      /** poses of both scans the covariance has been computed for */
+      double pose_from[6];
+      double pose_to[6];
+    };
+
+    /** inverse edge covariances of earlier loop closings */
+    std::map <std::pair <int, int>, CachedEdge> cov_cache;
 };
 
 #endif
@@ -165,6 +165,8 @@ namespace fbr{
   };
   //RANSAC iteration       
 #define RANSACITR 20000
+  //RANSAC stops once an all inlier sample was drawn with this probability
+#define RANSACCONFIDENCE 0.99
   //Inlier influence                                                     
 #define iInfluence 0.5
 
@@ -25,6 +25,53 @@
 using namespace std;
 
 namespace fbr{
+  /**
+   * @class extended_map
+   * all 3D points of a panorama sorted by their pixel, the points of pixel
+   * (row, col) are stored one after the other from begin(row, col) to
+   * end(row, col)
+   */
+  class extended_map {
+  public:
+    extended_map();
+    void clear();
+    /**
+     * @brief sorts the points into their pixels, keeps the order of the
+              points within a pixel
+     * @param width width of the panorama
+     * @param height height of the panorama
+     * @param pixels row * width + col of every point
+     * @param points the points
+     */
+    void build(unsigned int width,
+               unsigned int height,
+               const vector<unsigned int>& pixels,
+               const vector<cv::Vec3f>& points);
+
+    unsigned int rows() const { return height_; }
+    unsigned int cols() const { return width_; }
+    bool empty() const { return points_.empty(); }
+    unsigned int size(unsigned int row, unsigned int col) const
+    {
+      return index_[row * width_ + col + 1] - index_[row * width_ + col];
+    }
+    const cv::Vec3f* begin(unsigned int row, unsigned int col) const
+    {
+      return points_.data() + index_[row * width_ + col];
+    }
+    const cv::Vec3f* end(unsigned int row, unsigned int col) const
+    {
+      return points_.data() + index_[row * width_ + col + 1];
+    }
+
+  private:
+    unsigned int width_;
+    unsigned int height_;
+    //offset of the first point of each pixel, one more for the end
+    vector<unsigned int> index_;
+    vector<cv::Vec3f> points_;
+  };
+
   /**
    * @class panorama
    * create panorama images with use of projection class [different 
@@ -35,7 +82,7 @@ namespace fbr{
    * @param iColor_ panorama image from color data             
    * @param iMap_ panorama map of 3D cartesian coordinate of input scan
             (same points as iRange and iReflectance and iColor)
-   * @param extendedIMap_ 3D vector as panorama map with all the points
+   * @param extendedIMap_ panorama map with all the points
    * @param maxRange_ the maximum range of the scan
    * @param mapMethod_ the method for creating the map [FARTHEST | EXTENDED]
    * @param projection_ pointer to projectionClass Handler
@@ -203,7 +250,10 @@ namespace fbr{
     cv::Mat getColorImage();
     
     cv::Mat getMap();
-    vector<vector<vector<cv::Vec3f> > > getExtendedMap();
+    /**
+     * Brief returns the map of the EXTENDED map method without copying it
+     */
+    const extended_map& getExtendedMap();
 
     
   private:
@@ -211,6 +261,10 @@ namespace fbr{
      * Brief initializes the containers for map and range, reflectance and color images
      */
     void initMap();
+    /**
+     * Brief sorts the points collected for the extended map into their pixels
+     */
+    void buildExtendedMap();
     void map(int x,
              int y,
              cv::MatIterator_<cv::Vec4f> it,
@@ -228,7 +282,10 @@ namespace fbr{
     cv::Mat iColor_;
     float maxRange_;
     float minRange_;
-    vector<vector<vector<cv::Vec3f> > > extendedIMap_;
+    extended_map extendedIMap_;
+    //points of the extended map and their pixels, before they are sorted
+    vector<unsigned int> extendedPixels_;
+    vector<cv::Vec3f> extendedPoints_;
     projection* projection_;
     panorama_map_method mapMethod_;
     //parameters for the creation of panoram from octree 
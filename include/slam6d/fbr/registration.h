@@ -47,7 +47,7 @@ namespace fbr{
      * @param ct Point3f for returning the 3D coordinate of train scan
      * @return 1 on success 0 on failure
      */
-    int getCoord( vector<cv::KeyPoint> fKeypoints, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches, cv::Mat fPMap, cv::Mat sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct);
+    int getCoord(const vector<cv::KeyPoint>& fKeypoints, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches, const cv::Mat& fPMap, const cv::Mat& sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct);
     /**
      * pointToArray : convert 3D point3f to double array
      * @param c 3D point whith Point3f type
@@ -62,14 +62,14 @@ namespace fbr{
      */
     cv::Point3f coordTransform(cv::Point3f p, double* align);
     /**
-     * findAlign : find the best align
-     * @param fPMap input Mat wich contains the 3D coordinates of each pixel of first panorama image
-     * @param fKeypoints vector<KeyPoints> containing the features of first panorama image
-     * @param sPMap input Mat wich contains the 3D coordinates of each pixel of second panorama image
-     * @param sKeypoints vector<KeyPoints> containing the features of second panorama image
-     * @param matches vector<DMatches> containing the matched features of both images
+     * findAlign : find the align of the matches i, j, k and keep it if it is the best one so far, may be called from several threads
+     * @param fCoord 3D coordinates of all matches in the first scan, three doubles per match
+     * @param sCoord 3D coordinates of all matches in the second scan, three doubles per match
+     * @param valid nonzero for the matches with 3D coordinates in both scans
+     * @param nr number of matches
+     * @return 1 if the align was evaluated 0 if the matches are not usable
      */
-    int findAlign(unsigned int i, unsigned int j, unsigned int k, cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches);
+    int findAlign(unsigned int i, unsigned int j, unsigned int k, const double* fCoord, const double* sCoord, const unsigned char* valid, unsigned int nr);
 
   public:
     registration();
@@ -82,7 +82,7 @@ namespace fbr{
      * @param sKeypoints keypoints from the second scan
      * @param matches matched keypoints from first to second scan
      */
-    void findRegistration(cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches);
+    void findRegistration(const cv::Mat& fPMap, const vector<cv::KeyPoint>& fKeypoints, const cv::Mat& sPMap, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches);
     double getMinDistance();
     double getMinError();
     unsigned int getMinInlier();
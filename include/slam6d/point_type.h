@@ -100,6 +100,15 @@ public:
   template<typename T>
   T** createPointArray(Scan* scan);
 
+  //! Write coordinates+attributes of point \a i into the preallocated \a p
+  template<typename T>
+  void fillPoint(T* p, unsigned int i, unsigned int index = 0);
+
+  //! Create one contiguous array of size() * pointdim values with transfer
+  //  of ownership, \a nrpts receives the number of points
+  template<typename T>
+  T* createPointBuffer(Scan* scan, unsigned int &nrpts);
+
 private:
   /**
    * collection of flags 
@@ -134,6 +143,36 @@ private:
   DataDeviation* m_deviation;
 };
 
+/**
+ * Points of a scan with their attributes, stored back to back in a single
+ * buffer, together with a pointer array into it for the T** constructors of
+ * the octrees. Replaces the per point allocations of createPointArray and
+ * releases both arrays on destruction (RAII, see PointerArray).
+ */
+template<typename T>
+class PointBuffer {
+public:
+  PointBuffer(PointType& pointtype, Scan* scan) {
+    m_data = pointtype.createPointBuffer<T>(scan, m_size);
+    unsigned int pointdim = pointtype.getPointDim();
+    m_array = new T*[m_size];
+    for(unsigned int i = 0; i < m_size; ++i)
+      m_array[i] = m_data + i*pointdim;
+  }
+
+  ~PointBuffer() {
+    delete[] m_array;
+    delete[] m_data;
+  }
+
+  inline T** get() const { return m_array; }
+  inline unsigned int size() const { return m_size; }
+private:
+  T* m_data;
+  T** m_array;
+  unsigned int m_size;
+};
+
 #include "point_type.icc"
 
 #endif
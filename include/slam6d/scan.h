@@ -198,7 +198,7 @@ public:
   //! Accumulated delta transformation matrix 
   inline const double* getDAlign() const;
   
-  inline SearchTree* getSearchTree();
+  SearchTree* getSearchTree();
   //  inline ANNkd_tree* getANNTree() const;
   
   virtual const char* getIdentifier() const = 0;
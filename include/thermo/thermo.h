@@ -14,17 +14,35 @@ using namespace std;
 //typedef vector<vector<float> > Float2D[1200][1600];
 typedef vector<vector<float> > Float2D[2592][3888];
 
+/**
+  * Calibration features detected in one image.
+  */
+struct CalibView {
+  int corners;                          // number of features found
+  CvSize size;                          // size of the image they were found in
+  vector<vector<double> > points;       // image coordinates of the features
+};
+
 void calcBoard(vector<vector<double> > &point_array, int board_n, double &x, double &y, double &cx, double &cy, bool pc); 
 void sortBlobs(vector<vector<double> > &point_array, int board_n, int board_h, int board_w, bool quiet); 
 IplImage* detectBlobs(IplImage *org_image, int &corner_exp, int board_h, int board_w, bool quiet, vector<vector<double> > &point_array2);
 void drawLines(vector<vector<double> > &point_array2, int corner_exp, IplImage *image, bool color=false);
 IplImage* resizeImage(IplImage *source, int scale);
 IplImage* detectCorners(IplImage *orgimage, int &corner_exp, int board_h, int board_w, bool quiet, double point_array2[][2], int scale=1);
+bool hashFile(string filename, unsigned long long &hash);
+string cornerCacheName(string dir, unsigned long long hash, bool chess, int board_w, int board_h, int scale);
+bool readCornerCache(string filename, CalibView &view, int corner_exp);
+void writeCornerCache(string filename, const CalibView &view);
+void detectViews(vector<string> &files, vector<CalibView> &views, int board_w, int board_h, bool chess, bool quiet, string dir, int scale=1);
 void CalibFunc(int board_w, int board_h, int start, int end, bool optical, bool chess, bool quiet, string dir, int scale=1);
 void writeCalibParam(int images, int corner_exp, int board_w, CvMat* image_points, CvSize size, string dir);
 
 void loadIntrinsicCalibration(CvMat * &intrinsic, CvMat * &distortion, string dir, bool optical=false) ;
 void loadExtrinsicCalibration(CvMat * &Translation, CvMat * &Rotation, string dir, int method, bool optical=false) ;
+void openOutputDirectory(string outdir);
+void ProjectImage(CvMat *point_3Dcloud, CvMat *rod_comI, CvMat *t_comI,
+CvMat *rot_tmp, CvMat *intrinsic, CvMat *distortion, CvMat *undistort,
+IplImage *image, bool optical, bool correction, int neighborhood, string &text);
 void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
 IOType type, int scale, double rot_angle, double minDist, double maxDist,
 bool correction, int neighborhood, int method=0);
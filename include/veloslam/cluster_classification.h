@@ -2,18 +2,55 @@
 #include "veloslam/veloscan.h"
 #include "veloslam/svm.h"
 
+/**
+ * SVM classifier that keeps its model resident and predicts whole batches
+ * of feature vectors in one call. The support vectors are stored as a
+ * dense row major matrix, so the kernel of a feature vector against all of
+ * them reduces to runs of dot products or squared distances.
+ */
 class Cluster_Classification
 {
 public:
 	Cluster_Classification(void);
+	Cluster_Classification(const string &filename);
 	~Cluster_Classification(void);
 
-public:
-    svm_model *bus_classifier;
-    string *bus_classifier_filename;
-    svm_node *feature_nod;
-};
+	/**
+	 * Loads a libsvm model file, replacing the current model
+	 * @return false if the model could not be read or uses a
+	 * precomputed kernel
+	 */
+	bool Load(const string &filename);
 
+	bool IsLoaded(void) const { return bus_classifier != 0; }
 
+	/** highest feature index of the support vectors, feature i+1 is column i */
+	int Dimension(void) const { return dim; }
 
+	/**
+	 * Predicts the labels of nr feature vectors with nfeatures values
+	 * each, as svm_predict would for every one of them. Features beyond
+	 * Dimension() are zero in all support vectors but still count for the
+	 * distance based kernels.
+	 */
+	void Predict(const double *features, int nr, int nfeatures,
+	             double *labels) const;
 
+	double Predict(const double *feature, int nfeatures) const;
+
+public:
+    svm_model *bus_classifier;
+    string bus_classifier_filename;
+
+private:
+	void Free(void);
+	double Decide(const double *kvalue) const;
+
+	int dim;
+	/** set once Predict has reported a missing model */
+	mutable bool warned;
+	/** support vectors, one row of dim values each */
+	vector<double> sv;
+	/** index of the first support vector of each class */
+	vector<int> start;
+};
@@ -15,6 +15,14 @@ struct ClusterStatus
 	bool Matched;
 };
 
+/** cost of assigning a tracker to a cluster within the gate of the tracker */
+struct TrackClusterCost
+{
+	int track;
+	int cluster;
+	double cost;
+};
+
 int GetScanID_in_SlidingWindow(int absNO, int current_pos, int  window_size);
 
 
@@ -66,6 +74,9 @@ public:
 
 	CMatrix ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex);
 
+	void GateTracksWithClusters(VeloScan &scanRef, vector<int> &clusterIndex,
+	                            vector<TrackClusterCost> &costs);
+
 	int MatchTracksWithClusters(VeloScan &scanRef);
 
 	list<Tracker> tracks;
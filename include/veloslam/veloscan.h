@@ -66,7 +66,6 @@ public:
   int CalcScanCellFeature();
   int CalcCellFeature(cell& cellobj,cellFeature& f);
   int FindAndCalcScanClusterFeature();
-  int SearchNeigh(cluster& clu,charvv& flagvv,int i,int j);
   int CalcClusterFeature(cluster& clu,clusterFeature& f);
   void SaveObjectsInPCD(int index, cluster &gClusterData );
   void SaveFrameInPCD( );
@@ -74,9 +73,13 @@ public:
   bool isTrackerHandled;
   long scanid;
 
-  /** scanCellFeatureArray */
-  cellArray scanCellArray;
-  cellFeatureArray scanCellFeatureArray;
+  /** points within range, sorted by the cell they fall into */
+  vector<Point> scanPoints;
+
+  /** polar grid, cell (column, ring) is at column * scanRings + ring */
+  int scanColumns, scanRings;
+  vector<cell> scanCells;
+  vector<cellFeature> scanCellFeatures;
 
   clusterArray scanClusterArray;
   clusterFeatureArray scanClusterFeatureArray;
@@ -25,6 +25,10 @@
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef _MSC_VER
 #define strcasecmp _stricmp
 #define strncasecmp _strnicmp
@@ -33,6 +37,9 @@ namespace po = boost::program_options;
 enum collision_method { CTYPE1, CTYPE2, CTYPE3 };
 enum penetrationdepth_method { PDTYPE1, PDTYPE2 };
 
+// number of consecutive poses whose swept model is enclosed in one capsule
+#define POSES_PER_CAPSULE 16
+
 /*
  * validates input type specification
  */
@@ -217,11 +224,74 @@ std::vector<Point> read_plymodel(string &pointmodelpath)
 }
 */
 
-void fill_colliding(std::vector<bool> &allcolliding, std::vector<size_t> const &newindices)
+/*
+ * the sphere around the center of the bounding box of the model that
+ * contains all model points
+ */
+void bounding_sphere(std::vector<Point> const &pointmodel, double center[3], double &radius)
 {
-    for(auto it : newindices) {
-        allcolliding[it] = true;
+    const double inf = std::numeric_limits<double>::max();
+    double min[3] = {  inf,  inf,  inf };
+    double max[3] = { -inf, -inf, -inf };
+    for(const auto &it : pointmodel) {
+        double p[3] = {it.x, it.y, it.z};
+        for (int j = 0; j < 3; ++j) {
+            if (p[j] < min[j]) min[j] = p[j];
+            if (p[j] > max[j]) max[j] = p[j];
+        }
+    }
+    double radius2 = 0;
+    for (int j = 0; j < 3; ++j) {
+        center[j] = (min[j] + max[j]) / 2;
+    }
+    for(const auto &it : pointmodel) {
+        double p[3] = {it.x, it.y, it.z};
+        double d2 = Dist2(p, center);
+        if (d2 > radius2) radius2 = d2;
     }
+    radius = sqrt(radius2);
+}
+
+/*
+ * all environment points that may come closer than radius to the model
+ * at one of the poses first to last. The center of the model sphere moves
+ * along a polyline which stays within dev of the segment between its
+ * ends, so every model point stays within the capsule around that segment
+ * with a radius of modelradius + dev.
+ */
+vector<size_t> capsule_candidates(KDtreeIndexed const &t,
+                                  std::vector<Frame> const &trajectory,
+                                  size_t first, size_t last,
+                                  const double modelcenter[3],
+                                  double modelradius, double radius,
+                                  int thread_num)
+{
+    double start[3], end[3];
+    for (int j = 0; j < 3; ++j) {
+        start[j] = end[j] = modelcenter[j];
+    }
+    transform3(trajectory[first].transformation, start);
+    transform3(trajectory[last].transformation, end);
+    double dir[3] = { end[0] - start[0], end[1] - start[1], end[2] - start[2] };
+    double len2 = Len2(dir);
+    double dev2 = 0;
+    for (size_t k = first + 1; k < last; ++k) {
+        double c[3] = { modelcenter[0], modelcenter[1], modelcenter[2] };
+        transform3(trajectory[k].transformation, c);
+        double p2p[3] = { c[0] - start[0], c[1] - start[1], c[2] - start[2] };
+        double t = len2 > 0 ? Dot(p2p, dir) / len2 : 0;
+        if (t < 0) t = 0;
+        if (t > 1) t = 1;
+        double proj[3] = { start[0] + t*dir[0], start[1] + t*dir[1], start[2] + t*dir[2] };
+        double d2 = Dist2(c, proj);
+        if (d2 > dev2) dev2 = d2;
+    }
+    // some slack for rounding, the points found are checked exactly later
+    double r = (modelradius + sqrt(dev2) + radius) * 1.001;
+    if (len2 > 0) {
+        return t.segmentSearch_all(start, end, r*r, thread_num);
+    }
+    return t.fixedRangeSearch(start, r*r, thread_num);
 }
 
 size_t handle_pointcloud(std::vector<Point> &pointmodel, DataXYZ &environ,
@@ -238,68 +308,110 @@ size_t handle_pointcloud(std::vector<Point> &pointmodel, DataXYZ &environ,
         pa[i][0] = environ[i][0];
         pa[i][1] = environ[i][1];
         pa[i][2] = environ[i][2];
-        colliding[i] = false;
     }
     cerr << "environment: " << i << endl;
     cerr << "building kd tree..." << endl;
     KDtreeIndexed t(pa, environ.size());
     /* initialize variables */
-    int thread_num = 0; // add omp later
     double sqRad2 = radius*radius;
+    double modelcenter[3], modelradius;
+    bounding_sphere(pointmodel, modelcenter, modelradius);
+    // std::vector<bool> cannot be written from several threads
+    std::vector<char> collidingflags(environ.size(), 0);
     cerr << "computing collisions..." << endl;
     time_t before = time(NULL);
-    int end;
-    i = 0;
+    // CTYPE1 checks the poses of a capsule, CTYPE2 the segments between
+    // them, so for CTYPE2 the last pose of a capsule starts the next one
+    int step = POSES_PER_CAPSULE;
+    int nposes = trajectory.size();
+    int ncapsules;
     switch (cmethod) {
         case CTYPE1:
-            end = trajectory.size();
-            for(const auto &it2 : trajectory) {
-                cerr << (i*100.0)/end << " %\r";
-                cerr.flush();
-                for(const auto &it : pointmodel) {
-                    double point1[3] = {it.x, it.y, it.z};
-                    transform3(it2.transformation, point1);
-                    vector<size_t> collidingsphere = t.fixedRangeSearch(point1, sqRad2, thread_num);
-                    fill_colliding(colliding, collidingsphere);
-                }
-                i++;
-            }
+            ncapsules = (nposes + step - 1) / step;
             break;
         case CTYPE2:
-            end = pointmodel.size();
-            // we iterate over points instead of points on the trajectory so
-            // that we can reuse the previous transformation of the same point
-            for(const auto &it : pointmodel) {
-                cerr << (i*100.0)/end << " %\r";
-                cerr.flush();
-                auto it2 = trajectory.begin();
-                double point1[3], point2[3];
-                point1[0] = it.x;
-                point1[1] = it.y;
-                point1[2] = it.z;
-                transform3(it2->transformation, point1);
-                ++it2;
-                for (; it2 < trajectory.end(); ++it2) {
-                    point2[0] = it.x;
-                    point2[1] = it.y;
-                    point2[2] = it.z;
-                    transform3(it2->transformation, point2);
-                    vector<size_t> collidingsegment = t.segmentSearch_all(point1, point2, sqRad2, thread_num);
-                    fill_colliding(colliding, collidingsegment);
-                    point1[0] = point2[0];
-                    point1[1] = point2[1];
-                    point1[2] = point2[2];
-                }
-                i++;
-            }
+            ncapsules = nposes > 1 ? (nposes - 2 + step) / step : 0;
             break;
         default:
             throw std::runtime_error("impossible");
     }
+    int done = 0;
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int c = 0; c < ncapsules; ++c) {
+#ifdef _OPENMP
+        int thread_num = omp_get_thread_num();
+#else
+        int thread_num = 0;
+#endif
+        size_t first = c * step;
+        size_t last = std::min(first + step - (cmethod == CTYPE1 ? 1 : 0),
+                               (size_t)nposes - 1);
+        vector<size_t> candidates = capsule_candidates(t, trajectory,
+                first, last, modelcenter, modelradius, radius, thread_num);
+        if (!candidates.empty()) {
+            // check the model points against the candidates only
+            vector<double*> cpa(candidates.size());
+            for (size_t j = 0; j < candidates.size(); ++j) {
+                cpa[j] = pa[candidates[j]];
+            }
+            KDtreeIndexed ct(&cpa[0], cpa.size());
+            if (cmethod == CTYPE1) {
+                for (size_t k = first; k <= last; ++k) {
+                    for(const auto &it : pointmodel) {
+                        double point1[3] = {it.x, it.y, it.z};
+                        transform3(trajectory[k].transformation, point1);
+                        vector<size_t> collidingsphere = ct.fixedRangeSearch(point1, sqRad2, thread_num);
+                        for (auto j : collidingsphere) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+                            collidingflags[candidates[j]] = 1;
+                        }
+                    }
+                }
+            } else {
+                // reuse the previous transformation of the same point
+                for(const auto &it : pointmodel) {
+                    double point1[3], point2[3];
+                    point1[0] = it.x;
+                    point1[1] = it.y;
+                    point1[2] = it.z;
+                    transform3(trajectory[first].transformation, point1);
+                    for (size_t k = first + 1; k <= last; ++k) {
+                        point2[0] = it.x;
+                        point2[1] = it.y;
+                        point2[2] = it.z;
+                        transform3(trajectory[k].transformation, point2);
+                        vector<size_t> collidingsegment = ct.segmentSearch_all(point1, point2, sqRad2, thread_num);
+                        for (auto j : collidingsegment) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+                            collidingflags[candidates[j]] = 1;
+                        }
+                        point1[0] = point2[0];
+                        point1[1] = point2[1];
+                        point1[2] = point2[2];
+                    }
+                }
+            }
+        }
+        int nr_done;
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+        nr_done = ++done;
+        if (thread_num == 0) {
+            cerr << (nr_done*100.0)/ncapsules << " %\r";
+            cerr.flush();
+        }
+    }
     size_t num_colliding = 0;
-    // the actual implementation of std::vector<bool> requires us to use the
-    // proxy iterator pattern with &&...
     for (i = 0; i < environ.size(); ++i) {
+        colliding[i] = collidingflags[i] != 0;
         if (colliding[i]) {
             num_colliding++;
         }
@@ -338,16 +450,30 @@ void calculate_collidingdist(DataXYZ &environ,
     cerr << "noncolliding: " << num_noncolliding << endl;
     cerr << "building kd tree..." << endl;
     KDtreeIndexed t(pa, num_noncolliding);
-    int thread_num = 0; // add omp later
+    std::vector<size_t> collidingidx;
+    collidingidx.reserve(num_colliding);
+    for (size_t i = 0; i < environ.size(); ++i) {
+        if (colliding[i]) {
+            collidingidx.push_back(i);
+        }
+    }
     cerr << "computing distances..." << endl;
     time_t before = time(NULL);
-    int j = 0;
-    for (size_t i = 0; i < environ.size(); ++i) {
-        if (!colliding[i]) {
-            continue;
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+    for (int j = 0; j < (int)collidingidx.size(); ++j) {
+#ifdef _OPENMP
+        int thread_num = omp_get_thread_num();
+#else
+        int thread_num = 0;
+#endif
+        size_t i = collidingidx[j];
+        if (thread_num == 0 && j % 1024 == 0) {
+            cerr << (j*100.0)/num_colliding << " %\r";
+            cerr.flush();
         }
-        cerr << (j*100.0)/num_colliding << " %\r";
-        cerr.flush();
         double point1[3] = {environ[i][0], environ[i][1], environ[i][2]};
         // for this colliding point, find the closest non-colliding one
         size_t c = t.FindClosest(point1, 1000000, thread_num);
@@ -360,7 +486,6 @@ void calculate_collidingdist(DataXYZ &environ,
         c = idxmap[c];
         double point2[3] = {environ[c][0], environ[c][1], environ[c][2]};
         dist_colliding[j] = sqrt(Dist2(point1, point2));
-        j++;
     }
     time_t after = time(NULL);
     cerr << "took: " << difftime(after, before) << " seconds" << endl;
@@ -397,14 +522,30 @@ void calculate_collidingdist2(std::vector<Point> &pointmodel, DataXYZ &environ,
     cerr << "building kd tree..." << endl;
     KDtreeIndexed t(pa, num_colliding);
     double sqRad2 = radius*radius;
-    int thread_num = 0; // add omp later
     cerr << "computing distances..." << endl;
     time_t before = time(NULL);
-    int i = 0;
     int end = trajectory.size();
-    for(const auto &it2 : trajectory) {
-        cerr << (i*100.0)/end << " %\r";
-        cerr.flush();
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
+    {
+#ifdef _OPENMP
+    int thread_num = omp_get_thread_num();
+#else
+    int thread_num = 0;
+#endif
+    // each thread keeps its own maximum, they are merged at the end
+    std::vector<float> dist_thread(dist_colliding.size(), 0);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int i = 0; i < end; ++i) {
+        const Frame &it2 = trajectory[i];
+        if (thread_num == 0) {
+            cerr << (i*100.0)/end << " %\r";
+            cerr.flush();
+        }
         for(const auto &it : pointmodel) {
             double point1[3] = {it.x, it.y, it.z};
             // the second point is the projection of the first point to the
@@ -423,13 +564,21 @@ void calculate_collidingdist2(std::vector<Point> &pointmodel, DataXYZ &environ,
                 // with the same penetration distance
                 vector<size_t> closestsphere = t.fixedRangeSearch(pa[c1], sqRad2, thread_num);
                 for (const auto &it3 : closestsphere) {
-                    if (dist_colliding[it3] < dist2) {
-                        dist_colliding[it3] = dist2;
+                    if (dist_thread[it3] < dist2) {
+                        dist_thread[it3] = dist2;
                     }
                 }
             }
         }
-        i++;
+    }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    for (size_t j = 0; j < dist_colliding.size(); ++j) {
+        if (dist_colliding[j] < dist_thread[j]) {
+            dist_colliding[j] = dist_thread[j];
+        }
+    }
     }
     for (size_t i = 0; i < dist_colliding.size(); ++i) {
         dist_colliding[i] = sqrt(dist_colliding[i]);
@@ -479,8 +628,7 @@ int main(int argc, char **argv)
     }
     DataXYZ model(it[0]->get("xyz"));
     DataXYZ environ(it[1]->get("xyz"));
-    std::vector<bool> colliding;
-    colliding.reserve(environ.size());
+    std::vector<bool> colliding(environ.size(), false);
     cerr << "reading model..." << endl;
     vector<Point> pointmodel;
     pointmodel.reserve(model.size());
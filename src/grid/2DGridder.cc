@@ -67,7 +67,7 @@ void usage(char* prog)
 	 << "Usage: " << prog << endl
 	 << "       [-s NR] [-e NR] [-m NR] [-M NR] [-f F] [-o DIR] [-t] " << endl
 	 << "       [-h NR] [-H NR] [-r NR] [-w] [-p NR] [-P Nr] [-y] [-n] " <<endl
-	 << "       [-g] [-d] [-l] [-a NR] inputdirectory" << endl << endl;
+	 << "       [-g] [-d] [-l] [-a NR] [-b NR] inputdirectory" << endl << endl;
     
     cout << "  -s NR   start at scan NR (i.e., neglects the first NR scans)" << endl
 	 << "          [ATTENTION: counting starts with 0]" << endl
@@ -104,6 +104,7 @@ void usage(char* prog)
 	 << "  -c      default 50. This is the numbers of scans which " << endl
 	 << "          will be process at a time" << endl
 	 << "  -R      default false, if set the programm will resume " << endl
+	 << "  -b NR   default 512, the memory for parcels kept in memory (MB)" << endl
 	 << endl << endl;
 
     exit(1);
@@ -149,6 +150,7 @@ bool directoryExists(const string path )
  * @param parcel_width the width of the parcel
  * @param parcel_height the height of the parcel
  * @param correctY default true, if set false (if true the transformationmatrix of the scans will be corrected (the value for Y)
+ * @param parcelMemory the memory for parcels kept in memory (MB)
  * @return 0, if the parsing was successful, 1 otherwise 
  */
 int parseArgs(int argc, char **argv,
@@ -160,7 +162,7 @@ int parseArgs(int argc, char **argv,
 	      int &parcelWidth, int &parcelHeight,
 	      bool &writeWorld, bool &writeLines, bool &writeGrids,
 	      int &spotradius, bool &writeWorldppm, int& count,
-	      bool &resume)
+	      bool &resume, int &parcelMemory)
 {
     int  c;
     
@@ -169,7 +171,7 @@ int parseArgs(int argc, char **argv,
     extern int optind;
     
     cout << endl;
-    while ((c = getopt (argc, argv, "o:s:a:e:m:ncwgidlRM:h:H:f:r:p:P:yt")) != -1)
+    while ((c = getopt (argc, argv, "o:s:a:e:m:ncwgidlRM:h:H:f:r:p:P:ytb:")) != -1)
     {
       switch (c)
       {
@@ -264,6 +266,13 @@ int parseArgs(int argc, char **argv,
         case 'y':
           correctY = true;
           break;
+        case 'b':
+          parcelMemory = atoi(optarg);
+          if (parcelMemory < 1) { 
+            cerr << "Error: <parcel_memory> cannot be smaller than 1.\n"; 
+            exit(1); 
+          }
+          break;
         case 'a':
           spotradius = atoi(optarg);
           if (spotradius < 0) { 
@@ -360,6 +369,7 @@ int main(int argc, char **argv){
     double isSolidPoint = 0.2;
     int count = 50;
     bool resume = false;
+    int parcelMemory = 512;
     ///////////////////////////////////////
 
 
@@ -371,7 +381,7 @@ int main(int argc, char **argv){
 	      createWaypoints, createNeighbours,
 	      parcelWidth, parcelHeight,
 	      writeWorld, writeLines, writeGrids, spotradius, writeWorldppm,
-	      count, resume);
+	      count, resume, parcelMemory);
 
     // calculate parcel width and height
     parcelWidth /= resolution;
@@ -380,7 +390,8 @@ int main(int argc, char **argv){
     // create parcelmanager
     cout << "Create parcelmanager ..." << endl;
     parcelmanager parcelman(parcelWidth, parcelHeight,
-			    outputdir, resolution, resume);
+			    outputdir, resolution, resume,
+			    (size_t)parcelMemory * 1024 * 1024);
 
     cout << "Create viewpointlist ... " << endl;
     viewpointinfo viewpoint(outputdir);
@@ -8,6 +8,8 @@
  */
 
 #include "grid/gridWriter.h"
+#include "grid/parcel.h"
+#include <cstring>
 #include <iterator>
 #include <cstdlib>
 #include <iostream>
@@ -22,10 +24,11 @@ using std::ofstream;
  * successfull
  *
  * @param file The filename of the file
+ * @param mode The mode the file is opened with
  */
-gridWriter::gridWriter(string file)
+gridWriter::gridWriter(string file, std::ios_base::openmode mode)
 {   
-    this->stream.open(file.c_str());
+    this->stream.open(file.c_str(), mode);
     if(!this->stream.good())
     {
 	cerr << "ERROR: In gridWriter::gridWriter, unable to open the stream for gridWriter! " << endl;
@@ -101,7 +104,7 @@ void ppmWriter::write(const grid& grid)
  * @param file The filename to be opend.
  */
 parcelWriter::parcelWriter(string file)
-    : gridWriter(file)
+    : gridWriter(file, std::ios_base::out | std::ios_base::binary)
 {
 }
 
@@ -121,15 +124,25 @@ parcelWriter::parcelWriter(ofstream &stream)
  */
 void parcelWriter::write(const grid& grid)
 {
-    stream << grid.getSizeX() << " " << grid.getSizeZ() << endl;
-    stream << grid.getOffsetX() << " " << grid.getOffsetZ() << endl;
-
+    parcelheader header;
+    memcpy(header.magic, PARCEL_MAGIC, sizeof(header.magic));
+    header.offsetX = grid.getOffsetX();
+    header.offsetZ = grid.getOffsetZ();
+    header.sizeX = grid.getSizeX();
+    header.sizeZ = grid.getSizeZ();
+    stream.write((const char*)&header, sizeof(header));
+
+    // write a column at a time, the coordinates are implied by the order
+    std::vector<unsigned int> column(2 * grid.getSizeZ());
     for(long i = 0; i < grid.getSizeX(); ++i)
+    {
 	for(long j = 0; j < grid.getSizeZ(); j++)
-	    stream << grid.points[i][j]->getX() << " "
-		   << grid.points[i][j]->getZ() << " "
-		   << grid.points[i][j]->getCount() << " "
-		   << grid.points[i][j]->getOccupied() << endl;
+	{
+	    column[2*j] = grid.points[i][j]->getCount();
+	    column[2*j + 1] = grid.points[i][j]->getOccupied();
+	}
+	stream.write((const char*)&column[0], column.size() * sizeof(unsigned int));
+    }
 }
       
 /**
@@ -9,6 +9,8 @@
 
 #include "grid/parcel.h"
 #include <fstream>
+#include <vector>
+#include <cstring>
 #include <cstdlib>
 #include <iostream>
 using std::cerr;
@@ -64,43 +66,71 @@ void parcel::addGrid(const grid* g)
  * The static method reads the file and creates a new parcel.
  * The parcel is allocated with new, so the caller has to make
  * sure it is deleted properly!
+ * Files in the binary format (see parcelheader) and in the older
+ * text format are accepted.
  *
  * @param filename the filename of the parcel
  * @return parcel the created parcel
  */
 parcel* parcel::readParcel(std::string filename)
 {
-    std::ifstream infile(filename.c_str());
-    
+    std::ifstream infile(filename.c_str(), std::ios::in | std::ios::binary);
+
     // Stream ok?
     if(!infile.good())
     {
 	std::cerr << "ERROR: In parcel::readparcel, couldn't open stream!" << std::endl;
 	exit(1);
     }
-    
+
+    parcelheader header;
+    if(infile.read((char*)&header, sizeof(header)) &&
+       memcmp(header.magic, PARCEL_MAGIC, sizeof(header.magic)) == 0)
+    {
+	parcel* p = new parcel(header.offsetX, header.offsetZ,
+			       header.sizeX, header.sizeZ);
+
+	// Read a column at a time
+	std::vector<unsigned int> column(2 * header.sizeZ);
+	for(long i = 0; i < header.sizeX; ++i)
+	{
+	    if(!infile.read((char*)&column[0], column.size() * sizeof(unsigned int)))
+	    {
+		std::cerr << "ERROR: In parcel::readparcel, " << filename
+			  << " is truncated!" << std::endl;
+		exit(1);
+	    }
+	    for(long j = 0; j < header.sizeZ; ++j)
+		p->points[i][j]->setFixed(column[2*j], column[2*j + 1]);
+	}
+
+	infile.close();
+	return p;
+    }
+
+    // text format
+    infile.clear();
+    infile.seekg(0);
+
     // Read sizes
     long sizeX;
     long sizeZ;
     infile >> sizeX >> sizeZ;
-    
+
     // Read offsets
     long offsetX;
     long offsetZ;
     infile >> offsetX >> offsetZ;
 
     // Create parcel
-    parcel* p = new parcel(offsetX, offsetZ, sizeX, sizeX);
+    parcel* p = new parcel(offsetX, offsetZ, sizeX, sizeZ);
     
     // Read all information
     long x, z, count, occupied;
-    while(!infile.eof())
-    {
-	infile >> x >> z >> count >> occupied;
+    while(infile >> x >> z >> count >> occupied)
 	p->setPoint(x, z, count, occupied);      	
-    }
-    
+
     infile.close();
-    
+
     return p;
 }
@@ -10,6 +10,7 @@
 #include "grid/parcelmanager.h"
 #include "slam6d/globals.icc"
 #include "grid/gridWriter.h"
+#include <vector>
 #include <fstream>
 using std::ifstream;
 using std::ofstream;
@@ -17,6 +18,18 @@ using std::ofstream;
 using std::cerr;
 using std::endl;
 
+/**
+ * Returns the index of the tile containing the absolute coordinate x,
+ * i.e. x divided by size, rounded towards negative infinity.
+ *
+ * @param x The absolute coordinate
+ * @param size The size of a tile
+ */
+static inline long tileIndex(long x, long size)
+{
+    return x >= 0 ? x / size : -((size - 1 - x) / size);
+}
+
 /**
  * Ctor.
  * Sets the static size information of the parcelinfo-class.
@@ -24,17 +37,19 @@ using std::endl;
  * If the file was read successfully, it contains the parcels created
  * during the last run of the programm. (See the resumeflag in the
  * documentation for more infos)
- * 
+ * The memory determines how many parcels are kept in memory, at least
+ * the parcels needed by the current grid are always loaded.
  * 
  * @param width The width of each parcel
  * @param height The height of each parcel
  * @param path The path of the files
  * @param resolution The resolution of a cell
  * @param resume If true, last parcelinfofile will be loaded
+ * @param memory The memory for loaded parcels in bytes
  */
 parcelmanager::parcelmanager(long width, long height,
 			     string path, int resolution,
-			     bool resume)
+			     bool resume, size_t memory)
 {
     this->parcelwidth = width;
     this->parcelheight = height;
@@ -47,9 +62,19 @@ parcelmanager::parcelmanager(long width, long height,
     this->maxX = 0;
     this->minZ = 0;
     this->maxZ = 0;
+
+    // each cell is a pointer to a separately allocated gridPoint
+    size_t parcelsize = (size_t)width * height
+	* (sizeof(gridPoint) + sizeof(gridPoint*));
+    this->cachesize = memory / parcelsize;
+    if(this->cachesize < 1)
+	this->cachesize = 1;
     
     parcelinfo::setParcelsize(width, height);
 
+    this->stop = false;
+    this->writer = boost::thread(&parcelmanager::writerThread, this);
+
     // loadParcelinfo if programm should resume
     if(resume)
       loadParcelinfo(this->path + PARCELINFOFILE);
@@ -60,69 +85,183 @@ parcelmanager::parcelmanager(long width, long height,
  * Calls saveParcelinfo for saving infos about 
  * already created parcel.
  * It also clears the internal structur (calls clear())
+ * and waits for the writer thread to store the last parcels
  */
 parcelmanager::~parcelmanager()
 {
     saveParcelinfo(this->path + PARCELINFOFILE);
   
     clear();
+
+    {
+	boost::lock_guard<boost::mutex> lock(mutex);
+	this->stop = true;
+    }
+    wakeup.notify_all();
+    writer.join();
+}
+
+/**
+ * The writer thread. Writes the queued parcels in the parcel format
+ * and frees them afterwards.
+ * (Must use parcelFormat, otherwise parcel cant be loaded again!)
+ */
+void parcelmanager::writerThread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while(true)
+    {
+	while(this->pending.empty() && !this->stop)
+	    wakeup.wait(lock);
+	if(this->pending.empty())
+	    return;
+
+	std::pair<string, parcel*> job = this->pending.front();
+	this->pending.pop_front();
+	this->writing = job.first;
+	written.notify_all();
+	lock.unlock();
+
+	{
+	    parcelWriter writer(job.first);
+	    writer.write(*job.second);
+	}
+	delete job.second;
+
+	lock.lock();
+	this->writing.clear();
+	written.notify_all();
+    }
+}
+
+/**
+ * Hands the parcel over to the writer thread, which frees it after
+ * writing. The parcel counts against the memory budget until then.
+ *
+ * @param filename The file of the parcel
+ * @param p The parcel
+ */
+void parcelmanager::writeParcel(const string &filename, parcel *p)
+{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    this->pending.push_back(std::make_pair(filename, p));
+    wakeup.notify_one();
+}
+
+/**
+ * Takes a parcel, that is still waiting to be written, back from the
+ * queue. If it is being written at the moment, the method waits until
+ * the file is complete.
+ *
+ * @param filename The file of the parcel
+ * @return the parcel, or NULL if it is not queued
+ */
+parcel* parcelmanager::reclaimParcel(const string &filename)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while(this->writing == filename)
+	written.wait(lock);
+
+    std::list<std::pair<string, parcel*> >::iterator it;
+    for(it = this->pending.begin(); it != this->pending.end(); ++it)
+    {
+	if(it->first == filename)
+	{
+	    parcel *p = it->second;
+	    this->pending.erase(it);
+	    written.notify_all();
+	    return p;
+	}
+    }
+    return NULL;
 }
 
 /**
- * This methods removes all parcels with a not set
- * used-flag (in parcelinfo). They are saved to disk
- * before they are freed.
- * If all is set, all parcels are saved and free regardless
- * of their used-flag
+ * Waits until the writer thread has stored all queued parcels
+ */
+void parcelmanager::flush()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while(!this->pending.empty() || !this->writing.empty())
+	written.wait(lock);
+}
+
+/**
+ * Returns the number of parcels in memory, the loaded ones and those
+ * queued or being written. The mutex must be held.
+ */
+size_t parcelmanager::parcelsInMemory() const
+{
+    return this->lru.size() + this->pending.size()
+	+ (this->writing.empty() ? 0 : 1);
+}
+
+/**
+ * This methods removes the least recently used parcels from memory
+ * until the memory budget is met. Parcels with a set used-flag (in
+ * parcelinfo) are kept. Changed parcels are saved to disk before
+ * they are freed, unchanged ones are dropped. Parcels waiting for
+ * the writer thread count against the budget, so the method waits
+ * for the writer if the budget is still exceeded.
+ * If all is set, all parcels are freed regardless of their used-flag.
  *
  * @param all Delete all parcels or not?
  */
 void parcelmanager::freeMemory(bool all)
 {
-    parcelmap::iterator cur = this->parcels.begin();
-    parcelmap::iterator end = this->parcels.end();
+    std::list<tilekey>::iterator cur = this->lru.end();
     
-    // iterate through each parcel
-    while(cur != end)
+    // iterate from the least recently used parcel
+    while(cur != this->lru.begin())
     {
-	// if parcel is loaded and wasnt used (or all free)
-	if(cur->second != NULL &&
-	   (!cur->first->wasUsed() || all))
-	{	    
-	    // saving the parcel using the parcel format
-            // (Must use parcelFormat, otherwise parcel cant be loaded again!)
-	    string filename = cur->first->getFilename();
-	    parcelWriter writer(filename);
-
-	    writer.write(*cur->second);
-	    
-	    delete cur->second;
-	    cur->second = NULL;
-	    
+	if(!all)
+	{
+	    boost::lock_guard<boost::mutex> lock(mutex);
+	    if(parcelsInMemory() <= this->cachesize)
+		break;
 	}
-	
-	// reset used-flag of parcelinfo
-	parcelinfo *p = cur->first;
-	p->resetUsed();
-	
-	++cur;
+
+	--cur;
+	tile &t = this->parcels[*cur];
+
+	if(t.info->wasUsed() && !all)
+	    continue;
+
+	if(t.dirty)
+	    writeParcel(t.info->getFilename(), t.data);
+	else
+	    delete t.data;
+
+	t.data = NULL;
+	t.dirty = false;
+	cur = this->lru.erase(cur);
     }
+
+    if(all)
+	return;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while(parcelsInMemory() > this->cachesize
+	  && (!this->pending.empty() || !this->writing.empty()))
+	written.wait(lock);
 }
 
 /**
  * The method frees all created parcelinfos and clears the map.
  * First it calls freeMemory(true) to save all parcels in memory
+ * and waits until they are written.
  */ 
 void parcelmanager::clear()
 {
   freeMemory(true);
+  flush();
   
   parcelmap::iterator it = this->parcels.begin();
   parcelmap::iterator end = this->parcels.end();
 
   while(it != end)
   {
-      delete it->first;      
+      delete it->second.info;
       ++it;
   }
 
@@ -130,55 +269,69 @@ void parcelmanager::clear()
 }
 
 /**
- * The methods loads the parcel specified by info
- * into memory. The method does check, if the 
+ * The methods loads the parcel of the tile into memory and marks it
+ * as the most recently used one. The method does check, if the 
  * parcel is already loaded, so calling this method
- * on an already loaded parcel does nothing.
+ * on an already loaded parcel does nothing else.
+ * A parcel still waiting to be written is taken from the write queue
+ * instead of the file.
  *
- * @param *info A pointer to the parcelinfo 
+ * @param key The tile coordinates
+ * @param t The tile
+ * @return the parcel
  */
-void parcelmanager::loadParcel(parcelinfo* info)
+parcel* parcelmanager::loadParcel(const tilekey &key, tile &t)
 {
-    if(this->parcels[info] == NULL)
-    	this->parcels[info] = parcel::readParcel(info->getFilename());
+    if(t.data != NULL)
+    {
+	this->lru.splice(this->lru.begin(), this->lru, t.lru);
+	return t.data;
+    }
 
-    updateOuterPoints(this->parcels[info]);    
+    t.data = reclaimParcel(t.info->getFilename());
+    t.dirty = t.data != NULL;
+    if(t.data == NULL)
+	t.data = parcel::readParcel(t.info->getFilename());
+
+    this->lru.push_front(key);
+    t.lru = this->lru.begin();
+
+    updateOuterPoints(t.data);
+    return t.data;
 }
 
 
 /**
- * The method creates a new parcel. It calculates the offset
- * of the new parcel based on the absolute coordinates it is given.
+ * The method creates a new parcel for the given tile coordinates.
  * The new parcel is added to the internal map, along with its
  * parcelinfo
  *
- * @param x The absolute x coordinate
- * @param z The absolute z coordinate
+ * @param key The tile coordinates
+ * @return the new tile
  */
-void parcelmanager::createParcel(long x, long z)
+parcelmanager::tile& parcelmanager::createParcel(const tilekey &key)
 {
     // calculate offset
-    long offsetX = (long) (x / this->parcelwidth) * this->parcelwidth;
-    if (x < 0) 
-	offsetX = offsetX - this->parcelwidth;
-
-    long offsetZ = (long) (z/ this->parcelheight) * this->parcelheight;
-    if (z < 0)
-	offsetZ = offsetZ - this->parcelheight;
-
+    long offsetX = key.first * this->parcelwidth;
+    long offsetZ = key.second * this->parcelheight;
 
     // create parcelinfo and parcel
     string filename = this->path + "parcel" + to_string(offsetX) + to_string(offsetZ) + ".pcl";
     
-    parcelinfo *p = new parcelinfo(offsetX, offsetZ, filename);
-    
-    this->parcels[p] = new parcel(offsetX,
-				  offsetZ,
-				  this->parcelwidth,
-				  this->parcelheight);  
+    tile &t = this->parcels[key];
+    t.info = new parcelinfo(offsetX, offsetZ, filename);
+    t.data = new parcel(offsetX,
+			offsetZ,
+			this->parcelwidth,
+			this->parcelheight);  
+    t.dirty = true;
+
+    this->lru.push_front(key);
+    t.lru = this->lru.begin();
 
     // update the new borders
-    updateOuterPoints(this->parcels[p]);    
+    updateOuterPoints(t.data);    
+    return t;
 }
 
 /**
@@ -212,64 +365,45 @@ void parcelmanager::updateOuterPoints(const grid *g)
  */
 void parcelmanager::addGrid(const grid* g, long vpX, long vpZ)
 {
-  bool parcelFound;
- 
   this->viewpointX = vpX;
   this->viewpointZ = vpZ;
-  
-  long iSize = g->getOffsetX() + g->getSizeX();
-  long jSize = g->getOffsetZ() + g->getSizeZ();
 
-  // iterate through all parcels needed in this grid
-  for(int i=g->getOffsetX() ; i < iSize + this->parcelwidth; i += this->parcelwidth)
+  long minI = tileIndex(g->getOffsetX(), this->parcelwidth);
+  long maxI = tileIndex(g->getOffsetX() + g->getSizeX() - 1, this->parcelwidth);
+  long minJ = tileIndex(g->getOffsetZ(), this->parcelheight);
+  long maxJ = tileIndex(g->getOffsetZ() + g->getSizeZ() - 1, this->parcelheight);
+
+  std::vector<tile*> needed;
+
+  // look up all parcels needed in this grid
+  for(long i = minI; i <= maxI; ++i)
   {
-      for(int j=g->getOffsetZ() ; j < jSize + this->parcelheight; j += this->parcelheight)
+      for(long j = minJ; j <= maxJ; ++j)
       {
-	  parcelmap::iterator it = this->parcels.begin();
-	  parcelmap::iterator end = this->parcels.end();
-      
-	  parcelFound = false;
-
-	  // for each point, iterate through the existing parcels
-	  while(it != end)
-	  {
-	      // parcel contains point
-	      if(it->first->contains(i, j))
-	      {
-		  // load Parcel if not in memory
-		  if(it->second == NULL)
-		      loadParcel(it->first);
-		  
-		  // reset the counter
-		  it->first->setUsed();
-		  parcelFound = true;
-	      }	
-
-	      ++it;
-	  }
-	  
-	  // if parcel was not found, create new
-	  if(parcelFound == false)
-	      createParcel(i, j);
+	  tilekey key(i, j);
+	  parcelmap::iterator it = this->parcels.find(key);
+
+	  // if parcel was not found, create new,
+	  // load Parcel if not in memory
+	  tile &t = it == this->parcels.end() ? createParcel(key) : it->second;
+	  loadParcel(key, t);
+
+	  t.info->setUsed();
+	  needed.push_back(&t);
       }
   }
 
-  // remove all parcels not needed for the scan
+  // remove parcels not needed for the scan, if the memory is exhausted
   freeMemory(false); 
 
-  
-  // Call addGrid for each parcel in memory
+  // Call addGrid for each needed parcel
   // The parcel only integrates the points which are
   // relevant to it 
-  parcelmap::iterator it = this->parcels.begin();
-  parcelmap::iterator end = this->parcels.end();
-  
-  while(it != end)
+  for(size_t k = 0; k < needed.size(); ++k)
   {
-      if(it->second != NULL)
-	  it->second->addGrid(g);
-
-      ++it;
+      needed[k]->data->addGrid(g);
+      needed[k]->dirty = true;
+      needed[k]->info->resetUsed();
   }
 }
 
@@ -300,9 +434,9 @@ void parcelmanager::saveParcelinfo(string filename)
   
   while(it != end)
   {
-       outfile << it->first->getOffsetX() << " " 
-	       << it->first->getOffsetZ() << " " 
-	       << it->first->getFilename() << endl; 
+       outfile << it->second.info->getOffsetX() << " " 
+	       << it->second.info->getOffsetZ() << " " 
+	       << it->second.info->getFilename() << endl; 
 
         ++it;
   }
@@ -344,8 +478,26 @@ void parcelmanager::loadParcelinfo(string filename)
     infile >> file;
     if(infile.eof()) continue;
 
-    parcelinfo *p = new parcelinfo(offsetX, offsetZ, file);
-    this->parcels[p] = NULL;
+    tilekey key(tileIndex(offsetX, this->parcelwidth),
+		tileIndex(offsetZ, this->parcelheight));
+    if(this->parcels.count(key))
+	continue;
+
+    tile &t = this->parcels[key];
+    t.info = new parcelinfo(offsetX, offsetZ, file);
+    t.info->resetUsed();
+    t.data = NULL;
+    t.dirty = false;
+
+    // the borders are needed before the parcel is loaded
+    if(offsetX < minX)
+	minX = offsetX;
+    if(offsetZ < minZ)
+	minZ = offsetZ;
+    if(offsetX + this->parcelwidth > maxX)
+	maxX = offsetX + this->parcelwidth;
+    if(offsetZ + this->parcelheight > maxZ)
+	maxZ = offsetZ + this->parcelheight;
   }
 
   infile.close();
@@ -354,7 +506,7 @@ void parcelmanager::loadParcelinfo(string filename)
 /**
  * This method is able to write the entire world, based on all parcels and create and write lines.
  * Each parcel is loaded and then written into a single file.
- * Afterwards ALL parcels are stored to file and freed from memory.
+ * Parcels are freed from memory as the budget requires.
  * Additionally the world is written in ppm format and lines can be created and written.
  *
  * The map is written in a format which can be read by the MapViewer of Group2.
@@ -374,10 +526,8 @@ void parcelmanager::writeWorld(string file)
     
     while(it != end)
     {
-	if(it->second == NULL)
-	    loadParcel(it->first);
-
-	writer.write(*it->second);
+	writer.write(*loadParcel(it->first, it->second));
+	freeMemory(false);
 	
 	++it;
     }
@@ -400,16 +550,16 @@ grid* parcelmanager::createWorldGrid()
     // Go through all parcels
     while(it != end)
     {
-	if(it->second == NULL)
-	    loadParcel(it->first);
+	parcel *p = loadParcel(it->first, it->second);
 
-	for(int i=0; i < it->second->getSizeX(); ++i)
+	for(int i=0; i < p->getSizeX(); ++i)
 	{
-	    for(int j=0; j < it->second->getSizeZ(); ++j)
+	    for(int j=0; j < p->getSizeZ(); ++j)
 	    {
-		g->addPoint(*(it->second->points[i][j]));
+		g->addPoint(*(p->points[i][j]));
 	    }
 	}
+	freeMemory(false);
 	
 	++it;
     }
@@ -64,6 +64,7 @@ model::LabeledPlane3d::LabeledPlane3d(const Point3d& pt, const Vector3d& normal,
 
 model::LabeledPlane3d::LabeledPlane3d(const LabeledPlane3d& other) : Plane3d(other) {
     this->patches= other.patches;
+    this->labels = other.labels;
     this->depthMap = other.depthMap;
     this->depthImg = other.depthImg;
     this->correctedDepthImg = other.correctedDepthImg;
@@ -76,6 +77,7 @@ model::LabeledPlane3d& model::LabeledPlane3d::operator=(const LabeledPlane3d& ot
     if (this != &other) {
         Plane3d::operator =(other);
         this->patches= other.patches;
+        this->labels = other.labels;
         this->depthMap = other.depthMap;
         this->depthImg = other.depthImg;
         this->correctedDepthImg = other.correctedDepthImg;
@@ -86,8 +88,8 @@ model::LabeledPlane3d& model::LabeledPlane3d::operator=(const LabeledPlane3d& ot
 }
 
 void model::LabeledPlane3d::detectEdges(cv::Mat& canny, cv::Mat& hSobel, cv::Mat& vSobel, cv::Mat& combined) const {
-    int imgHeight = static_cast<int>(this->depthMap.size());
-    int imgWidth  = static_cast<int>(this->depthMap.front().size());
+    int imgHeight = this->depthMap.rows();
+    int imgWidth  = this->depthMap.cols();
 
     if (imgHeight == 0 || imgWidth == 0) {
         throw runtime_error("please initialize the patches and depth map for labeled plane");
@@ -114,14 +116,14 @@ void model::LabeledPlane3d::detectEdges(cv::Mat& canny, cv::Mat& hSobel, cv::Mat
 
 void model::LabeledPlane3d::computeLines(std::vector<int>& verticalResult, std::vector<int>& horizontalResult) const {
 
-    if (this->depthMap.size() != this->patches.size() ||
-            this->depthMap.front().size() != this->patches.front().size())
+    if (this->depthMap.rows() != this->patches.rows() ||
+            this->depthMap.cols() != this->patches.cols())
     {
         throw runtime_error("depth map and patch matrix must match in sizes");
     }
 
-    int imgHeight = static_cast<int>(this->depthMap.size());
-    int imgWidth  = static_cast<int>(this->depthMap.front().size());
+    int imgHeight = this->depthMap.rows();
+    int imgWidth  = this->depthMap.cols();
 
     if (imgHeight == 0 || imgWidth == 0) {
         throw runtime_error("please initialize the patches and depth map for labeled plane");
@@ -198,14 +200,14 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
     // make sure the result is empty
     result.clear();
 
-    if (this->depthMap.size() != this->patches.size() ||
-            this->depthMap.front().size() != this->patches.front().size())
+    if (this->depthMap.rows() != this->patches.rows() ||
+            this->depthMap.cols() != this->patches.cols())
     {
         throw runtime_error("depth map and patch matrix must match in sizes");
     }
 
-    int imgHeight = static_cast<int>(this->depthMap.size());
-    int imgWidth  = static_cast<int>(this->depthMap.front().size());
+    int imgHeight = this->depthMap.rows();
+    int imgWidth  = this->depthMap.cols();
 
     if (imgHeight == 0 || imgWidth == 0) {
         throw runtime_error("please initialize the patches and depth map for labeled plane");
@@ -216,8 +218,8 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
     this->computeLines(vertical, horizontal);
 
     // we require the total wall area to discard a few small candidates
-    double wCentimetersWall = this->patches[0][0].first.distance(this->patches[0][imgWidth - 1].first);
-    double hCentimetersWall = this->patches[0][0].first.distance(this->patches[imgHeight - 1][0].first);
+    double wCentimetersWall = this->patches[0][0].distance(this->patches[0][imgWidth - 1]);
+    double hCentimetersWall = this->patches[0][0].distance(this->patches[imgHeight - 1][0]);
     double wallArea = wCentimetersWall * hCentimetersWall;
 
     // put temporary candidates in here
@@ -234,8 +236,8 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
                 for (vector<int>::iterator x2 = x1 + 1; x2 != vertical.end(); ++x2) {
 
                     // do not add really small candidates that are smaller than a certain percentage of the whole wall
-                    double wCentiMeters = this->patches[0][*x2].first.distance(this->patches[0][*x1].first);
-                    double hCentiMeters = this->patches[*y2][0].first.distance(this->patches[*y1][0].first);
+                    double wCentiMeters = this->patches[0][*x2].distance(this->patches[0][*x1]);
+                    double hCentiMeters = this->patches[*y2][0].distance(this->patches[*y1][0]);
                     double area = wCentiMeters * hCentiMeters;
 
                     if (area < MIN_TOTAL_AREA * wallArea || area > MAX_TOTAL_AREA * wallArea) {
@@ -249,10 +251,10 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
 
                     // compute the hull
                     vector<Point3d> hull;
-                    hull.push_back(this->patches[*y1][*x1].first);
-                    hull.push_back(this->patches[*y1][*x2].first);
-                    hull.push_back(this->patches[*y2][*x2].first);
-                    hull.push_back(this->patches[*y2][*x1].first);
+                    hull.push_back(this->patches[*y1][*x1]);
+                    hull.push_back(this->patches[*y1][*x2]);
+                    hull.push_back(this->patches[*y2][*x2]);
+                    hull.push_back(this->patches[*y2][*x1]);
 
                     // compute the normal application point
                     Point3d pt(0.0, 0.0, 0.0);
@@ -288,8 +290,8 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
         int h = abs(y2 - y1);
 
         // first feature, the area of the opening
-        double wCentiMeters = this->patches[0][x2].first.distance(this->patches[0][x1].first);
-        double hCentiMeters = this->patches[y2][0].first.distance(this->patches[y1][0].first);
+        double wCentiMeters = this->patches[0][x2].distance(this->patches[0][x1]);
+        double hCentiMeters = this->patches[y2][0].distance(this->patches[y1][0]);
         double area = wCentiMeters * hCentiMeters;
         it->features.push_back(static_cast<double>(area));
 
@@ -304,13 +306,13 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
 
         // distance from every edge
         // upper horizontal line
-        it->features.push_back(this->patches[y1][0].first.distance(this->patches.front()[0].first));
+        it->features.push_back(this->patches[y1][0].distance(this->patches[0][0]));
         // lower horizontal line
-        it->features.push_back(this->patches[y2][0].first.distance(this->patches.back()[0].first));
+        it->features.push_back(this->patches[y2][0].distance(this->patches[imgHeight - 1][0]));
         // upper vertical line
-        it->features.push_back(this->patches[0][x1].first.distance(this->patches[0].front().first));
+        it->features.push_back(this->patches[0][x1].distance(this->patches[0][0]));
         // lower vertical line
-        it->features.push_back(this->patches[0][x2].first.distance(this->patches[0].back().first));
+        it->features.push_back(this->patches[0][x2].distance(this->patches[0][imgWidth - 1]));
 
         // compute the RMS of the plane fit residual for this particular rectangle
         // in the same time compute the area of each label
@@ -323,7 +325,7 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
                 // TODO should be computed accordingly
                 double temp = 0.0;
 
-                switch (this->patches[i][j].second) {
+                switch (this->labels[i][j]) {
                 case EMPTY:
                     empty++;
                     break;
@@ -0,0 +1,195 @@
+/**
+ * @file occupancyGrid.cc
+ *
+ * @date 18 Oct 2026
+ *
+ */
+
+//==============================================================================
+//  Includes
+//==============================================================================
+#include "model/occupancyGrid.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <limits>
+#include <stdexcept>
+using namespace std;
+
+//==============================================================================
+//  Implementation
+//==============================================================================
+
+/**
+ * Integer division rounding towards negative infinity.
+ */
+static inline long long floorDiv(long long a, long long b) {
+    long long q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+/**
+ * Integer division rounding towards positive infinity.
+ */
+static inline long long ceilDiv(long long a, long long b) {
+    return -floorDiv(-a, b);
+}
+
+model::OccupancyGrid::OccupancyGrid(double **points, unsigned int nrPoints,
+        double precision, double width)
+{
+    this->coef = pow(10.0, round(precision));
+    double half = width / 2.0;
+
+    for (unsigned int i = 0; i < nrPoints; ++i) {
+        // all lattice points whose cube contains the point, including its border
+        long long lo[3], hi[3];
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = (long long) floor(this->coef * (points[i][a] - half));
+            hi[a] = (long long) ceil(this->coef * (points[i][a] + half));
+        }
+
+        Key pt;
+        for (pt.x = lo[0]; pt.x <= hi[0]; ++pt.x) {
+            for (pt.y = lo[1]; pt.y <= hi[1]; ++pt.y) {
+                for (pt.z = lo[2]; pt.z <= hi[2]; ++pt.z) {
+                    Key b = { brickOf(pt.x), brickOf(pt.y), brickOf(pt.z) };
+
+                    unordered_map<Key, unsigned int, KeyHash>::iterator it = this->index.find(b);
+                    if (it == this->index.end()) {
+                        it = this->index.insert(make_pair(b, (unsigned int) this->bricks.size())).first;
+                        this->bricks.push_back(Brick());
+                        memset(this->bricks.back().bits, 0, sizeof(Brick));
+                    }
+
+                    unsigned int bit = ((pt.x - b.x * BRICK) * BRICK + (pt.y - b.y * BRICK)) * BRICK
+                            + (pt.z - b.z * BRICK);
+                    this->bricks[it->second].bits[bit / 64] |= 1ULL << (bit % 64);
+                }
+            }
+        }
+    }
+}
+
+const model::OccupancyGrid::Brick* model::OccupancyGrid::getBrick(const Key& pt) const {
+    Key b = { brickOf(pt.x), brickOf(pt.y), brickOf(pt.z) };
+    unordered_map<Key, unsigned int, KeyHash>::const_iterator it = this->index.find(b);
+    return it == this->index.end() ? NULL : &this->bricks[it->second];
+}
+
+bool model::OccupancyGrid::isMarked(const Brick* brick, const Key& pt) {
+    unsigned int bit = ((pt.x - brickOf(pt.x) * BRICK) * BRICK + (pt.y - brickOf(pt.y) * BRICK)) * BRICK
+            + (pt.z - brickOf(pt.z) * BRICK);
+    return (brick->bits[bit / 64] >> (bit % 64)) & 1;
+}
+
+model::DiscreteRay::DiscreteRay(Point3d src, Point3d dest, double precision, const double& extraDist) {
+    // add the extra distance, exactly like GraphicsAlg::getDiscreteLine
+    double len = src.distance(dest);
+    double temp = (len + extraDist) / len;
+    dest.x = src.x + (dest.x - src.x) * temp;
+    dest.y = src.y + (dest.y - src.y) * temp;
+    dest.z = src.z + (dest.z - src.z) * temp;
+
+    precision = round(precision);
+    if (precision < 0.0) {
+        throw logic_error("negative precision is not supported by the discrete ray");
+    }
+    if (!isfinite(dest.x) || !isfinite(dest.y) || !isfinite(dest.z)) {
+        throw logic_error("invalid branch taken while computing discrete line");
+    }
+
+    this->coef = pow(10.0, precision);
+    double s[] = { round(src.x) * coef, round(src.y) * coef, round(src.z) * coef };
+    double d[] = { round(dest.x) * coef, round(dest.y) * coef, round(dest.z) * coef };
+
+    for (int a = 0; a < 3; ++a) {
+        this->start[a] = (long long) s[a];
+        this->sign[a]  = d[a] - s[a] > 0 ? +1 : -1;
+        this->delta[a] = 2 * llabs((long long) d[a] - this->start[a]);
+    }
+
+    // same choice of the dominant axis as the Bresenham line
+    if (delta[0] >= max(delta[1], delta[2])) {
+        this->dom = 0;
+    } else if (delta[1] >= max(delta[0], delta[2])) {
+        this->dom = 1;
+    } else {
+        this->dom = 2;
+    }
+
+    for (int a = 0; a < 3; ++a) {
+        this->err[a] = delta[a] - delta[dom] / 2;
+    }
+    this->length = delta[dom] / 2;
+    this->step = 0;
+}
+
+long long model::DiscreteRay::moved(int a, long long k) const {
+    if (a == dom) {
+        return k;
+    }
+    // the decision variable before point k is err + k * delta[a] - moved * delta[dom]
+    if (k == 0) {
+        return 0;
+    }
+    long long n = floorDiv(err[a] + (k - 1) * delta[a], delta[dom]) + 1;
+    return n > 0 ? n : 0;
+}
+
+long long model::DiscreteRay::reached(int a, long long m) const {
+    if (a == dom) {
+        return m;
+    }
+    if (delta[a] == 0) {
+        return numeric_limits<long long>::max();
+    }
+    long long k = 1 + ceilDiv((m - 1) * delta[dom] - err[a], delta[a]);
+    return k > 1 ? k : 1;
+}
+
+bool model::DiscreteRay::nextCandidate(const OccupancyGrid& grid, Point3d& pt) {
+    const long long B = OccupancyGrid::BRICK;
+
+    while (step <= length) {
+        OccupancyGrid::Key p = {
+            start[0] + sign[0] * moved(0, step),
+            start[1] + sign[1] * moved(1, step),
+            start[2] + sign[2] * moved(2, step)
+        };
+        long long c[] = { p.x, p.y, p.z };
+
+        // the first point of the line outside the current brick
+        long long exit = length + 1;
+        for (int a = 0; a < 3; ++a) {
+            long long lo = OccupancyGrid::brickOf(c[a]) * B;
+            long long m = moved(a, step) + (sign[a] > 0 ? lo + B - c[a] : c[a] - lo + 1);
+            long long k = reached(a, m);
+            if (k < exit) {
+                exit = k;
+            }
+        }
+
+        const OccupancyGrid::Brick* brick = grid.getBrick(p);
+        if (brick != NULL) {
+            // test all points of the line inside this brick
+            for (; step < exit; ++step) {
+                OccupancyGrid::Key q = {
+                    start[0] + sign[0] * moved(0, step),
+                    start[1] + sign[1] * moved(1, step),
+                    start[2] + sign[2] * moved(2, step)
+                };
+                if (OccupancyGrid::isMarked(brick, q)) {
+                    pt = Point3d(q.x / coef, q.y / coef, q.z / coef);
+                    ++step;
+                    return true;
+                }
+            }
+        }
+
+        step = exit;
+    }
+
+    return false;
+}
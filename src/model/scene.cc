@@ -25,6 +25,16 @@
 #include <sys/stat.h>
 #include <errno.h>
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <limits>
 #include <iomanip>
 #include <fstream>
@@ -43,6 +53,24 @@ const double model::Scene::MIN_EDGE_COV = 0.60;
 //==============================================================================
 //  Implementation
 //==============================================================================
+
+/**
+ * Paints every label with its color, the labels are expected to be
+ * a CV_8UC1 image of model::Label values.
+ */
+static void colorLabels(const cv::Mat& labels, const cv::Vec3b colors[model::UNKOWN + 1],
+        cv::Mat& result)
+{
+    cv::Mat lut(1, 256, CV_8UC3, cv::Scalar(0, 0, 0));
+    for (int l = 0; l <= model::UNKOWN; ++l) {
+        lut.at<cv::Vec3b>(0, l) = colors[l];
+    }
+
+    cv::Mat labels3;
+    cv::cvtColor(labels, labels3, CV_GRAY2BGR);
+    cv::LUT(labels3, lut, result);
+}
+
 model::Scene::Scene(const IOType& type,
 				const int& start, const int& end,
 				std::string dir, const bool& scanserver,
@@ -182,6 +210,9 @@ model::Scene::Scene(const IOType& type,
     //this->_octTree->init();
     this->nrPoints = this->points.size();
 
+    // mark the lattice points of the rays that may be occupied
+    this->occupancy = new OccupancyGrid(this->octTreePoints, this->nrPoints, PRECISION, RAY_DIST);
+
     Scan::allScans.clear();
 }
 
@@ -191,6 +222,7 @@ model::Scene::Scene(const Scene& other) {
     this->walls   = other.walls;
     this->ceiling = other.ceiling;
     this->floor   = other.floor;
+    this->occupancy = NULL;
 }
 
 model::Scene::~Scene() {
@@ -207,6 +239,10 @@ model::Scene::~Scene() {
         }
         delete[] this->octTreePoints;
     }
+
+    if (this->occupancy != NULL) {
+        delete this->occupancy;
+    }
 }
 
 vector<model::Plane3d> model::Scene::getConvexHull(vector<Plane3d> planes) {
@@ -463,17 +499,17 @@ void model::Scene::detectWalls() {
 }
 
 bool model::Scene::castRay(const Point3d& src, const Point3d& dest, const double& extraDist,
-        Point3d& ptHit)
+        Point3d& ptHit, int threadNum)
 {
-    // put the Bresenham line in here, we need some extra distance in case the points are close
+    // walk the Bresenham line, we need some extra distance in case the points are close
     // but after the detected wall, therefore we need to go a bit further than the wall to check
-    vector<Point3d> line;
-    GraphicsAlg::getDiscreteLine(src, dest, PRECISION, extraDist, line);
+    DiscreteRay line(src, dest, PRECISION, extraDist);
 
-    // loop through all the points in the Bresenham line and decide if it hits something
-    for (vector<Point3d>::iterator it = line.begin(); it != line.end(); ++it) {
-        if (this->isOccupied(*it, RAY_DIST)) {
-            ptHit = *it;
+    // loop through the points of the line that might be occupied and decide if it hits something
+    Point3d pt;
+    while (line.nextCandidate(*this->occupancy, pt)) {
+        if (this->isOccupied(pt, RAY_DIST, threadNum)) {
+            ptHit = pt;
             return true;
         }
     }
@@ -493,105 +529,88 @@ void model::Scene::applyLabels(LabeledPlane3d& surf) {
     // determine the points on the plane for which to apply labels
     vector<vector<Point3d> > discretePoints = surf.getDiscretePoints(PATCH_DIST);
 
-    surf.patches.resize(discretePoints.size());
-    surf.depthMap.resize(discretePoints.size());
+    int rows = static_cast<int>(discretePoints.size());
+    int cols = static_cast<int>(discretePoints.front().size());
+
+    // consider everything is occluded initially
+    surf.patches.resize(rows, cols);
+    surf.labels.resize(rows, cols, OCCLUDED);
+    surf.depthMap.resize(rows, cols, WALL_DIST);
 
     // we need these values for later
     surf.depthMapDistances.first = WALL_DIST;
     surf.depthMapDistances.second = maxDist;
 
-    for (unsigned int i = 0; i < discretePoints.size(); ++i) {
-        for (unsigned int j = 0; j < discretePoints.front().size(); ++j) {
-            // consider everything is occluded initially
-            surf.patches[i].push_back(make_pair(discretePoints[i][j], OCCLUDED));
-            surf.depthMap[i].push_back(WALL_DIST);
-        }
+    for (int i = 0; i < rows; ++i) {
+        copy(discretePoints[i].begin(), discretePoints[i].begin() + cols, surf.patches[i]);
     }
 
     if (!quiet) cout << endl << "== Performing ray casting for surface centered at " << surf.pt << endl;
 
-    for (vector<Pose6d>::iterator srcPose = this->poses.begin(); srcPose != this->poses.end(); ++srcPose) {
-        for (unsigned int i = 0; i < surf.patches.size(); ++i) {
-            for (unsigned int j = 0; j <  surf.patches[i].size(); ++j) {
-                // prepare two points for ray casting through wall
-                Point3d ptOnWall  = surf.patches[i][j].first;
-                Point3d src(surf.normal.x + ptOnWall.x,
-                        surf.normal.y + ptOnWall.y,
-                        surf.normal.z + ptOnWall.z);
-
-                double len = ptOnWall.distance(src);
-                double temp = (len + WALL_DIST) / len;
-                src.x = ptOnWall.x + (src.x - ptOnWall.x) * temp;
-                src.y = ptOnWall.y + (src.y - ptOnWall.y) * temp;
-                src.z = ptOnWall.z + (src.z - ptOnWall.z) * temp;
-
-                // remember the point we hit when ray casting
-                Point3d ptHit;
-
-                if (insideHull(surf.patches[i][j].first, surf.hull) && castRay(src, ptOnWall, WALL_DIST, ptHit)) {
-                    surf.patches[i][j].second = OCCUPIED;
-                    surf.depthMap[i][j] = maxDist - src.distance(ptHit);
-                } else if (!castRay(srcPose->first, surf.patches[i][j].first, 0, ptHit)) {
-                    surf.patches[i][j].second = EMPTY;
+    // The ray through the wall does not depend on the pose, so a patch is
+    // occupied for all poses or for none. Otherwise it is empty as soon as
+    // one pose sees it, the remaining poses cannot change the label.
+#ifdef _OPENMP
+    // castRay uses the thread number as kd tree search slot
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < rows; ++i) {
+#ifdef _OPENMP
+        int thread_num = omp_get_thread_num();
+#else
+        int thread_num = 0;
+#endif
+
+        for (int j = 0; j < cols; ++j) {
+            // prepare two points for ray casting through wall
+            Point3d ptOnWall  = surf.patches[i][j];
+            Point3d src(surf.normal.x + ptOnWall.x,
+                    surf.normal.y + ptOnWall.y,
+                    surf.normal.z + ptOnWall.z);
+
+            double len = ptOnWall.distance(src);
+            double temp = (len + WALL_DIST) / len;
+            src.x = ptOnWall.x + (src.x - ptOnWall.x) * temp;
+            src.y = ptOnWall.y + (src.y - ptOnWall.y) * temp;
+            src.z = ptOnWall.z + (src.z - ptOnWall.z) * temp;
+
+            // remember the point we hit when ray casting
+            Point3d ptHit;
+
+            if (insideHull(ptOnWall, surf.hull) && castRay(src, ptOnWall, WALL_DIST, ptHit, thread_num)) {
+                surf.labels[i][j] = OCCUPIED;
+                surf.depthMap[i][j] = maxDist - src.distance(ptHit);
+                continue;
+            }
+
+            for (vector<Pose6d>::iterator srcPose = this->poses.begin(); srcPose != this->poses.end(); ++srcPose) {
+                if (!castRay(srcPose->first, ptOnWall, 0, ptHit, thread_num)) {
+                    surf.labels[i][j] = EMPTY;
                     surf.depthMap[i][j] = 0.0;
+                    break;
                 }
             }
         }
     }
 
-    // create the OpenCV depth image
-    int imgHeight = static_cast<int>(surf.depthMap.size());
-    int imgWidth  = static_cast<int>(surf.depthMap.front().size());
-
-    // crate an OpenCV image and allocate memory for it
-    cv::Mat img(imgHeight, imgWidth, CV_8UC1);
-
-    // compute the maximum from the image
-    double max = numeric_limits<double>::min();
-    for (int i = 0; i < imgHeight; ++i) {
-        for (int j = 0; j < imgWidth; ++j) {
-            if (max < surf.depthMap[i][j]) {
-                max = surf.depthMap[i][j];
-            }
-        }
+    // create the OpenCV depth image directly from the depth map
+    double max;
+    cv::minMaxLoc(surf.getDepthMapImg(), NULL, &max);
+    if (max < numeric_limits<double>::min()) {
+        max = numeric_limits<double>::min();
     }
+    surf.getDepthMapImg().convertTo(surf.depthImg, CV_8UC1, MAX_IMG_VAL / max);
 
     // write the current image to a file
-    cv::Mat labels(imgHeight, imgWidth, CV_8UC3);
+    cv::Vec3b colors[UNKOWN + 1];
+    colors[EMPTY]    = cv::Vec3b(0, 200, 0);
+    colors[OCCLUDED] = cv::Vec3b(200, 0, 0);
+    colors[OCCUPIED] = cv::Vec3b(0, 0, 200);
 
-    // adjust the image
-    for (int i = 0; i < imgHeight; ++i) {
-        for (int j = 0; j < imgWidth; ++j) {
-            img.data[(i * img.cols) + j] = static_cast<char>(MAX_IMG_VAL * surf.depthMap[i][j] / max);
-
-            // put the color into the image according to the label
-            int curr = (i * 3 * img.cols) + 3 * j;
-            switch (surf.patches[i][j].second) {
-            case EMPTY:
-            	labels.data[curr + 0] = 0;
-            	labels.data[curr + 1] = 200;
-            	labels.data[curr + 2] = 0;
-            	break;
-            case OCCLUDED:
-            	labels.data[curr + 0] = 200;
-            	labels.data[curr + 1] = 0;
-            	labels.data[curr + 2] = 0;
-            	break;
-            case OCCUPIED:
-            	labels.data[curr + 0] = 0;
-            	labels.data[curr + 1] = 0;
-            	labels.data[curr + 2] = 200;
-            	break;
-            default:
-					throw runtime_error("invalid default branch taken");
-					break;
-			}
-        }
-    }
+    cv::Mat labels;
+    colorLabels(surf.getLabelImg(), colors, labels);
     cv::imwrite("./img/labels.png", labels);
-
-    // copy the image
-    surf.depthImg = img.clone();
 }
 
 void model::Scene::applyAllLabels() {
@@ -1043,8 +1062,8 @@ void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<Cand
 void model::Scene::addFinalOpenings(const LabeledPlane3d& surf,
         std::vector<CandidateOpening>& result)
 {
-    int imgHeight = static_cast<int>(surf.depthMap.size());
-    int imgWidth  = static_cast<int>(surf.depthMap.front().size());
+    int imgHeight = surf.depthMap.rows();
+    int imgWidth  = surf.depthMap.cols();
 
     vector<CandidateOpening> openings, candidates;
     this->detectPotentialOpenings(surf, openings);
@@ -1102,17 +1121,17 @@ void model::Scene::addFinalOpenings(const LabeledPlane3d& surf,
 
         // add the new openings as windows
         Point3d pt(0.0, 0.0, 0.0);
-        pt += surf.patches[y1].front().first;
-        pt += surf.patches[y2].front().first;
-        pt += surf.patches.front()[x1].first;
-        pt += surf.patches.front()[x2].first;
+        pt += surf.patches[y1][0];
+        pt += surf.patches[y2][0];
+        pt += surf.patches[0][x1];
+        pt += surf.patches[0][x2];
         pt /= 4.0;
 
         vector<Point3d> hull;
-        hull.push_back(surf.patches[y1][x1].first);
-        hull.push_back(surf.patches[y1][x2].first);
-        hull.push_back(surf.patches[y2][x2].first);
-        hull.push_back(surf.patches[y2][x1].first);
+        hull.push_back(surf.patches[y1][x1]);
+        hull.push_back(surf.patches[y1][x2]);
+        hull.push_back(surf.patches[y2][x2]);
+        hull.push_back(surf.patches[y2][x1]);
 
         Plane3d toPush(pt, surf.normal, hull);
         this->finalOpenings.push_back(toPush);
@@ -1129,104 +1148,44 @@ void model::Scene::addFinalOpenings(const LabeledPlane3d& surf,
 void model::Scene::correct(LabeledPlane3d& surf, const vector<CandidateOpening>& openings) {
     if (!quiet) cout << endl << "== Correcting surface centered at " << surf.pt << endl;
 
-    int imgHeight = static_cast<int>(surf.depthMap.size());
-    int imgWidth  = static_cast<int>(surf.depthMap.front().size());
+    int imgHeight = surf.depthMap.rows();
+    int imgWidth  = surf.depthMap.cols();
 
-    // some images we are interested in
+    // some images we are interested in, labels shares the memory of surf.labels
     cv::Mat depthImg = surf.depthImg.clone();
-    cv::Mat depthImgMask(imgHeight, imgWidth, CV_8UC1);
-    cv::Mat labelsImg(imgHeight, imgWidth, CV_8UC3);
-
-    // compute the maximum from the image
-    double max = numeric_limits<double>::min();
-    double mean = 0.0, stdDev = 0.0;
-    int count = 0;
-
-    for (int i = 0; i < imgHeight; ++i) {
-        for (int j = 0; j < imgWidth; ++j) {
-            // set all empty and occluded to unknown
-            if (surf.patches[i][j].second == EMPTY || surf.patches[i][j].second == OCCLUDED) {
-                surf.patches[i][j].second = UNKOWN;
-            // compute the mean of the occupied patches
-            } else if (surf.patches[i][j].second == OCCUPIED) {
-                mean += surf.depthImg.data[i * surf.depthImg.cols + j];
-                count++;
-            }
-
-            // compute the maximum from the image
-            if (max < surf.depthMap[i][j]) {
-                max = surf.depthMap[i][j];
-            }
-        }
-    }
-
-    // adjust the mean
-    mean /= count;
-    count = 0;
-
-    // compute the standard deviation
-    for (int i = 0; i < imgHeight; ++i) {
-        for (int j = 0; j < imgWidth; ++j) {
-            if (surf.patches[i][j].second == OCCUPIED) {
-                stdDev += pow(surf.depthImg.data[i * surf.depthImg.cols + j] - mean, 2.0);
-                count++;
-            }
+    cv::Mat labels = surf.getLabelImg();
+    cv::Mat labelsImg;
 
-        }
-    }
+    // set all empty and occluded to unknown
+    labels.setTo(cv::Scalar(UNKOWN), (labels == EMPTY) | (labels == OCCLUDED));
 
-    // adjust the standard deviation
-    stdDev = sqrt(stdDev / count);
+    // compute the mean and the standard deviation of the occupied patches
+    cv::Scalar meanVal, stdDevVal;
+    cv::meanStdDev(surf.depthImg, meanVal, stdDevVal, labels == OCCUPIED);
+    double mean = meanVal[0], stdDev = stdDevVal[0];
 
     // mark all patches contained in openings
     for (vector<CandidateOpening>::const_iterator it = openings.begin(); it != openings.end(); ++it) {
-        int y1 = it->edges[0];
-        int y2 = it->edges[1];
-        int x1 = it->edges[2];
-        int x2 = it->edges[3];
+        int y1 = std::max(it->edges[0], 0);
+        int y2 = std::min(it->edges[1], imgHeight - 1);
+        int x1 = std::max(it->edges[2], 0);
+        int x2 = std::min(it->edges[3], imgWidth - 1);
 
-        for (int i = 0; i < imgHeight; ++i) {
-            for (int j = 0; j < imgWidth; ++j) {
-                if (i >= y1 && i <= y2 && j >= x1 && j <= x2) {
-                    surf.patches[i][j].second = OPENING;
-                }
-            }
+        if (y1 <= y2 && x1 <= x2) {
+            labels(cv::Range(y1, y2 + 1), cv::Range(x1, x2 + 1)).setTo(cv::Scalar(OPENING));
         }
     }
 
-    // adjust the image
-    for (int i = 0; i < imgHeight; ++i) {
-        for (int j = 0; j < imgWidth; ++j) {
-            // initially mark as not part of the mask
-            depthImgMask.data[i * depthImgMask.cols + j] = 0;
-
-            // put the color into the image according to the label
-            int curr = (i * 3 * labelsImg.cols) + 3 * j;
-            switch (surf.patches[i][j].second) {
-            case OPENING:
-                labelsImg.data[curr + 0] = 200;
-                labelsImg.data[curr + 1] = 200;
-                labelsImg.data[curr + 2] = 200;
-                break;
-            case UNKOWN:
-                labelsImg.data[curr + 0] = 50;
-                labelsImg.data[curr + 1] = 50;
-                labelsImg.data[curr + 2] = 50;
-
-                // add pixel to mask for inpainting
-                depthImgMask.data[i * depthImgMask.cols + j] = 200;
-                break;
-            case OCCUPIED:
-                labelsImg.data[curr + 0] = 0;
-                labelsImg.data[curr + 1] = 0;
-                labelsImg.data[curr + 2] = 200;
-                break;
-            default:
-                throw runtime_error("invalid default branch taken, possibly EMPTY or OCCLUDED patches");
-                break;
-            }
-        }
-    }
+    // put the color into the image according to the label
+    cv::Vec3b colors[UNKOWN + 1];
+    colors[OPENING]  = cv::Vec3b(200, 200, 200);
+    colors[UNKOWN]   = cv::Vec3b(50, 50, 50);
+    colors[OCCUPIED] = cv::Vec3b(0, 0, 200);
+    colorLabels(labels, colors, labelsImg);
+
+    // add unknown pixels to mask for inpainting
+    cv::Mat depthImgMask = cv::Mat::zeros(imgHeight, imgWidth, CV_8UC1);
+    depthImgMask.setTo(cv::Scalar(200), labels == UNKOWN);
 
     cv::imwrite("./img/labelsWithOpenings.png", labelsImg);
     cv::imwrite("./img/depthMask.png", depthImgMask);
@@ -1390,21 +1349,16 @@ void model::Scene::getCorrectedWall(const LabeledPlane3d& surf, vector<pair<Poin
         return;
     }
 
-    if ((size_t) surf.correctedDepthImg.rows != surf.patches.size() ||
-            (size_t) surf.correctedDepthImg.cols != surf.patches.front().size())
+    if (surf.correctedDepthImg.rows != surf.patches.rows() ||
+            surf.correctedDepthImg.cols != surf.patches.cols())
     {
         throw runtime_error("corrected image must be the same size as depth map");
     }
 
     // compute the maximum of the depth image
-    int depthImgMax = 0;
-    for (size_t i = 0; i < surf.depthMap.size(); ++i) {
-        for (size_t j = 0; j < surf.depthMap.front().size(); ++j) {
-            if (depthImgMax < surf.depthMap[i][j]) {
-                depthImgMax = surf.depthMap[i][j];
-            }
-        }
-    }
+    double depthMax;
+    cv::minMaxLoc(surf.getDepthMapImg(), NULL, &depthMax);
+    int depthImgMax = depthMax > 0.0 ? static_cast<int>(depthMax) : 0;
 
     // make the original points darker than the corrected ones
     int r = 255, g = 50, b = 50;
@@ -1415,9 +1369,9 @@ void model::Scene::getCorrectedWall(const LabeledPlane3d& surf, vector<pair<Poin
             cv::Vec3i color;
 
             // only consider occupied and unknown pixels
-            if (surf.patches[i][j].second == OCCUPIED) {
+            if (surf.labels[i][j] == OCCUPIED) {
                 color = cv::Vec3i(r, g, b);
-            } else if (surf.patches[i][j].second == UNKOWN) {
+            } else if (surf.labels[i][j] == UNKOWN) {
                 color = cv::Vec3i(wr, wg, wb);
             } else {
                 continue;
@@ -1432,7 +1386,7 @@ void model::Scene::getCorrectedWall(const LabeledPlane3d& surf, vector<pair<Poin
             Vector3d normal = surf.normal;
             normal.normalize();
 
-            Point3d pt = surf.patches[i][j].first;
+            Point3d pt = surf.patches[i][j];
             pt.x = pt.x + normal.x * dist;
             pt.y = pt.y + normal.y * dist;
             pt.z = pt.z + normal.z * dist;
@@ -1447,38 +1401,59 @@ void model::Scene::flood(LabeledPlane3d& surf,
         const Label& target, const Label& replacement)
 {
     // no point of carrying on
-    if (target == replacement) {
+    if (target == replacement || surf.labels[i][j] != target) {
         return;
     }
 
-    pair<int, int> north = make_pair(i-1, j);
-    pair<int, int> south = make_pair(i+1, j);
-    pair<int, int> east = make_pair(i, j+1);
-    pair<int, int> west = make_pair(i, j-1);
+    int rows = surf.labels.rows();
+    int cols = surf.labels.cols();
 
-    vector<pair<int, int> > neigh;
-    neigh.push_back(north);
-    neigh.push_back(south);
-    neigh.push_back(east);
-    neigh.push_back(west);
+    // seeds of the horizontal spans still to be filled
+    vector<pair<int, int> > seeds;
+    seeds.push_back(make_pair(i, j));
 
-    if (surf.patches[i][j].second == target) {
-        surf.patches[i][j].second = replacement;
-    }
+    while (!seeds.empty()) {
+        int y = seeds.back().first;
+        int x = seeds.back().second;
+        seeds.pop_back();
 
-    for (vector<pair<int, int> >::iterator it = neigh.begin(); it != neigh.end(); ++it) {
-        if ((it->first > 0 && it->second > 0) &&
-                surf.patches[it->first][it->second].second == target)
-        {
-            flood(surf, it->first, it->second, target, replacement);
+        unsigned char *row = surf.labels[y];
+        if (row[x] != target) {
+            continue;
+        }
+
+        // extend the span to the west and to the east and fill it
+        int x1 = x, x2 = x;
+        while (x1 > 0 && row[x1 - 1] == target) {
+            x1--;
+        }
+        while (x2 < cols - 1 && row[x2 + 1] == target) {
+            x2++;
+        }
+        for (int k = x1; k <= x2; ++k) {
+            row[k] = replacement;
+        }
+
+        // one seed for every run of targets north and south of the span
+        for (int ny = y - 1; ny <= y + 1; ny += 2) {
+            if (ny < 0 || ny >= rows) {
+                continue;
+            }
+
+            unsigned char *next = surf.labels[ny];
+            for (int k = x1; k <= x2; ++k) {
+                if (next[k] == target && (k == x1 || next[k - 1] != target)) {
+                    seeds.push_back(make_pair(ny, k));
+                }
+            }
         }
     }
 }
 
-bool model::Scene::isOccupied(const Point3d& center, const double& width) {
+bool model::Scene::isOccupied(const Point3d& center, const double& width, int threadNum) {
     // look for a close point
     double pt[] = {center.x, center.y, center.z};
-    double* closest = this->octTree->FindClosest(pt, pow(sqrt(3) * (width / 2.0), 2.0), 0);
+    double* closest = this->octTree->FindClosest(pt, pow(sqrt(3) * (width / 2.0), 2.0), threadNum);
 
     // bounding box limits
     double xUppLim = center.x + width / 2.0;
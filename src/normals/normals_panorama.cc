@@ -25,6 +25,7 @@
 #include "newmat/newmatap.h"
 
 #include "slam6d/normals.h"
+#include "normals/normals_panorama.h"
 
 using namespace NEWMAT;
 using namespace std;
@@ -35,8 +36,7 @@ using namespace std;
 ///////////////////////////////////////////////////////
 void calculateNormalsPANORAMA(vector<Point> &normals,
                               vector<Point> &points,
-                              const vector< vector< vector< cv::Vec3f > > >
-                                extendedMap,
+                              const fbr::extended_map &extendedMap,
                               const double _rPos[3])
 {
   ColumnVector rPos(3);
@@ -49,9 +49,9 @@ void calculateNormalsPANORAMA(vector<Point> &normals,
   // as the nearest neighbors and then the same PCA method as done in AKNN
   // temporary dynamic array for all the neighbors of a given point
   vector<cv::Vec3f> neighbors;
-  for (size_t i = 0; i < extendedMap.size(); i++) {
-    for (size_t j=0; j<extendedMap[i].size(); j++) {
-      if (extendedMap[i][j].size() == 0) continue;
+  for (size_t i = 0; i < extendedMap.rows(); i++) {
+    for (size_t j=0; j<extendedMap.cols(); j++) {
+      if (extendedMap.size(i, j) == 0) continue;
       neighbors.clear();
       Point mean(0.0,0.0,0.0);
 
@@ -64,16 +64,15 @@ void calculateNormalsPANORAMA(vector<Point> &normals,
         int y = j + offset[1][n];
 
         // Copy the neighboring buckets into the vector
-        if (x >= 0 && x < (int)extendedMap.size() &&
-            y >= 0 && y < (int)extendedMap[x].size()) {
-          for (unsigned int k = 0; k < extendedMap[x][y].size(); k++) {
-            neighbors.push_back(extendedMap[x][y][k]);
-          }
+        if (x >= 0 && x < (int)extendedMap.rows() &&
+            y >= 0 && y < (int)extendedMap.cols()) {
+          neighbors.insert(neighbors.end(),
+                           extendedMap.begin(x, y), extendedMap.end(x, y));
         }
       }
 
       nr_neighbors = neighbors.size();
-      cv::Vec3f p = extendedMap[i][j][0];
+      cv::Vec3f p = *extendedMap.begin(i, j);
 
       // if no or too few neighbors point is found in the 4-neighboring pixels
       // then normal is set to zero
@@ -129,8 +128,9 @@ void calculateNormalsPANORAMA(vector<Point> &normals,
       }
       n = n / n.NormFrobenius();
 
-      for (unsigned int k = 0; k < extendedMap[i][j].size(); k++) {
-        cv::Vec3f p = extendedMap[i][j][k];
+      for (const cv::Vec3f *it = extendedMap.begin(i, j);
+           it != extendedMap.end(i, j); ++it) {
+        cv::Vec3f p = *it;
         points.push_back(Point(p[0], p[1], p[2]));
         normals.push_back(Point(n(1), n(2), n(3)));
       }
@@ -146,8 +146,7 @@ void calculateNormalsFAST(vector<Point> &normals,
                           const cv::Mat &img,
                           const float max,
                           const double _rPos[3],
-                          const vector< vector< vector <cv::Vec3f> > >
-                          &extendedMap)
+                          const fbr::extended_map &extendedMap)
 {
 
   ColumnVector rPos(3);
@@ -156,8 +155,8 @@ void calculateNormalsFAST(vector<Point> &normals,
   
   //!!!!!!!!!!
 
-  int height = extendedMap.size();
-  int width  = extendedMap[0].size();
+  int height = extendedMap.rows();
+  int width  = extendedMap.cols();
   
   ofstream human_pgm("image.range1", ios::out);
 
@@ -176,16 +175,16 @@ void calculateNormalsFAST(vector<Point> &normals,
   
   points.clear();
   int nr_points = 0;
-  for (size_t i = 0; i < extendedMap.size(); i++) {
-    for (size_t j = 0; j < extendedMap[0].size(); j++) {
+  for (size_t i = 0; i < extendedMap.rows(); i++) {
+    for (size_t j = 0; j < extendedMap.cols(); j++) {
       double theta, phi, rho;
       double dRdTheta, dRdPhi;
       double n[3]; //, m;
-      nr_points = extendedMap[i][j].size();
+      nr_points = extendedMap.size(i, j);
       if (nr_points == 0 ) continue;
       
       for (int k = 0; k < nr_points; k++) {
-        cv::Vec3f p = extendedMap[i][j][k];
+        cv::Vec3f p = extendedMap.begin(i, j)[k];
 
         swap(p[1],p[2]);
         p[1]*=-1;
@@ -224,8 +223,8 @@ void calculateNormalsFAST(vector<Point> &normals,
         // Sobel Filter for the derivative
         dRdTheta = dRdPhi = 0.0;
         
-        if (i == 0 || i == extendedMap.size()-1 ||
-            j == 0 || j == extendedMap[0].size()-1) {
+        if (i == 0 || i == extendedMap.rows()-1 ||
+            j == 0 || j == extendedMap.cols()-1) {
           points.push_back(Point(p_cart[0], p_cart[1], p_cart[2]));
           normals.push_back(Point(0.0, 0.0, 0.0));
           continue;
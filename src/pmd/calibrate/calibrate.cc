@@ -8,6 +8,24 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #if (defined(_WIN32) || defined(__WIN32__) || defined(__TOS_WIN__) || defined(__WINDOWS__) || (defined(__APPLE__) & defined(__MACH__)))
 #include <cv.h>
@@ -26,6 +44,84 @@ void usage(char *progName) {
     printf("Use more then ten images.\nPress space bar to proceed.\n");
 }
 
+/*
+ * Hashes the content of a file with 64 bit FNV-1a, returns 0 if the file
+ * cannot be read.
+ */
+int hashFile(const char *fileName, unsigned long long *hash) {
+    FILE *f = fopen(fileName, "rb");
+    if(!f) return 0;
+    unsigned char buffer[65536];
+    size_t n;
+    *hash = 14695981039346656037ULL;
+    while((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        for(size_t i = 0; i < n; i++) {
+            *hash ^= buffer[i];
+            *hash *= 1099511628211ULL;
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+/*
+ * Reads corners cached for an image, returns 0 if there are none. The
+ * cache file starts with the number of corners, 0 if the board was not found.
+ */
+int readCorners(const char *cacheName, CvPoint2D32f *corners, int cornersTotal, int *found) {
+    FILE *f = fopen(cacheName, "r");
+    if(!f) return 0;
+    int cornersCount;
+    int ok = (fscanf(f, "%d", &cornersCount) == 1)
+          && (cornersCount == 0 || cornersCount == cornersTotal);
+    for(int i = 0; ok && i < cornersCount; i++) {
+        ok = (fscanf(f, "%f %f", &corners[i].x, &corners[i].y) == 2);
+    }
+    fclose(f);
+    *found = (cornersCount == cornersTotal);
+    return ok;
+}
+
+void writeCorners(const char *cacheName, CvPoint2D32f *corners, int cornersTotal, int found) {
+    FILE *f = fopen(cacheName, "w");
+    if(!f) return;
+    fprintf(f, "%d\n", found ? cornersTotal : 0);
+    for(int i = 0; found && i < cornersTotal; i++) {
+        fprintf(f, "%.9g %.9g\n", corners[i].x, corners[i].y);
+    }
+    fclose(f);
+}
+
+/*
+ * Finds the board in an image, the corners of images seen before are read
+ * from ./corners instead.
+ */
+int findCorners(const char *fileName, CvSize boardSz, int subpixel, CvPoint2D32f *corners) {
+    int cornersTotal = boardSz.width * boardSz.height;
+    char cacheName[256];
+    unsigned long long hash;
+    int found;
+    int cached = hashFile(fileName, &hash);
+    if(cached) {
+        snprintf(cacheName, 256, "./corners/%016llx_%dx%d_%d.txt", hash, boardSz.width, boardSz.height, subpixel);
+        if(readCorners(cacheName, corners, cornersTotal, &found)) return found;
+    }
+
+    IplImage *img = cvLoadImage(fileName, CV_LOAD_IMAGE_GRAYSCALE);
+    if(!img) return 0;
+
+    int cornersCount;         
+    found = cvFindChessboardCorners(img, boardSz, corners, 
+            &cornersCount, CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_FILTER_QUADS);
+    if(found) cvFindCornerSubPix(img, corners, cornersCount, cvSize(subpixel, subpixel), cvSize(-1,-1), 
+                       cvTermCriteria(CV_TERMCRIT_EPS | CV_TERMCRIT_ITER, 30, 0.1));
+    found = found && (cornersCount == cornersTotal);
+    cvReleaseImage(&img);
+
+    if(cached) writeCorners(cacheName, corners, cornersTotal, found);
+    return found;
+}
+
 void calibrate( CvMat *intrinsic, CvMat *distortion, CvSize imgSz, CvSize boardSz
               , double boardSide, CvPoint2D32f **corners, int boardsCnt) {
 
@@ -94,9 +190,19 @@ int main(int argc, char **argv)
 
     int imagesWithBoard = 0;
 
-    CvPoint2D32f **corners = (CvPoint2D32f**)calloc(100, sizeof(CvPoint2D32f*));
-    corners[0] = (CvPoint2D32f*) malloc(cornersTotal * sizeof(CvPoint2D32f));
+    CvPoint2D32f **corners = (CvPoint2D32f**)calloc(loadImageCnt, sizeof(CvPoint2D32f*));
+    int *found = (int*)calloc(loadImageCnt, sizeof(int));
 
+    // find the boards in parallel, the views are accepted in image order below
+    mkdir("./corners", 0777);
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int i = 0; i < loadImageCnt; i++) {
+        corners[i] = (CvPoint2D32f*) malloc(cornersTotal * sizeof(CvPoint2D32f));
+        found[i] = findCorners(images[i], boardSz, subpixel, corners[i]);
+    }
 
     cvNamedWindow("Cam", 0);
 
@@ -105,17 +211,9 @@ int main(int argc, char **argv)
 
         cvCvtColor(img, imgColor, CV_GRAY2BGR);
 
-        int cornersCount;         
-        
-        int found = cvFindChessboardCorners(img, boardSz, corners[imagesWithBoard], 
-                &cornersCount, CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_FILTER_QUADS);
-        if(found) cvFindCornerSubPix(img, corners[imagesWithBoard], cornersCount, cvSize(subpixel, subpixel), cvSize(-1,-1), 
-                           cvTermCriteria(CV_TERMCRIT_EPS | CV_TERMCRIT_ITER, 30, 0.1));
-
-        if(found && (cornersCount == cornersTotal)) {
-            cvDrawChessboardCorners(imgColor, boardSz, corners[imagesWithBoard], cornersCount, found);
-            imagesWithBoard++;
-            corners[imagesWithBoard] = (CvPoint2D32f*) malloc(cornersTotal * sizeof(CvPoint2D32f));
+        if(found[imagesLoaded]) {
+            cvDrawChessboardCorners(imgColor, boardSz, corners[imagesLoaded], cornersTotal, 1);
+            corners[imagesWithBoard++] = corners[imagesLoaded];
         }
         cvShowImage("Cam", imgColor);
         cvWaitKey(0);
@@ -65,6 +65,12 @@ using namespace boost::filesystem;
 #define TWOPI_INV (0.5/M_PI)
 #define TWOPI (2*M_PI)
 
+#define LASERS_PER_BLOCK 32
+#define BLOCKS_PER_PACKET 12
+#define POINTS_PER_PACKET (LASERS_PER_BLOCK*BLOCKS_PER_PACKET)
+/** the azimuth of a firing block is given in hundredths of a degree */
+#define AZIMUTH_STEPS 36000
+
 typedef struct raw_packet
   {
     unsigned char dat[1200];
@@ -173,6 +179,14 @@ double vertoffsetCorrection[VELODYNE_NUM_LASERS];
 double horizdffsetCorrection[VELODYNE_NUM_LASERS];
 double enabled[VELODYNE_NUM_LASERS];	//New variable to change enabling and disabling of data.
 
+// trigonometry of the calibration, filled in by velodyne_calib_precompute
+double sinVertCorrection[VELODYNE_NUM_LASERS];
+double cosVertCorrection[VELODYNE_NUM_LASERS];
+double sinRotCorrection[VELODYNE_NUM_LASERS];
+double cosRotCorrection[VELODYNE_NUM_LASERS];
+double sinAzimuth[AZIMUTH_STEPS];
+double cosAzimuth[AZIMUTH_STEPS];
+
 int physical2logical[VELODYNE_NUM_LASERS];
 int logical2physical[VELODYNE_NUM_LASERS];
 
@@ -251,6 +265,20 @@ int velodyne_calib_precompute()
         vertoffsetCorrection[i] = velodyne_calibrated[i][3] * METERS_PER_CM;
         horizdffsetCorrection[i] = velodyne_calibrated[i][4] * METERS_PER_CM;
 	enabled[i] = velodyne_calibrated[i][5];
+
+        sinVertCorrection[i] = sin ( vertCorrection[i] );
+        cosVertCorrection[i] = cos ( vertCorrection[i] );
+        sinRotCorrection[i] = sin ( rotCorrection[i] );
+        cosRotCorrection[i] = cos ( rotCorrection[i] );
+    }
+
+    // the sensor turns clockwise, ctheta of every possible azimuth reading
+    for ( i = 0; i < AZIMUTH_STEPS; i++ )
+    {
+        float rotational = i / 100.0;
+        double ctheta = 2 * M_PI - rotational * RADIANS_PER_LSB;
+        sinAzimuth[i] = sin ( ctheta );
+        cosAzimuth[i] = cos ( ctheta );
     }
 
     return 0;
@@ -318,6 +346,85 @@ int calibrate(string filename)
 }
 
 
+/**
+ * The returns of one packet in structure of arrays layout, returns out of
+ * range or of disabled lasers are not valid
+ */
+struct velodyne_packet
+{
+    double x[POINTS_PER_PACKET];
+    double y[POINTS_PER_PACKET];
+    double z[POINTS_PER_PACKET];
+    unsigned char intensity[POINTS_PER_PACKET];
+    unsigned char valid[POINTS_PER_PACKET];
+};
+
+/**
+ * Decodes the twelve firing blocks of a packet. The returns of a block are
+ * unpacked first, so that the conversion runs branch free over all 32
+ * lasers of the block and can be vectorized by the compiler.
+ */
+static void decode_packet ( const BYTE *buf, velodyne_packet &out )
+{
+    int Head = 0;
+    float distance[LASERS_PER_BLOCK];
+    const BYTE *p = buf;
+
+    for ( int i = 0; i < BLOCKS_PER_PACKET; i++, p += 100 )
+    {
+        //Each frame start with 0xEEFF || 0xDDFF
+        unsigned short header = *( const unsigned short * ) p;
+        if ( header == 0xEEFF )
+            Head = 0;
+        else if ( header == 0xDDFF )
+            Head = 32;
+
+        unsigned short rot = *( const unsigned short * ) ( p + 2 );
+        rot %= AZIMUTH_STEPS;
+        const double sin_ctheta = sinAzimuth[rot];
+        const double cos_ctheta = cosAzimuth[rot];
+
+        const int base = i * LASERS_PER_BLOCK;
+        for ( int j = 0; j < LASERS_PER_BLOCK; j++ )
+        {
+            const BYTE *r = p + 4 + j * 3;
+            distance[j] = ( *( const unsigned short * ) r ) * METERS_PER_LSB;
+            out.intensity[base + j] = r[2];
+        }
+
+        // calibration of the lasers of this block
+        const double *distCorr = distCorrection + Head;
+        const double *vertOffset = vertoffsetCorrection + Head;
+        const double *horizOffset = horizdffsetCorrection + Head;
+        const double *sin_phi = sinVertCorrection + Head;
+        const double *cos_phi = cosVertCorrection + Head;
+        const double *sin_rot = sinRotCorrection + Head;
+        const double *cos_rot = cosRotCorrection + Head;
+        const double *enable = enabled + Head;
+
+        for ( int j = 0; j < LASERS_PER_BLOCK; j++ )
+        {
+            float corredistance = distance[j] + distCorr[j];
+
+            // theta = ctheta + rotCorrection
+            double cos_theta = cos_ctheta * cos_rot[j] - sin_ctheta * sin_rot[j];
+            double sin_theta = sin_ctheta * cos_rot[j] + cos_ctheta * sin_rot[j];
+
+            double x = corredistance * cos_theta * cos_phi[j]
+              - horizOffset[j] * cos_ctheta;
+            double y = corredistance * sin_theta * cos_phi[j]
+              - horizOffset[j] * sin_ctheta;
+            double z = corredistance * sin_phi[j] + vertOffset[j] * cos_phi[j];
+
+            out.x[base + j] = x * 100;
+            out.y[base + j] = z * 100;
+            out.z[base + j] = -y * 100;
+            out.valid[base + j] = distance[j] < 120 && distance[j] > 2.2
+              && enable[j] == 1;
+        }
+    }
+}
+
 int read_one_packet (
     FILE *fp,
     PointFilter& filter,
@@ -328,143 +435,45 @@ int read_one_packet (
     std::vector<int>* type,
     std::vector<float>* deviation)
 {
+    const int stride = BLOCK_OFFSET + BLOCK_SIZE;
 
-	int  c, i, j;
-    unsigned char Head;
-    BYTE buf[BLOCK_SIZE];
-    Point point;
-    BYTE *p;
-    unsigned short *ps;
-    unsigned short *pt;
-    unsigned short *pshort;
-
-    double ctheta;
-    double theta, phi;
+    // every packet is preceded by its network headers, read them all at once
+    std::vector<BYTE> buf ( (size_t) stride * CIRCLELENGTH );
+    int size = fread ( &buf[0], 1, buf.size(), fp );
+    int nrpackets = size / stride;
 
-    double sin_ctheta, cos_ctheta;
-    double sin_theta, cos_theta;
-    double sin_phi, cos_phi;
+    std::vector<velodyne_packet> packets ( nrpackets );
 
-    unsigned short physicalNO;
-    unsigned short logicalNO;
-
-    float rotational;
-    float distance;
-    float corredistance;
-    int intensity;
-    int physical;
-    int size;
-
-    unsigned short rot;
-    double x, y, z;
-
-    int circle_col = 0;
-    int circle_row = 0;
-
-	for ( c = 0 ; c < CIRCLELENGTH; c++ )
-	{
-#ifdef _MSC_VER 
-		fseek(fp , BLOCK_OFFSET, SEEK_CUR);
-#else
-#ifdef __CYGWIN__
-		fseek(fp , BLOCK_OFFSET, SEEK_CUR);
-#else		
-		fseeko(fp , BLOCK_OFFSET, SEEK_CUR);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
 #endif
-#endif		
-		size=fread ( buf, 1, BLOCK_SIZE, fp );
-
-		if(size<BLOCK_SIZE)
-			return -1;
+    for ( int c = 0; c < nrpackets; c++ )
+        decode_packet ( &buf[(size_t) c * stride + BLOCK_OFFSET], packets[c] );
 
-		ps = ( unsigned short * ) buf;
-		p = buf;
-		physicalNO = 0;
-
-		for ( i = 0; i < 12; i++ )
-		{
-			//Each frame start with 0xEEFF || 0xDDFF
-			if ( *ps == 0xEEFF )
-				Head = 0;
-			else if ( *ps == 0xDDFF )
-				Head = 32;
-
-			pshort = ( unsigned short * ) ( p + 2 );
-			rot = ( ( unsigned short ) ( *pshort ) / 100.0 );
-
-			circle_col =  c * 6 + i / 2;
-			rotational = ( ( float ) ( *pshort ) ) / 100.0;
-
-			for ( j = 0; j < 32; j++ )
-			{
-				physicalNO  = j + Head;
-				logicalNO = velodyne_physical_to_logical ( physicalNO );
-
-				circle_col =  c * 6 + i / 2;
-				circle_row =  logicalNO;
-
-				pt = ( unsigned short * ) ( p + 4 + j * 3 );
-				distance = absf ( ( *pt ) * 0.002 );
-
-				if( distance < 120   &&	   distance > 2.2 )
-				{
-					BYTE *inty = ( BYTE * ) ( p + 4 + j * 3 + 2 );
-					intensity = *inty;
-
-					ctheta = 2 * M_PI - rotational * RADIANS_PER_LSB;
-					if ( ctheta == 2*M_PI )
-						ctheta = 0;
-
-					sin_ctheta = sin ( ctheta );
-					cos_ctheta = cos ( ctheta );
-
-					//vertCorrection  rotCorrection  distCorrection  vertOffsetCorrection  horizOffsetCorrection
-					//                corredistance = ( distance + distCorrection[physicalNO] ) * ( 1.0 + vertoffsetCorrection[physicalNO] );
-					corredistance = ( distance + distCorrection[physicalNO] ) ;
-					theta     = mod2pi_ref ( M_PI, ctheta + rotCorrection[physicalNO] ); /////////????////////
-					phi    = vertCorrection[physicalNO];  ////////?????/////////////////
-
-					sin_theta = sin ( theta );
-					cos_theta = cos ( theta );
-					sin_phi = sin ( phi );
-					cos_phi = cos ( phi );
-
-					/////////////////////?a???/////////////////////
-					x = corredistance * cos_theta * cos_phi;
-					y = corredistance * sin_theta * cos_phi;
-					z = corredistance * sin_phi +vertoffsetCorrection[physicalNO]*cos_phi;
-
-					x -= horizdffsetCorrection[physicalNO] * cos_ctheta;
-					y -= horizdffsetCorrection[physicalNO] * sin_ctheta;
-
-					point.rad  = sqrt(  x*x 	+  y*y );
-					point.tan_theta  = y/x;
-
-					point.type = POINT_TYPE_GROUND;
-					point.x=x*100;
-					point.y=z*100;
-					point.z=-y*100;
-
-				        double p[3];
-				        p[0] = point.x;
-				        p[1] = point.y;
-				        p[2] = point.z;
-
-					//Enable Check. Could be moved earlier to remove all the unnecessary calculations.
-					//Here to simplify the implementation
-			                if(filter.check(p) && (enabled[physicalNO]==1))
-   					{
-						 for(int ii = 0; ii < 3; ++ii) xyz->push_back(p[ii]);
-					}
-				}
-			}
-            p = p + 100;
-            ps = ( unsigned short * ) p;
+    // the filter is not thread safe, apply it in the order of the file
+    for ( int c = 0; c < nrpackets; c++ )
+    {
+        const velodyne_packet &packet = packets[c];
+        for ( int k = 0; k < POINTS_PER_PACKET; k++ )
+        {
+            if ( !packet.valid[k] )
+                continue;
+
+            double p[3];
+            p[0] = packet.x[k];
+            p[1] = packet.y[k];
+            p[2] = packet.z[k];
+
+            if ( filter.check ( p ) )
+            {
+                for ( int ii = 0; ii < 3; ++ii ) xyz->push_back ( p[ii] );
+            }
         }
-
-
     }
 
+    if ( nrpackets < CIRCLELENGTH )
+        return -1;
+
     return 0;
 }
 
@@ -33,6 +33,9 @@ using std::endl;
 #include <fstream>
 using std::ofstream;
 #include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "scanio/writer.h"
 #include "slam6d/io_utils.h"
@@ -258,3 +261,273 @@ void writeTrajectoryUOS(ofstream &posesout, const double * transMat, bool mat)
   }
   posesout << endl;
 }
+
+/** Points per block formatted by one thread */
+#define EXPORTBLOCK 16384
+
+/** Upper bound of the text of one point */
+#define EXPORTRECORD 96
+
+static const double pow10tab[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+static const double exp10tab[] = { 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5 };
+static const unsigned long long pow10int[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+  1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL };
+
+/*
+ * writes an unsigned integer, returns the end of the text
+ */
+static inline char *formatUnsigned(char *out, unsigned long long v)
+{
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) *out++ = digits[--n];
+  return out;
+}
+
+/*
+ * writes a double like operator<< with the default precision of 6, i.e.,
+ * like printf("%g"), returns the end of the text. Values between 1e-4
+ * and 1e6 are formatted with integer arithmetic, all others and those
+ * too close to a rounding tie with sprintf.
+ */
+static inline char *formatDouble(char *out, double v)
+{
+  double a = fabs(v);
+  if (!(a >= 1e-4 && a < 999999.5)) {
+    if (v == 0.0 && !signbit(v)) {
+      *out++ = '0';
+      return out;
+    }
+    return out + sprintf(out, "%g", v);
+  }
+
+  // decimal exponent e of a, 6 significant digits need 5 - e decimals
+  int e = 5;
+  while (a < exp10tab[e + 4]) e--;
+  int d = 5 - e;
+  double r = a * pow10tab[d];
+  if (r >= 999999.5) {
+    // rounds up to the next power of ten
+    d--;
+    r = a * pow10tab[d];
+  }
+  // the product is inexact, leave values close to a tie to printf
+  if (fabs(r - floor(r) - 0.5) < 1e-6) {
+    return out + sprintf(out, "%g", v);
+  }
+  unsigned long long scaled = (unsigned long long)llrint(r);
+
+  unsigned long long ip = scaled / pow10int[d];
+  unsigned long long fp = scaled % pow10int[d];
+  while (d > 0 && fp % 10 == 0) {
+    fp /= 10;
+    d--;
+  }
+
+  if (v < 0) *out++ = '-';
+  out = formatUnsigned(out, ip);
+  if (d > 0) {
+    *out++ = '.';
+    for (int i = d - 1; i >= 0; i--) {
+      *out++ = '0' + (fp / pow10int[i]) % 10;
+    }
+  }
+  return out;
+}
+
+ExportWriter::ExportWriter(ofstream &file, Attributes attributes, bool xyz,
+                           double scaleFac, bool ply, size_t memory)
+  : file(file), attributes(attributes), xyz(xyz), scaleFac(scaleFac),
+    ply(ply), memory(memory), nrPoints(0), countPos(-1), pendingBytes(0),
+    stop(false)
+{
+  writer = boost::thread(&ExportWriter::writerThread, this);
+}
+
+ExportWriter::~ExportWriter()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    stop = true;
+  }
+  wakeup.notify_all();
+  writer.join();
+}
+
+void ExportWriter::writerThread()
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  while (true) {
+    while (pending.empty() && !stop)
+      wakeup.wait(lock);
+    if (pending.empty())
+      return;
+
+    std::vector<char> *block = pending.front();
+    pending.pop_front();
+    lock.unlock();
+
+    if (!block->empty())
+      file.write(&(*block)[0], block->size());
+
+    lock.lock();
+    pendingBytes -= block->size();
+    delete block;
+    written.notify_all();
+  }
+}
+
+/*
+ * hands a block over to the writer thread, blocks while the memory
+ * budget is used up by blocks waiting to be written
+ */
+void ExportWriter::push(std::vector<char> *block)
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  while (pendingBytes > 0 && pendingBytes + block->size() > memory)
+    written.wait(lock);
+  pending.push_back(block);
+  pendingBytes += block->size();
+  wakeup.notify_one();
+}
+
+/** width of the vertex count in the PLY header */
+#define PLYCOUNTWIDTH 20
+
+void ExportWriter::flush()
+{
+  boost::unique_lock<boost::mutex> lock(mutex);
+  while (pendingBytes > 0)
+    written.wait(lock);
+
+  if (countPos < 0) return;
+
+  // the writer thread is idle, so the count can be patched in place
+  char count[PLYCOUNTWIDTH + 1];
+  snprintf(count, sizeof(count), "%*llu", PLYCOUNTWIDTH, nrPoints);
+  std::streampos end = file.tellp();
+  file.seekp(countPos);
+  file.write(count, PLYCOUNTWIDTH);
+  file.seekp(end);
+}
+
+void ExportWriter::writeHeader()
+{
+  if (!ply) return;
+
+  // the count is right aligned in a fixed width field, flush() replaces
+  // it with the number of points actually written
+  std::string header = "ply\n"
+    "format binary_little_endian 1.0\n"
+    "element vertex ";
+  countPos = (std::streamoff)file.tellp() + header.size();
+  header += std::string(PLYCOUNTWIDTH - 1, ' ') + "0\n"
+    "property float x\n"
+    "property float y\n"
+    "property float z\n";
+  if (attributes == REFLECTANCE) {
+    header += "property float intensity\n";
+  } else if (attributes == COLOR) {
+    header += "property uchar red\n"
+      "property uchar green\n"
+      "property uchar blue\n";
+  }
+  header += "end_header\n";
+
+  push(new std::vector<char>(header.begin(), header.end()));
+}
+
+/*
+ * formats point i, returns the end of the record
+ */
+char *ExportWriter::format(char *out, DataXYZ &xyz, DataReflectance *reflectance,
+                           DataRGB *rgb, unsigned int i)
+{
+  double p[3];
+  if (this->xyz) {
+    p[0] = scaleFac*xyz[i][2];
+    p[1] = -scaleFac*xyz[i][0];
+    p[2] = scaleFac*xyz[i][1];
+  } else {
+    p[0] = xyz[i][0];
+    p[1] = xyz[i][1];
+    p[2] = xyz[i][2];
+  }
+
+  if (ply) {
+    for (int k = 0; k < 3; k++) {
+      float f = (float)p[k];
+      memcpy(out, &f, sizeof(float));
+      out += sizeof(float);
+    }
+    if (attributes == REFLECTANCE) {
+      float f = (*reflectance)[i];
+      memcpy(out, &f, sizeof(float));
+      out += sizeof(float);
+    } else if (attributes == COLOR) {
+      for (int k = 0; k < 3; k++) *out++ = (*rgb)[i][k];
+    }
+    return out;
+  }
+
+  for (int k = 0; k < 3; k++) {
+    out = formatDouble(out, p[k]);
+    *out++ = ' ';
+  }
+  if (attributes == REFLECTANCE) {
+    out = formatDouble(out, (*reflectance)[i]);
+  } else if (attributes == COLOR) {
+    for (int k = 0; k < 3; k++) {
+      if (k) *out++ = ' ';
+      out = formatUnsigned(out, (*rgb)[i][k]);
+    }
+  }
+  *out++ = '\n';
+  return out;
+}
+
+void ExportWriter::write(DataXYZ &xyz, DataReflectance *reflectance, DataRGB *rgb)
+{
+  unsigned int n = xyz.size();
+  if (attributes == REFLECTANCE && (!reflectance || reflectance->size() != n)) return;
+  if (attributes == COLOR && (!rgb || rgb->size() != n)) return;
+  nrPoints += n;
+
+  int nrBlocks = (n + EXPORTBLOCK - 1) / EXPORTBLOCK;
+#ifdef _OPENMP
+  int group = 4 * omp_get_max_threads();
+#else
+  int group = 1;
+#endif
+
+  // format a group of blocks in parallel while the previous one is written
+  for (int first = 0; first < nrBlocks; first += group) {
+    int last = first + group < nrBlocks ? first + group : nrBlocks;
+    std::vector<std::vector<char>*> blocks(last - first);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int b = first; b < last; b++) {
+      unsigned int begin = b * EXPORTBLOCK;
+      unsigned int end = begin + EXPORTBLOCK < n ? begin + EXPORTBLOCK : n;
+      std::vector<char> *block = new std::vector<char>((end - begin) * EXPORTRECORD);
+      char *start = &(*block)[0];
+      char *out = start;
+      for (unsigned int i = begin; i < end; i++) {
+        out = format(out, xyz, reflectance, rgb, i);
+      }
+      block->resize(out - start);
+      blocks[b - first] = block;
+    }
+
+    for (unsigned int b = 0; b < blocks.size(); b++) {
+      push(blocks[b]);
+    }
+  }
+}
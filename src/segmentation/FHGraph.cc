@@ -20,7 +20,6 @@ using namespace std;
 FHGraph::FHGraph(vector<Point> *ps,
 			  double weight(Point, Point),
 			  double sigma,
-			  double eps,
 			  int neighbors,
 			  float radius) :
     V( ps->size() )
@@ -36,7 +35,7 @@ FHGraph::FHGraph(vector<Point> *ps,
     nr_neighbors = neighbors;
     this->radius = radius;
 
-    compute_neighbors(weight, eps);
+    compute_neighbors(weight);
 
     if ( sigma > 0.01 ) {
 	 do_gauss(sigma);
@@ -44,114 +43,99 @@ FHGraph::FHGraph(vector<Point> *ps,
 	 without_gauss();
     }
 
-    adjency_list.clear();
+    dispose_adjency();
 }
 
-void FHGraph::compute_neighbors(double weight(Point, Point), double eps)
+void FHGraph::compute_neighbors(double weight(Point, Point))
 {
-    adjency_list.reserve(pts->size());
-    adjency_list.resize(pts->size());
-
-    ANNpointArray pa = annAllocPts(pts->size(), 3);
-    for (size_t i = 0; i < pts->size(); ++i)
+    double** pa = new double*[V];
+    for (int i = 0; i < V; ++i)
     {
-        pa[i] = new ANNcoord[3];
+        pa[i] = new double[3];
         pa[i][0] = (*pts)[i].x;
         pa[i][1] = (*pts)[i].y;
         pa[i][2] = (*pts)[i].z;
     }
 
-    ANNkd_tree t(pa, pts->size(), 3);
+    // unlike ANN, the kd tree can be searched from several threads
+    KDtreeIndexed t(pa, V);
 
-    if ( radius < 0 ) // Using knn search
-    {
+    if ( radius < 0 ) // Using knn search, the point itself is found too
         nr_neighbors++;
-        ANNidxArray n = new ANNidx[nr_neighbors];
-        ANNdistArray d = new ANNdist[nr_neighbors];
-
-        for (size_t i = 0; i < pts->size(); ++i)
+    float sqradius = radius*radius;
+
+    // each block of points collects its half edges on its own, the blocks
+    // are copied into adjency afterwards
+    const int BLOCK = 4096;
+    int nblocks = (V + BLOCK - 1) / BLOCK;
+    vector< vector<he> > blocks(nblocks);
+    adjency_start.assign(V + 1, 0);
+    int done = 0;
+
+#ifdef _OPENMP
+    // the kd tree has search parameters for MAX_OPENMP_NUM_THREADS threads
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#endif
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < nblocks; ++b)
+    {
+#ifdef _OPENMP
+        int thread_num = omp_get_thread_num();
+#else
+        int thread_num = 0;
+#endif
+        int end = min(V, (b + 1) * BLOCK);
+        for (int i = b * BLOCK; i < end; ++i)
         {
-            ANNpoint p = pa[i];
-
-            t.annkSearch(p, nr_neighbors, n, d, eps);
+            vector<size_t> n;
+            if ( radius < 0 )
+                n = t.kNearestNeighbors(pa[i], nr_neighbors, thread_num);
+            else
+                n = t.fixedRangeSearch(pa[i], sqradius, thread_num);
 
-            for (int j=0; j<nr_neighbors; ++j)
+            for (size_t j=0; j<n.size(); ++j)
             {
-                if ( n[j] == (int)i ) continue;
+                if ( n[j] == (size_t)i ) continue;
 
                 he e;
                 e.x = n[j];
                 e.w = weight(Point((*pts)[i]), Point((*pts)[n[j]]));
 
-                adjency_list[i].push_back(e);
+                blocks[b].push_back(e);
+                adjency_start[i + 1]++;
             }
-
         }
 
-        delete[] n;
-        delete[] d;
-    }
-    else // Using radius search
-    {
-        float sqradius = radius*radius;
-
-
-        ANNidxArray n;
-        ANNdistArray d;
-        int nret;
-        int total = 0;
-
-        const int MOD = 1000;
-        int TMP = MOD;
-
-        for (size_t i = 0; i < pts->size(); ++i)
+#pragma omp atomic
+        done++;
+        if ( thread_num == 0 )
         {
-            ANNpoint p = pa[i];
-
-            nret = t.annkFRSearch(p, sqradius, 0, NULL, NULL, eps);
-            total += nret;
-
-            n = new ANNidx[nret];
-            d = new ANNdist[nret];
-            t.annkFRSearch(p, sqradius, nret, n, d, eps);
+            cout << "Point " << min(done * BLOCK, V) << "/" << V << ", or "
+                 << (done*100.0 / nblocks) << "%\r";
+            cout.flush();
+        }
+    }
 
-		  /*
-            if ( nr_neighbors > 0 && nr_neighbors < nret )
-            {
-                random_shuffle(n, n+nret);
-                nret = nr_neighbors;
-            }
-		  */
-		  
-            for (int j=0; j<nret; ++j)
-            {
-                if ( n[j] == (int)i ) continue;
+    for (int i = 0; i < V; ++i)
+        adjency_start[i + 1] += adjency_start[i];
+    adjency.resize(adjency_start[V]);
 
-                he e;
-                e.x = n[j];
-                e.w = weight(Point((*pts)[i]), Point((*pts)[n[j]]));
-
-                adjency_list[i].push_back(e);
-            }
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < nblocks; ++b)
+    {
+        copy(blocks[b].begin(), blocks[b].end(),
+             adjency.begin() + adjency_start[b * BLOCK]);
+        vector<he>().swap(blocks[b]);
+    }
 
-            delete[] n;
-            delete[] d;
-            if ( TMP==0 )
-            {
-                TMP = MOD;
-                cout << "Point " << i << "/" << V << ", or "
-				 << (i*100.0 / V) << "%\r";
-			 cout.flush();
-            }
-            TMP --;
-        }
+    if ( radius >= 0 )
         cout << "Average nr of neighbors: "
-		   << (float) total / pts->size()
-		   << endl;
-
-    }
+             << (float) adjency.size() / V
+             << endl;
 
-    annDeallocPts(pa);
+    for (int i = 0; i < V; ++i)
+        delete[] pa[i];
+    delete[] pa;
 }
 
 static double gauss(double x, double miu, double sigma)
@@ -160,15 +144,6 @@ static double gauss(double x, double miu, double sigma)
     return exp(- .5 * tmp * tmp);
 }
 
-static void normalize(std::vector<double>& v)
-{
-    double s = 0;
-    for (size_t i=0; i<v.size(); ++i)
-        s += v[i];
-    for (size_t i=0; i<v.size(); ++i)
-        v[i] /= s;
-}
-
 string tostr(int x)
 {
     stringstream ss;
@@ -178,64 +153,48 @@ string tostr(int x)
 
 void FHGraph::do_gauss(double sigma)
 {
-    edges.reserve( V * nr_neighbors);
-    list<he>::iterator k, j;
-    vector<double> gauss_weight, edge_weight;
-    edge e;
-#pragma omp parallel for private(j, k, e, gauss_weight, edge_weight) schedule(dynamic)
+    // the edges of point i take the places of its half edges
+    edges.resize(adjency.size());
+#pragma omp parallel for schedule(dynamic, 1024)
     for (int i=0; i<V; ++i)
     {
-        for (j=adjency_list[i].begin();
-             j!=adjency_list[i].end();
-             j++)
+        for (size_t j=adjency_start[i]; j<adjency_start[i+1]; ++j)
         {
+            const he &ej = adjency[j];
+            // weights of the edges of both points, weighted by a normalized
+            // gaussian of their difference to this edge
+            double gauss_sum = 0, weight_sum = 0;
 
-            gauss_weight.clear();
-            edge_weight.clear();
-
-            for (k=adjency_list[i].begin();
-                 k!=adjency_list[i].end();
-                 ++k)
+            for (size_t k=adjency_start[i]; k<adjency_start[i+1]; ++k)
             {
-                gauss_weight.push_back(gauss(k->w, j->w, sigma));
-                edge_weight.push_back(k->w);
+                double g = gauss(adjency[k].w, ej.w, sigma);
+                gauss_sum += g;
+                weight_sum += g * adjency[k].w;
             }
-            for (k=adjency_list[j->x].begin();
-                 k!=adjency_list[j->x].end();
-                 ++k)
+            for (size_t k=adjency_start[ej.x]; k<adjency_start[ej.x+1]; ++k)
             {
-                gauss_weight.push_back(gauss(k->w, j->w, sigma));
-                edge_weight.push_back(k->w);
+                double g = gauss(adjency[k].w, ej.w, sigma);
+                gauss_sum += g;
+                weight_sum += g * adjency[k].w;
             }
-            normalize(gauss_weight);
-
-            e.a = i; e.b = j->x;
-            e.w = 0;
-            for (size_t k=0; k<edge_weight.size(); ++k)
-                e.w += gauss_weight[k] * edge_weight[k];
 
-#pragma omp critical
-            {
-                edges.push_back(e);
-            }
+            edge &e = edges[j];
+            e.a = i; e.b = ej.x;
+            e.w = weight_sum / gauss_sum;
         }
     }
 }
 
 void FHGraph::without_gauss()
 {
-    edges.reserve( V * nr_neighbors);
-    list<he>::iterator j;
-    edge e;
-
+    edges.resize(adjency.size());
+#pragma omp parallel for schedule(dynamic, 1024)
     for (int i=0; i<V; ++i)
     {
-        for (j=adjency_list[i].begin();
-             j!=adjency_list[i].end();
-             j++)
+        for (size_t j=adjency_start[i]; j<adjency_start[i+1]; ++j)
         {
-            e.a = i; e.b = j->x; e.w = j->w;
-            edges.push_back(e);
+            edge &e = edges[j];
+            e.a = i; e.b = adjency[j].x; e.w = adjency[j].w;
         }
     }
 }
@@ -269,9 +228,14 @@ void vectorFree(T& t) {
     t.swap(tmp);
 }
 
+void FHGraph::dispose_adjency() {
+    vectorFree(adjency_start);
+    vectorFree(adjency);
+}
+
 void FHGraph::dispose() {
     vectorFree(edges);
     //    vectorFree(points);
-    vectorFree(adjency_list);
+    dispose_adjency();
 }
 
@@ -26,11 +26,12 @@ universe::~universe() {
 }
 
 int universe::find(int x) {
-    int y = x;
-    while (y != elts[y].p)
-        y = elts[y].p;
-    elts[x].p = y;
-    return y;
+    // path halving, every node on the way is linked to its grandparent
+    while (x != elts[x].p) {
+        elts[x].p = elts[elts[x].p].p;
+        x = elts[x].p;
+    }
+    return x;
 }
 
 void universe::join(int x, int y) {
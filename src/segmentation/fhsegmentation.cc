@@ -101,7 +101,7 @@ void parse_options(int argc, char **argv, int &start, int &end,
      "Set the range of radius search to <arg>")
     ("eps,E",
      po::value<float>(&eps)->default_value(1.0),
-     "Set error threshold used by the AKNN algorithm to <arg>")
+     "Ignored, the neighbor search is exact")
     ("minsize,z",
      po::value<int>(&min_size)->default_value(0),
      "Keep segments of size at least <arg>")
@@ -269,7 +269,7 @@ int main(int argc, char** argv)
 
     /// create the graph and get the segments
     cout << "creating graph" << endl;
-    FHGraph sgraph(&points, weight2, sigma, eps, neighbors, radius);
+    FHGraph sgraph(&points, weight2, sigma, neighbors, radius);
 
     cout << "segmenting graph" << endl;
     edge* sedges = sgraph.getGraph();
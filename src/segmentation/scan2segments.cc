@@ -410,7 +410,7 @@ cv::Mat float2uchar(cv::Mat &source, bool logarithm, float cutoff)
  * from grayscale image, create a binary image using a fixed threshold
  */
 cv::Mat calculateThreshold(vector<vector<cv::Vec3f>> &segmented_points,
-        cv::Mat &img, vector<vector<vector<cv::Vec3f> > > extendedMap,
+        cv::Mat &img, const fbr::extended_map &extendedMap,
         double thresh)
 {
     int i, j, idx;
@@ -424,8 +424,8 @@ cv::Mat calculateThreshold(vector<vector<cv::Vec3f>> &segmented_points,
             if (idx != 0)
                 idx = 1;
             segmented_points[idx].insert(segmented_points[idx].end(),
-								 extendedMap[i][j].begin(),
-								 extendedMap[i][j].end());
+								 extendedMap.begin(i, j),
+								 extendedMap.end(i, j));
         }
     }
 
@@ -436,7 +436,7 @@ cv::Mat calculateThreshold(vector<vector<cv::Vec3f>> &segmented_points,
  * calculate the pyramid mean shift segmentation of the image
  */
 cv::Mat calculatePyrMeanShift(vector<vector<cv::Vec3f>> &segmented_points,
-        cv::Mat &img, vector<vector<vector<cv::Vec3f> > > extendedMap,
+        cv::Mat &img, const fbr::extended_map &extendedMap,
         int maxlevel, int radius)
 {
     int i, j, idx;
@@ -453,8 +453,8 @@ cv::Mat calculatePyrMeanShift(vector<vector<cv::Vec3f>> &segmented_points,
         for (j = 0; j < res.cols; j++) {
             idx = res.at<uchar>(i,j);
             histogram[idx].insert(histogram[idx].end(),
-						    extendedMap[i][j].begin(),
-						    extendedMap[i][j].end());
+						    extendedMap.begin(i, j),
+						    extendedMap.end(i, j));
         }
     }
 
@@ -469,7 +469,7 @@ cv::Mat calculatePyrMeanShift(vector<vector<cv::Vec3f>> &segmented_points,
 
 ///TODO: need to pass *two* thresh params, see: http://bit.ly/WmFeub
 cv::Mat calculatePyrSegmentation(vector<vector<cv::Vec3f>> &segmented_points,
-        cv::Mat &img, vector<vector<vector<cv::Vec3f> > > extendedMap,
+        cv::Mat &img, const fbr::extended_map &extendedMap,
         double thresh1, double thresh2, int pyrlevels)
 {
     int i, j, idx;
@@ -510,8 +510,8 @@ cv::Mat calculatePyrSegmentation(vector<vector<cv::Vec3f>> &segmented_points,
         for (j = 0; j < ipl_segmented->width; j++) {
             idx = mapping[data[i*step+j]];
             segmented_points[idx].insert(segmented_points[idx].end(),
-								  extendedMap[i][j].begin(),
-								  extendedMap[i][j].end());
+								  extendedMap.begin(i, j),
+								  extendedMap.end(i, j));
         }
     }
 
@@ -526,7 +526,7 @@ cv::Mat calculatePyrSegmentation(vector<vector<cv::Vec3f>> &segmented_points,
  * calculate the adaptive threshold
  */
 cv::Mat calculateAdaptiveThreshold(vector<vector<cv::Vec3f>> &segmented_points,
-        cv::Mat &img, vector<vector<vector<cv::Vec3f> > > extendedMap)
+        cv::Mat &img, const fbr::extended_map &extendedMap)
 {
     int i, j, idx;
     cv::Mat res;
@@ -539,8 +539,8 @@ cv::Mat calculateAdaptiveThreshold(vector<vector<cv::Vec3f>> &segmented_points,
             if (idx != 0)
                 idx = 1;
             segmented_points[idx].insert(segmented_points[idx].end(),
-								 extendedMap[i][j].begin(),
-								 extendedMap[i][j].end());
+								 extendedMap.begin(i, j),
+								 extendedMap.end(i, j));
         }
     }
 
@@ -553,7 +553,7 @@ cv::Mat calculateAdaptiveThreshold(vector<vector<cv::Vec3f>> &segmented_points,
  * --dump-pano option
  */
 cv::Mat calculateWatershed(vector<vector<cv::Vec3f>> &segmented_points,
-        string &marker, cv::Mat &img, vector<vector<vector<cv::Vec3f> > > extendedMap)
+        string &marker, cv::Mat &img, const fbr::extended_map &extendedMap)
 {
     int i, j, idx;
     cv::Mat markerMask = cv::imread(marker, 0);
@@ -581,8 +581,8 @@ cv::Mat calculateWatershed(vector<vector<cv::Vec3f>> &segmented_points,
             idx = markers.at<int>(i,j);
             if (idx > 0 && idx <= compCount) {
                 segmented_points[idx-1].insert(segmented_points[idx-1].end(),
-									  extendedMap[i][j].begin(),
-									  extendedMap[i][j].end());
+									  extendedMap.begin(i, j),
+									  extendedMap.end(i, j));
             }
         }
     }
@@ -9,15 +9,58 @@
   */
 
 #include <segmentation/segment-graph.h>
+#include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// edges of equal weight are ordered by their points, so that the result
+// does not depend on the sorting algorithm
 bool operator<(const edge &a, const edge &b) {
-    return a.w < b.w;
+    if (a.w != b.w) return a.w < b.w;
+    if (a.a != b.a) return a.a < b.a;
+    return a.b < b.b;
+}
+
+/*
+ * sorts one chunk of edges per thread and merges neighboring chunks
+ * pairwise, in parallel as far as possible
+ */
+static void sort_edges(edge *edges, int num_edges) {
+#ifdef _OPENMP
+    int chunks = omp_get_max_threads();
+#else
+    int chunks = 1;
+#endif
+    if (chunks < 2 || num_edges < 100000) {
+        std::sort(edges, edges + num_edges);
+        return;
+    }
+
+    std::vector<int> bounds(chunks + 1);
+    for (int c = 0; c <= chunks; c++)
+        bounds[c] = (int)((long long)num_edges * c / chunks);
+
+#pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < chunks; c++)
+        std::sort(edges + bounds[c], edges + bounds[c+1]);
+
+    for (int width = 1; width < chunks; width *= 2) {
+#pragma omp parallel for schedule(static, 1)
+        for (int c = 0; c < chunks - width; c += 2 * width) {
+            int end = std::min(c + 2 * width, chunks);
+            std::inplace_merge(edges + bounds[c],
+                               edges + bounds[c + width],
+                               edges + bounds[end]);
+        }
+    }
 }
 
 universe *segment_graph(int num_vertices, int num_edges, edge *edges,
                         float c) {
     // sort edges by weight
-    std::sort(edges, edges + num_edges);
+    sort_edges(edges, num_edges);
 
     // make a disjoint-set forest
     universe *u = new universe(num_vertices);
@@ -45,6 +88,6 @@ universe *segment_graph(int num_vertices, int num_edges, edge *edges,
     }
 
     // free up
-    delete threshold;
+    delete [] threshold;
     return u;
 }
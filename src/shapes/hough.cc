@@ -26,6 +26,30 @@ using namespace NEWMAT;
 #endif 
 #include <sys/stat.h>
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** number of triples each thread draws before the votes are counted */
+#define RHT_BATCH 1024
+
+/**
+  * Random number in [0,1) from a linear congruential generator with its
+  * state kept by the caller, since rand() may not be used by several
+  * threads at once.
+  */
+static inline double randomUnit(unsigned int &state)
+{
+  state = state * 1103515245u + 12345u;
+  return (state >> 8) * (1.0 / 16777216.0);
+}
+
 /**
   * Hough Constructor.
   * Loads the Configfile, located in "bin/hough.cfg" and initializes the
@@ -123,11 +147,14 @@ Hough::~Hough() {
 
 /**
   * Randomized Hough Transform
+  * The triples are drawn and turned into planes by all threads at once,
+  * each with its own random generator. The votes are then counted in a
+  * fixed order until a cell reaches the maximum, votes left after that
+  * are dropped as they might come from points of the detected plane.
   */
 int Hough::RHT() {
 
   if (!quiet) cout << "RHT" << endl;
-  Point p1, p2, p3;
   double theta, phi, rho;
   int planeSize = 2000;
 
@@ -136,24 +163,66 @@ int Hough::RHT() {
   long start, end;
   start = GetCurrentTimeInMilliSec(); 
   int counter = 0;
+
+  int nrThreads = 1;
+#ifdef _OPENMP
+  nrThreads = omp_get_max_threads();
+#endif
+  vector<unsigned int> seeds(nrThreads);
+  for(int t = 0; t < nrThreads; t++) seeds[t] = rand();
+  // (theta, phi, rho) of the planes found by each thread
+  vector<vector<double> > votes(nrThreads);
+
   while( allPoints->size() > stop && 
           planes.size() < (unsigned int)myConfigFileHough.Get_MaxPlanes() &&
           counter < (int)myConfigFileHough.Get_TrashMax()) { 
-    unsigned int pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
+    const vector<Point> &points = *allPoints;
+    unsigned int size = points.size();
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nrThreads)
+#endif
+    {
+      int t = 0;
+#ifdef _OPENMP
+      t = omp_get_thread_num();
+#endif
+      unsigned int seed = seeds[t];
+      vector<double> &vote = votes[t];
+      vote.clear();
+      double th, ph, rh;
+      for(int k = 0; k < RHT_BATCH; k++) {
+        const Point &p1 = points[(unsigned int)(size*randomUnit(seed))];
+        const Point &p2 = points[(unsigned int)(size*randomUnit(seed))];
+        const Point &p3 = points[(unsigned int)(size*randomUnit(seed))];
+
+        // check distance
+        if(!distanceOK(p1, p2, p3)) continue;
+        // calculate Plane
+        if(calculatePlane(p1, p2, p3, th, ph, rh)) {
+          vote.push_back(th);
+          vote.push_back(ph);
+          vote.push_back(rh);
+        }
+      }
+      seeds[t] = seed;
+    }
+
+    // increment accumulator cells
+    bool found = false;
+    for(int t = 0; t < nrThreads && !found; t++) {
+      for(unsigned int k = 0; k < votes[t].size(); k += 3) {
+        theta = votes[t][k];
+        phi = votes[t][k+1];
+        rho = votes[t][k+2];
+        if(acc->accumulate(theta, phi, rho)) {
+          found = true;
+          break;
+        }
+      }
+    }
 
-    p1 = (*allPoints)[pint];
-    pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
-    p2 = (*allPoints)[pint];
-    pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
-    p3 = (*allPoints)[pint];
-
-    // check distance
-    if(!distanceOK(p1, p2, p3)) continue;
-    //cout << "Distance OK" << endl;
-    // calculate Plane
-    if(calculatePlane(p1, p2, p3, theta, phi, rho)) {
-      // increment accumulator cell
-      if(acc->accumulate(theta, phi, rho)) {
+    if(found) {
         end = GetCurrentTimeInMilliSec() - start;
         start = GetCurrentTimeInMilliSec();
         if (!quiet) cout << "Time for RHT " << plane << ": " << end << endl; 
@@ -169,8 +238,6 @@ int Hough::RHT() {
         acc->resetAccumulator();
         plane++;
         if(!quiet) cout << "Planes " << planes.size() << endl;
-      }
-
     }
   }
   /*
@@ -523,7 +590,7 @@ void Hough::APHT() {
   * three selected points may not exceed a maximal or fall below a minimal
   * distance. 
   */
-bool Hough::distanceOK(Point p1, Point p2, Point p3) {
+bool Hough::distanceOK(const Point &p1, const Point &p2, const Point &p3) {
   // p1 - p2
   double distance = (p1.x - p2.x) * (p1.x - p2.x) + (p1.y - p2.y) * (p1.y - p2.y) + (p1.z - p2.z) * (p1.z - p2.z); 
   if(sqrt(distance) < myConfigFileHough.Get_MinDist()) return false;
@@ -547,7 +614,7 @@ bool Hough::distanceOK(Point p1, Point p2, Point p3) {
   * Calculates the polar coordinates (rho, theta, phi) of the plane spanned by
   * three points p1, p2, and p3.
   */
-bool Hough::calculatePlane(Point p1, Point p2, Point p3, double &theta, double &phi, double &rho) {
+bool Hough::calculatePlane(const Point &p1, const Point &p2, const Point &p3, double &theta, double &phi, double &rho) {
 
   double v1[3];
   double v2[3];
@@ -716,6 +783,25 @@ int Hough::deletePointsQuad(double * n, double rho) {
   // ENDE
 }
 
+/**
+  * Marks the points closer to the plane n * x = rho than the maximal point
+  * to plane distance, the points are tested by all threads at once.
+  */
+static void markPlanePoints(const vector<Point> &points, const double *n,
+                            double rho, double maxDist, vector<char> &onPlane)
+{
+  int size = points.size();
+  onPlane.resize(size);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int i = 0; i < size; i++) {
+    const Point &p = points[i];
+    double distance = p.x * n[0] + p.y * n[1] + p.z*n[2] - rho;
+    onPlane[i] = fabs(distance) < maxDist;
+  }
+}
+
 /**
   * Deletes points from allPoints that lie on the given plane. All points from
   * the biggest cluster on that plane are deleted. If the cluster is
@@ -731,20 +817,15 @@ int Hough::deletePoints(double * n, double rho) {
   vector<Point> *nallPoints = new vector<Point>();
 
   vector<Point> planePoints;
+  vector<char> onPlane;
   
   Point p;
-  vector<Point>::iterator itr = allPoints->begin();
+  vector<Point>::iterator itr;
  
-  while(itr != allPoints->end()) {
-    p = *(itr);
-    // if point close to plane, delete it
-    double distance = p.x * n[0] + p.y * n[1] + p.z*n[2] - rho;
-    if( fabs(distance) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-   
-      planePoints.push_back(p);
-
-    } 
-   itr++;
+  // if point close to plane, delete it
+  markPlanePoints(*allPoints, n, rho, myConfigFileHough.Get_MaxPointPlaneDist(), onPlane);
+  for(unsigned int i = 0; i < onPlane.size(); i++) {
+    if(onPlane[i]) planePoints.push_back((*allPoints)[i]);
   }
   double n2[4];
   // calculating the best fit plane
@@ -768,7 +849,6 @@ int Hough::deletePoints(double * n, double rho) {
     direction = 'z';
   }
 
-  itr = allPoints->begin();
   planePoints.clear();  
  
   vPtPair planePairs;
@@ -777,11 +857,12 @@ int Hough::deletePoints(double * n, double rho) {
   miny = 1000000;
   maxx = -1000000;
   maxy= -1000000;
-  while(itr != allPoints->end()) {
-    p = *(itr);
+  markPlanePoints(*allPoints, n2, n2[3], myConfigFileHough.Get_MaxPointPlaneDist(), onPlane);
+  nallPoints->reserve(allPoints->size());
+  for(unsigned int i = 0; i < onPlane.size(); i++) {
+    p = (*allPoints)[i];
     // if point close to plane, delete it
-    double distance = p.x * n2[0] + p.y * n2[1] + p.z*n2[2] - n2[3];
-    if( fabs(distance) < myConfigFileHough.Get_MaxPointPlaneDist()) {
+    if(onPlane[i]) {
    
       Point tmp, p2;
       double distance = p.x * n2[0] + p.y * n2[1] + p.z*n2[2] - n2[3];
@@ -812,7 +893,6 @@ int Hough::deletePoints(double * n, double rho) {
     } else {
       nallPoints->push_back(p);
     }
-    itr++;
   }
   delete allPoints;
   allPoints = nallPoints;
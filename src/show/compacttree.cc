@@ -640,6 +640,12 @@ long compactTree::countLeaves() { return 1 + countLeaves(*root); }
 
 void compactTree::setColorManager(ColorManager *_cm) { cm = _cm; }
 
+void compactTree::registerColorManager(ScanColorManager *scm) {
+  scm->registerTree(this);
+  scm->updateRanges(mins);
+  scm->updateRanges(maxs);
+}
+
 void compactTree::drawLOD(float ratio) { 
     switch (current_lod_mode) {
       case 1:
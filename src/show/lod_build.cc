@@ -0,0 +1,562 @@
+/*
+ * lod_build implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Builds the out-of-core level of detail hierarchy for show
+ *
+ * All scans are transformed into the global coordinate system and streamed
+ * into a temporary file. The hierarchy is then built top down: every node
+ * keeps an evenly strided subsample of at most 'capacity' points, the
+ * remaining points are distributed into temporary files of the 8 children.
+ * Only one node's subsample is held in memory at a time.
+ */
+
+#include <string>
+using std::string;
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+#include <fstream>
+using std::ifstream;
+using std::ofstream;
+#include <vector>
+using std::vector;
+#include <stdexcept>
+using std::runtime_error;
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "slam6d/scan.h"
+#include "slam6d/globals.icc"
+#include "show/pagedlod.h"
+
+#include <boost/filesystem.hpp>
+
+#ifndef _MSC_VER
+#include <getopt.h>
+#else
+#include "XGetopt.h"
+#endif
+
+/** the hierarchy ends here, remaining points are kept in the leaf */
+#define LOD_MAX_DEPTH 24
+
+/** points read and written at once from the temporary files */
+#define LOD_BLOCK 65536
+
+/**
+ * Explains the usage of this program's command line parameters
+ */
+void usage(char* prog)
+{
+#ifndef _MSC_VER
+  const string bold("\033[1m");
+  const string normal("\033[m");
+#else
+  const string bold("");
+  const string normal("");
+#endif
+  cout << endl
+      << bold << "USAGE " << normal << endl
+      << "   " << prog << " [options] directory" << endl << endl;
+  cout << bold << "OPTIONS" << normal << endl
+      << endl
+      << bold << "  -c, --color" << normal << endl
+      << "         store the RGB values of the points" << endl
+      << endl
+      << bold << "  -C" << normal << " NR, " << bold << "--capacity=" << normal << "NR" << endl
+      << "         store at most NR points per node [default: 20000]" << endl
+      << endl
+      << bold << "  -e" << normal << " NR, " << bold << "--end=" << normal << "NR" << endl
+      << "         end after scan NR" << endl
+      << endl
+      << bold << "  -f" << normal << " F, " << bold << "--format=" << normal << "F" << endl
+      << "         using shared library F for input" << endl
+      << "         (chose F from {uos, uos_map, uos_rgb, uos_frames, uos_map_frames, old, rts, rts_map, ifp, riegl_txt, riegl_rgb, riegl_bin, zahn, ply})" << endl
+      << endl
+      << bold << "  -m" << normal << " NR, " << bold << "--max=" << normal << "NR" << endl
+      << "         neglegt all data points with a distance larger than NR 'units'" << endl
+      << endl
+      << bold << "  -M" << normal << " NR, " << bold << "--min=" << normal << "NR" << endl
+      << "         neglegt all data points with a distance smaller than NR 'units'" << endl
+      << endl
+      << bold << "  -o" << normal << " DIR, " << bold << "--output=" << normal << "DIR" << endl
+      << "         write the hierarchy to DIR [default: directory/lod/]" << endl
+      << endl
+      << bold << "  -O" << normal << " NR (optional), " << bold << "--octree=" << normal << "NR (optional)" << endl
+      << "         use randomized octree based point reduction (pts per voxel=<NR>)" << endl
+      << "         requires -r or --reduce" << endl
+      << endl
+      << bold << "  -p, --pose" << normal << endl
+      << "         use the pose files, ignore the .frames files" << endl
+      << endl
+      << bold << "  -r" << normal << " NR, " << bold << "--reduce=" << normal << "NR" << endl
+      << "         turns on octree based point reduction (voxel size=<NR>)" << endl
+      << endl
+      << bold << "  -R, --reflectance" << normal << endl
+      << "         store the reflectance values as gray values" << endl
+      << endl
+      << bold << "  -s" << normal << " NR, " << bold << "--start=" << normal << "NR" << endl
+      << "         start at scan NR (i.e., neglects the first NR scans)" << endl
+      << "         [ATTENTION: counting naturally starts with 0]" << endl
+      << endl << endl;
+
+  cout << bold << "EXAMPLES " << normal << endl
+      << "   " << prog << " -s 0 -e 10 -c -f uos_rgb dat" << endl
+      << "   bin/show --pagedlod dat/lod" << endl << endl;
+  exit(1);
+}
+
+/**
+ * A function that parses the command-line arguments and sets the respective flags.
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments
+ * @param dir the directory
+ * @param outdir the output directory
+ * @param red using point reduction?
+ * @param octree randomized octree reduction
+ * @param start starting at scan number 'start'
+ * @param end stopping at scan number 'end'
+ * @param maxDist maximal distance of points being loaded
+ * @param minDist minimal distance of points being loaded
+ * @param use_color store the color of the points
+ * @param use_reflectance store the reflectance as gray value
+ * @param use_frames transform the scans by the last frame
+ * @param capacity maximal number of points per node
+ * @param type the input format
+ * @return 0, if the parsing was successful. 1 otherwise
+ */
+int parseArgs(int argc, char **argv, string &dir, string &outdir,
+              double &red, int &octree, int &start, int &end,
+              int &maxDist, int &minDist, bool &use_color,
+              bool &use_reflectance, bool &use_frames,
+              unsigned int &capacity, IOType &type)
+{
+  int  c;
+  // from unistd.h:
+  extern char *optarg;
+  extern int optind;
+
+  /* options descriptor */
+  // 0: no arguments, 1: required argument, 2: optional argument
+  static struct option longopts[] = {
+    { "format",          required_argument,   0,  'f' },
+    { "start",           required_argument,   0,  's' },
+    { "end",             required_argument,   0,  'e' },
+    { "max",             required_argument,   0,  'm' },
+    { "min",             required_argument,   0,  'M' },
+    { "reduce",          required_argument,   0,  'r' },
+    { "octree",          optional_argument,   0,  'O' },
+    { "color",           no_argument,         0,  'c' },
+    { "reflectance",     no_argument,         0,  'R' },
+    { "reflectivity",    no_argument,         0,  'R' },
+    { "pose",            no_argument,         0,  'p' },
+    { "capacity",        required_argument,   0,  'C' },
+    { "output",          required_argument,   0,  'o' },
+    { 0,           0,   0,   0}                    // needed, cf. getopt.h
+  };
+
+  cout << endl;
+  while ((c = getopt_long(argc, argv, "f:s:e:m:M:r:O::cRpC:o:", longopts, NULL)) != -1)
+    switch (c)
+     {
+     case 'r':
+       red = atof(optarg);
+       break;
+     case 'O':
+       if (optarg) {
+         octree = atoi(optarg);
+       } else {
+         octree = 1;
+       }
+       break;
+     case 's':
+       start = atoi(optarg);
+       if (start < 0) { cerr << "Error: Cannot start at a negative scan number.\n"; exit(1); }
+       break;
+     case 'e':
+       end = atoi(optarg);
+       if (end < 0)     { cerr << "Error: Cannot end at a negative scan number.\n"; exit(1); }
+       if (end < start) { cerr << "Error: <end> cannot be smaller than <start>.\n"; exit(1); }
+       break;
+     case 'm':
+       maxDist = atoi(optarg);
+       break;
+     case 'M':
+       minDist = atoi(optarg);
+       break;
+     case 'c':
+       use_color = true;
+       break;
+     case 'R':
+       use_reflectance = true;
+       break;
+     case 'p':
+       use_frames = false;
+       break;
+     case 'C':
+       if (atoi(optarg) < 1) { cerr << "Error: A node has to hold at least one point.\n"; exit(1); }
+       capacity = atoi(optarg);
+       break;
+     case 'o':
+       outdir = optarg;
+       break;
+     case 'f':
+       try {
+         type = formatname_to_io_type(optarg);
+       } catch (...) { // runtime_error
+         cerr << "Format " << optarg << " unknown." << endl;
+         abort();
+       }
+       break;
+     case '?':
+       usage(argv[0]);
+       return 1;
+     default:
+       abort ();
+     }
+
+  if (optind != argc-1) {
+    cerr << "\n*** Directory missing ***" << endl;
+    usage(argv[0]);
+  }
+  dir = argv[optind];
+
+#ifndef _MSC_VER
+  if (dir[dir.length()-1] != '/') dir = dir + "/";
+#else
+  if (dir[dir.length()-1] != '\\') dir = dir + "\\";
+#endif
+
+  if (outdir.empty()) {
+#ifndef _MSC_VER
+    outdir = dir + "lod/";
+#else
+    outdir = dir + "lod\\";
+#endif
+  }
+#ifndef _MSC_VER
+  if (outdir[outdir.length()-1] != '/') outdir = outdir + "/";
+#else
+  if (outdir[outdir.length()-1] != '\\') outdir = outdir + "\\";
+#endif
+
+  return 0;
+}
+
+/**
+ * Builds the nodes of the hierarchy out of core
+ */
+class LODBuilder {
+public:
+  LODBuilder(const string& _tmpdir, ofstream& _points, unsigned int _capacity)
+    : tmpdir(_tmpdir), points(_points), capacity(_capacity), written(0) {}
+
+  /**
+   * Splits the points of the temporary file of node 'id' into the points
+   * kept by the node and the files of its children, then recurses.
+   */
+  void build(unsigned int id, unsigned long long count, unsigned int depth)
+  {
+    string filename = nodeFile(id);
+    ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!in.good()) throw runtime_error("Could not open " + filename);
+
+    bool leaf = count <= capacity || depth >= LOD_MAX_DEPTH;
+    unsigned long long stride = leaf ? 1 : (count + capacity - 1) / capacity;
+
+    LODNode node = nodes[id];
+    float center[3] = { node.center[0], node.center[1], node.center[2] };
+    float half = node.size / 2.0;
+
+    vector<LODPoint> kept;
+    vector<LODPoint> block(LOD_BLOCK);
+    ofstream *children[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    unsigned long long child_count[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    int child_id[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+    unsigned long long i = 0;
+    while (i < count) {
+      unsigned long long n = count - i;
+      if (n > LOD_BLOCK) n = LOD_BLOCK;
+      in.read((char*)&block[0], n * sizeof(LODPoint));
+      if (!in.good()) throw runtime_error("Could not read " + filename);
+      for (unsigned long long j = 0; j < n; ++j, ++i) {
+        const LODPoint& p = block[j];
+        if (i % stride == 0) {
+          kept.push_back(p);
+          continue;
+        }
+        int k = (p.x[0] >= center[0] ? 1 : 0)
+              | (p.x[1] >= center[1] ? 2 : 0)
+              | (p.x[2] >= center[2] ? 4 : 0);
+        if (children[k] == 0) {
+          child_id[k] = nodes.size();
+          LODNode child;
+          child.center[0] = center[0] + (k & 1 ? half : -half);
+          child.center[1] = center[1] + (k & 2 ? half : -half);
+          child.center[2] = center[2] + (k & 4 ? half : -half);
+          child.size = half;
+          nodes.push_back(child);
+          string childfile = nodeFile(child_id[k]);
+          children[k] = new ofstream(childfile.c_str(),
+                                     std::ios::out | std::ios::binary);
+          if (!children[k]->good())
+            throw runtime_error("Could not create " + childfile);
+        }
+        children[k]->write((const char*)&p, sizeof(LODPoint));
+        child_count[k]++;
+      }
+    }
+    in.close();
+    boost::filesystem::remove(filename);
+    vector<LODPoint>().swap(block);
+
+    for (int k = 0; k < 8; ++k) {
+      if (children[k] == 0) continue;
+      children[k]->close();
+      delete children[k];
+    }
+
+    // append the points of this node to the point file
+    if (!kept.empty())
+      points.write((const char*)&kept[0], kept.size() * sizeof(LODPoint));
+    if (!points.good()) throw runtime_error("Could not write the points");
+
+    LODNode& rec = nodes[id];
+    rec.nrpts = kept.size();
+    rec.offset = written;
+    // the points of a scan are distributed on surfaces
+    rec.spacing = 2.0 * rec.size / sqrt((double)(kept.size() > 0 ? kept.size() : 1));
+    for (int k = 0; k < 8; ++k) rec.child[k] = child_id[k];
+    written += kept.size();
+    vector<LODPoint>().swap(kept);
+
+    for (int k = 0; k < 8; ++k) {
+      if (child_id[k] >= 0) build(child_id[k], child_count[k], depth + 1);
+    }
+  }
+
+  vector<LODNode> nodes;
+
+private:
+  string nodeFile(unsigned int id)
+  {
+    return tmpdir + "node" + to_string(id) + ".tmp";
+  }
+
+  string tmpdir;
+  ofstream& points;
+  unsigned int capacity;
+  unsigned long long written;
+};
+
+/**
+ * Gets the transformation of a scan into the global coordinate system
+ */
+void getTransformation(Scan* scan, bool use_frames, double transMat[16])
+{
+  const double* frame = scan->get_transMat();
+  if (use_frames) {
+    try {
+      unsigned int nr_frames = scan->readFrames();
+      if (nr_frames > 0) {
+        Scan::AlgoType type;
+        scan->getFrame(nr_frames - 1, frame, type);
+      }
+    } catch(std::ios_base::failure& e) {
+    }
+  }
+  memcpy(transMat, frame, sizeof(double)*16);
+}
+
+/**
+ * program for building the paged level of detail hierarchy
+ * Usage: bin/lod_build 'dir',
+ * with 'dir' the directory of a set of scans
+ */
+int main(int argc, char **argv)
+{
+  if (argc <= 1) {
+    usage(argv[0]);
+  }
+
+  string dir, outdir;
+  double red = -1.0;
+  int octree = 0;
+  int start = 0, end = -1;
+  int maxDist = -1, minDist = -1;
+  bool use_color = false;
+  bool use_reflectance = false;
+  bool use_frames = true;
+  unsigned int capacity = 20000;
+  IOType type = UOS;
+
+  parseArgs(argc, argv, dir, outdir, red, octree, start, end, maxDist, minDist,
+            use_color, use_reflectance, use_frames, capacity, type);
+
+  string tmpdir = outdir + "tmp/";
+  try {
+    boost::filesystem::create_directories(tmpdir);
+  } catch (std::exception& e) {
+    cerr << "Could not create " << tmpdir << ": " << e.what() << endl;
+    exit(-1);
+  }
+
+  Scan::openDirectory(false, dir, type, start, end);
+  if (Scan::allScans.size() == 0) {
+    cerr << "No scans found. Did you use the correct format?" << endl;
+    exit(-1);
+  }
+
+  unsigned int types = PointType::USE_NONE;
+  if (use_color) types |= PointType::USE_COLOR;
+  if (use_reflectance) types |= PointType::USE_REFLECTANCE;
+  PointType pointtype(types);
+
+  // stream all points in global coordinates into the file of the root
+  string rootfile = tmpdir + "node0.tmp";
+  ofstream root(rootfile.c_str(), std::ios::out | std::ios::binary);
+  if (!root.good()) {
+    cerr << "Could not create " << rootfile << endl;
+    exit(-1);
+  }
+
+  double mins[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+  double maxs[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+  unsigned long long nrpts = 0;
+  vector<LODPoint> block;
+
+  for (unsigned int i = 0; i < Scan::allScans.size(); ++i) {
+    Scan* scan = Scan::allScans[i];
+    scan->setRangeFilter(maxDist, minDist);
+    if (red > 0) scan->setReductionParameter(red, octree, pointtype);
+
+    double transMat[16];
+    getTransformation(scan, use_frames, transMat);
+
+    string xyz_string = red > 0 ? "xyz reduced original" : "xyz";
+    string rgb_string = red > 0 ? "color reduced" : "rgb";
+    string refl_string = red > 0 ? "reflectance reduced" : "reflectance";
+
+    DataXYZ xyz(scan->get(xyz_string));
+    DataRGB rgb(use_color ? scan->get(rgb_string) : DataPointer(0, 0));
+    DataReflectance refl(use_reflectance ? scan->get(refl_string)
+                                         : DataPointer(0, 0));
+    bool have_color = use_color && rgb.size() == xyz.size();
+    bool have_refl = !have_color && use_reflectance &&
+      refl.size() == xyz.size();
+
+    // the reflectance is scaled per scan, as its range depends on the scanner
+    float refl_min = FLT_MAX, refl_max = -FLT_MAX;
+    if (have_refl) {
+      for (unsigned int j = 0; j < refl.size(); ++j) {
+        if (refl[j] < refl_min) refl_min = refl[j];
+        if (refl[j] > refl_max) refl_max = refl[j];
+      }
+    }
+    float refl_scale = refl_max > refl_min ? 255.0 / (refl_max - refl_min) : 0.0;
+
+    block.resize(xyz.size());
+    for (unsigned int j = 0; j < xyz.size(); ++j) {
+      double p[3];
+      transform3(transMat, xyz[j], p);
+      LODPoint& lp = block[j];
+      for (int k = 0; k < 3; ++k) {
+        lp.x[k] = p[k];
+        if (p[k] < mins[k]) mins[k] = p[k];
+        if (p[k] > maxs[k]) maxs[k] = p[k];
+      }
+      if (have_color) {
+        lp.rgb[0] = rgb[j][0];
+        lp.rgb[1] = rgb[j][1];
+        lp.rgb[2] = rgb[j][2];
+      } else if (have_refl) {
+        lp.rgb[0] = lp.rgb[1] = lp.rgb[2] =
+          (unsigned char)((refl[j] - refl_min) * refl_scale);
+      } else {
+        lp.rgb[0] = lp.rgb[1] = lp.rgb[2] = 255;
+      }
+      lp.rgb[3] = 0;
+    }
+    if (!block.empty())
+      root.write((const char*)&block[0], block.size() * sizeof(LODPoint));
+    nrpts += block.size();
+    cout << "Scan " << i << ": " << block.size() << " points." << endl;
+
+    // the scans are only needed once
+    scan->clear(DATA_XYZ | DATA_RGB | DATA_REFLECTANCE);
+    if (red > 0) {
+      scan->clear(xyz_string);
+      scan->clear("xyz reduced");
+      if (use_color) scan->clear(rgb_string);
+      if (use_reflectance) scan->clear(refl_string);
+    }
+  }
+  root.close();
+  Scan::closeDirectory();
+
+  if (!root.good() || nrpts == 0) {
+    cerr << "No points written to " << rootfile << endl;
+    exit(-1);
+  }
+
+  // the root cell is the bounding cube of all points
+  LODNode rootnode;
+  float size = 0.0;
+  for (int k = 0; k < 3; ++k) {
+    rootnode.center[k] = (mins[k] + maxs[k]) / 2.0;
+    if ((maxs[k] - mins[k]) / 2.0 > size) size = (maxs[k] - mins[k]) / 2.0;
+  }
+  // points on the upper boundary have to fall into the cube
+  rootnode.size = size * 1.001 + 1e-3;
+
+  string pointfile = outdir + LOD_POINT_FILE;
+  ofstream points(pointfile.c_str(), std::ios::out | std::ios::binary);
+  if (!points.good()) {
+    cerr << "Could not create " << pointfile << endl;
+    exit(-1);
+  }
+
+  cout << "Building the hierarchy of " << nrpts << " points..." << endl;
+  LODBuilder builder(tmpdir, points, capacity);
+  builder.nodes.push_back(rootnode);
+  try {
+    builder.build(0, nrpts, 0);
+  } catch (runtime_error& e) {
+    cerr << e.what() << endl;
+    exit(-1);
+  }
+  points.close();
+  boost::filesystem::remove(tmpdir);
+
+  string indexfile = outdir + LOD_INDEX_FILE;
+  ofstream index(indexfile.c_str(), std::ios::out | std::ios::binary);
+  LODHeader header;
+  memset(&header, 0, sizeof(LODHeader));
+  strncpy(header.magic, LOD_MAGIC, 8);
+  header.version = LOD_VERSION;
+  header.flags = (use_color || use_reflectance) ? LOD_HAS_COLOR : 0;
+  header.nrnodes = builder.nodes.size();
+  header.capacity = capacity;
+  header.nrpts = nrpts;
+  index.write((const char*)&header, sizeof(LODHeader));
+  index.write((const char*)&builder.nodes[0],
+              builder.nodes.size() * sizeof(LODNode));
+  index.close();
+  if (!index.good()) {
+    cerr << "Could not write " << indexfile << endl;
+    exit(-1);
+  }
+
+  cout << "Wrote " << builder.nodes.size() << " nodes to " << outdir << endl;
+  return 0;
+}
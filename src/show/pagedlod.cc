@@ -0,0 +1,242 @@
+/*
+ * pagedlod implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+#include "show/pagedlod.h"
+#include "show/viewcull.h"
+using namespace show;
+
+#include <fstream>
+using std::ifstream;
+#include <iostream>
+using std::cerr;
+using std::cout;
+using std::endl;
+#include <stdexcept>
+using std::runtime_error;
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+PagedLOD::PagedLOD(const std::string& dir, size_t memBudget,
+                   unsigned int _pointBudget, unsigned int nrLoaders)
+  : pointfile(dir + LOD_POINT_FILE), budget(memBudget), used(0),
+    pointBudget(_pointBudget), frame(0), loaded(false), stop(false)
+{
+  std::string indexfile = dir + LOD_INDEX_FILE;
+  ifstream index(indexfile.c_str(), std::ios::in | std::ios::binary);
+  if (!index.good())
+    throw runtime_error("Could not open " + indexfile);
+
+  LODHeader header;
+  index.read((char*)&header, sizeof(LODHeader));
+  if (!index.good() || strncmp(header.magic, LOD_MAGIC, 8) != 0 ||
+      header.version != LOD_VERSION || header.nrnodes == 0)
+    throw runtime_error(indexfile + " is not a level of detail index");
+
+  flags = header.flags;
+  nrpts = header.nrpts;
+  nodes.resize(header.nrnodes);
+  for (unsigned int i = 0; i < nodes.size(); ++i) {
+    index.read((char*)&nodes[i].rec, sizeof(LODNode));
+    nodes[i].state = EMPTY;
+    nodes[i].drawn = 0;
+  }
+  if (!index.good())
+    throw runtime_error(indexfile + " is truncated");
+  index.close();
+
+  ifstream points(pointfile.c_str(), std::ios::in | std::ios::binary);
+  if (!points.good())
+    throw runtime_error("Could not open " + pointfile);
+  points.close();
+
+  cout << "Paged level of detail: " << nrpts << " points in "
+       << nodes.size() << " nodes, " << budget/1024/1024 << " MB cache, "
+       << pointBudget << " points per frame." << endl;
+
+  for (unsigned int i = 0; i < nrLoaders; ++i)
+    loaders.create_thread(boost::bind(&PagedLOD::loaderThread, this));
+}
+
+PagedLOD::~PagedLOD()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    stop = true;
+  }
+  wakeup.notify_all();
+  loaders.join_all();
+}
+
+/**
+ * Onscreen width of the cell of a node in pixels
+ */
+float PagedLOD::projectedSize(const LODNode& n)
+{
+  return LOD2(n.center[0], n.center[1], n.center[2], n.size);
+}
+
+void PagedLOD::display(float pixelError)
+{
+  // nodes to draw, collected under the lock and drawn after releasing it
+  std::vector<unsigned int> visible;
+  boost::unique_lock<boost::mutex> lock(mutex);
+  ++frame;
+
+  // traverse the visible nodes, largest onscreen first
+  std::vector<std::pair<float, unsigned int> > queue;
+  requests.clear();
+  const LODNode& r = nodes[0].rec;
+  if (CubeInFrustum(r.center[0], r.center[1], r.center[2], r.size))
+    queue.push_back(std::make_pair(FLT_MAX, 0u));
+
+  unsigned int points = 0;
+  size_t bytes = 0;
+
+  while (!queue.empty()) {
+    std::pop_heap(queue.begin(), queue.end());
+    std::pair<float, unsigned int> top = queue.back();
+    queue.pop_back();
+    Node& node = nodes[top.second];
+    size_t node_bytes = node.rec.nrpts * sizeof(LODPoint);
+
+    // everything visible has to fit into the cache at the same time
+    if (bytes + node_bytes > budget) continue;
+    bytes += node_bytes;
+
+    if (node.state != RESIDENT) {
+      // draw the parent only until the node has arrived
+      if (node.state == EMPTY) requests.push_back(top);
+      continue;
+    }
+
+    if (points + node.rec.nrpts > pointBudget) break;
+    points += node.rec.nrpts;
+
+    // nodes drawn in this frame are not evicted by the loaders
+    if (node.rec.nrpts > 0) visible.push_back(top.second);
+    node.drawn = frame;
+    lru.splice(lru.begin(), lru, node.lru);
+
+    // refine only if the gaps between the points are visible
+    float size = projectedSize(node.rec);
+    if (size * node.rec.spacing / (2.0 * node.rec.size) <= pixelError)
+      continue;
+    for (int k = 0; k < 8; ++k) {
+      int c = node.rec.child[k];
+      if (c < 0) continue;
+      const LODNode& child = nodes[c].rec;
+      if (!CubeInFrustum(child.center[0], child.center[1], child.center[2],
+                         child.size))
+        continue;
+      queue.push_back(std::make_pair(projectedSize(child), (unsigned int)c));
+      std::push_heap(queue.begin(), queue.end());
+    }
+  }
+
+  std::make_heap(requests.begin(), requests.end());
+  bool request = !requests.empty();
+  lock.unlock();
+  if (request) wakeup.notify_all();
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  if (hasColor()) glEnableClientState(GL_COLOR_ARRAY);
+
+  for (unsigned int i = 0; i < visible.size(); ++i) {
+    const Node& node = nodes[visible[i]];
+    glVertexPointer(3, GL_FLOAT, sizeof(LODPoint), node.pts[0].x);
+    if (hasColor())
+      glColorPointer(3, GL_UNSIGNED_BYTE, sizeof(LODPoint), node.pts[0].rgb);
+    glDrawArrays(GL_POINTS, 0, node.rec.nrpts);
+  }
+
+  if (hasColor()) glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+bool PagedLOD::update()
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  bool result = loaded;
+  loaded = false;
+  return result;
+}
+
+/**
+ * Releases the points of a resident node, the mutex has to be held
+ */
+void PagedLOD::evict(unsigned int id)
+{
+  Node& node = nodes[id];
+  used -= node.pts.size() * sizeof(LODPoint);
+  std::vector<LODPoint>().swap(node.pts);
+  lru.erase(node.lru);
+  node.state = EMPTY;
+}
+
+void PagedLOD::loaderThread()
+{
+  ifstream in(pointfile.c_str(), std::ios::in | std::ios::binary);
+  std::vector<LODPoint> buffer;
+
+  while (true) {
+    unsigned int id;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      while (!stop && requests.empty()) wakeup.wait(lock);
+      if (stop) return;
+      std::pop_heap(requests.begin(), requests.end());
+      id = requests.back().second;
+      requests.pop_back();
+      if (nodes[id].state != EMPTY) continue;
+      nodes[id].state = LOADING;
+    }
+
+    // the node records are never changed, read without holding the lock
+    const LODNode& rec = nodes[id].rec;
+    buffer.resize(rec.nrpts);
+    bool ok = true;
+    if (rec.nrpts > 0) {
+      in.seekg((std::streamoff)(rec.offset * sizeof(LODPoint)));
+      in.read((char*)&buffer[0], rec.nrpts * sizeof(LODPoint));
+      ok = in.good();
+      in.clear();
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    Node& node = nodes[id];
+    if (!ok) {
+      cerr << "Could not read node " << id << " from " << pointfile << endl;
+      node.state = FAILED;
+      continue;
+    }
+
+    // make room by dropping nodes that were not needed for the last frame
+    size_t node_bytes = rec.nrpts * sizeof(LODPoint);
+    while (used + node_bytes > budget && !lru.empty() &&
+           nodes[lru.back()].drawn != frame) {
+      evict(lru.back());
+    }
+    if (used + node_bytes > budget) {
+      node.state = EMPTY;
+      continue;
+    }
+
+    node.pts.swap(buffer);
+    node.state = RESIDENT;
+    // protect the node from eviction until it has been drawn once
+    node.drawn = frame;
+    lru.push_front(id);
+    node.lru = lru.begin();
+    used += node_bytes;
+    loaded = true;
+  }
+}
@@ -14,6 +14,7 @@
 #include "show/colormanager.h"
 #include <vector>
 #include <float.h>
+#include <algorithm>
 #include "slam6d/point_type.h"
 using std::vector;
 
@@ -37,9 +38,18 @@ ScanColorManager::ScanColorManager(unsigned int _buckets, PointType type, bool a
 
       currenttype = PointType::USE_HEIGHT;
       currentdim = 0;
+      nrScans = 0;
+      currentmode = MODE_STATIC;
+      minmaxset = false;
     }
 
-    void ScanColorManager::registerTree(colordisplay *b) { allScans.push_back(b); }
+    void ScanColorManager::registerTree(colordisplay *b) {
+      allScans.push_back(b);
+      // trees registered later on need their own managers as well
+      valid = false;
+    }
+
+    void ScanColorManager::setNumberOfScans(unsigned int n) { nrScans = n; }
     
     void ScanColorManager::setColorMap(ColorMap &cm) {
       makeValid();
@@ -72,11 +82,16 @@ ScanColorManager::ScanColorManager(unsigned int _buckets, PointType type, bool a
 
     void ScanColorManager::setMinMax(float min, float max) {
       makeValid();
+      currentmin = min;
+      currentmax = max;
+      minmaxset = true;
       for (unsigned int i = 0; i < allManager.size(); i++) {
         allManager[i]->setMinMax(min, max);
       }
     }
     void ScanColorManager::setMode(const unsigned int &mode) {
+      makeValid();
+      currentmode = mode;
       if (mode == ScanColorManager::MODE_STATIC) {
         for (unsigned int i = 0; i < allScans.size(); i++) {
           allScans[i]->setColorManager(staticManager[i]);
@@ -105,7 +120,9 @@ ScanColorManager::ScanColorManager(unsigned int _buckets, PointType type, bool a
     unsigned int ScanColorManager::getPointDim() { return pointtype.getPointDim(); };
     void ScanColorManager::makeValid() {
       if (!valid) {
-        for (unsigned int i = 0; i < allScans.size(); i++) {
+        // only create managers for trees registered since the last call
+        unsigned int n = std::max(nrScans, (unsigned int)allScans.size());
+        for (unsigned int i = staticManager.size(); i < allScans.size(); i++) {
           colordisplay *scan = allScans[i];
           ColorManager *cm = new ColorManager(buckets, pointtype.getPointDim(), mins, maxs);
           cm->setCurrentDim(currentdim);
@@ -116,7 +133,7 @@ ScanColorManager::ScanColorManager(unsigned int _buckets, PointType type, bool a
           DiffMap m;
 //          JetMap m;
           float c[3] = {0,0,0};
-          m.calcColor(c, i, allScans.size() );
+          m.calcColor(c, i, n);
           ColorManager *cmc = new ColorManager(buckets,
 									  pointtype.getPointDim(),
 									  mins, maxs,
@@ -130,6 +147,22 @@ ScanColorManager::ScanColorManager(unsigned int _buckets, PointType type, bool a
 									    pointtype.getType(PointType::USE_COLOR));
           colorsManager.push_back(ccm);
 
+          // same dimension, range and mode as the managers of the other trees
+          cmc->setCurrentDim(currentdim);
+          ccm->setCurrentDim(currentdim);
+          if (minmaxset) {
+            cm->setMinMax(currentmin, currentmax);
+            cmc->setMinMax(currentmin, currentmax);
+            ccm->setMinMax(currentmin, currentmax);
+          }
+          if (currentmode == MODE_COLOR_SCAN) {
+            scan->setColorManager(cmc);
+          } else if (currentmode == MODE_POINT_COLOR) {
+            scan->setColorManager(ccm);
+          } else if (currentmode == MODE_ANIMATION && animationColor) {
+            scan->setColorManager(0);
+          }
+
           allManager.push_back(cm);
           allManager.push_back(cmc);
           allManager.push_back(ccm);
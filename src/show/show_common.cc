@@ -22,6 +22,7 @@
 #include "show/compacttree.h"
 #include "show/NurbsPath.h"
 #include "show/vertexarray.h"
+#include "show/pagedlod.h"
 #ifndef DYNAMIC_OBJECT_REMOVAL
 #include "slam6d/scan.h"
 #include "slam6d/managedScan.h"
@@ -35,6 +36,11 @@ using std::ifstream;
 using std::exception;
 #include <algorithm>
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 
 #ifdef _MSC_VER
 #include "XGetopt.h"
@@ -76,6 +82,10 @@ vector< ::SDisplay*> displays;
  */
 //Show_BOctTree **octpts;
 vector<colordisplay*> octpts;
+/**
+ * the out-of-core level of detail hierarchy, used instead of octpts
+ */
+PagedLOD *paged_lod = 0;
 /**
  * Storing the base directory
  */
@@ -328,6 +338,8 @@ char *selection_file_name;
 
 // show_gl needs to know this function for correct handling of close event
 void deinitShow();
+// and this one to show scans and nodes as soon as they are available
+bool publishLoadedOctrees();
 
 int current_frame = 0;
 #include "show_menu.cc"
@@ -450,6 +462,40 @@ void usage(char* prog)
        << "         --reflectance/--amplitude and similar parameters are therefore ignored." << endl
        << "         only works when using octree display" << endl
        << endl
+    << bold << "  --loaders=" << normal << "NR" << endl
+       << "         build the display octrees with NR threads in the background" << endl
+       << "         [default: number of cores], scans appear as they are finished" << endl
+       << endl
+    << bold << "  --membudget=" << normal << "NR" << endl
+       << "         stop creating display octrees once they occupy NR MB of memory" << endl
+       << "         [default: unlimited], not used together with the scanserver" << endl
+       << "         with --pagedlod the size of the node cache [default: 1024]" << endl
+       << endl
+    << bold << "  --vbo" << endl << normal
+       << "         draw the octrees from vertex buffers of whole subtrees" << endl
+       << "         instead of point by point (uses buffer objects with glee)" << endl
+       << endl
+    << bold << "  --occlusion" << endl << normal
+       << "         skip octree nodes hidden behind the points of the previous frame" << endl
+       << "         while the camera rests (reads back the depth buffer every frame)" << endl
+       << endl
+    << bold << "  --pagedlod" << endl << normal
+       << "         the directory holds a level of detail hierarchy built by lod_build," << endl
+       << "         visible parts of it are streamed from disk instead of loading scans" << endl
+       << endl
+    << bold << "  --pointbudget=" << normal << "NR" << endl
+       << "         draw at most NR points per frame with --pagedlod [default: 5000000]" << endl
+       << endl
+    << bold << "  --benchmark=" << normal << "FILE" << endl
+       << "         render the camera path saved in FILE once all scans are loaded," << endl
+       << "         write the time per frame to benchmark.txt in the scan directory and exit" << endl
+       << endl
+    << bold << "  --benchframes=" << normal << "NR" << endl
+       << "         render NR frames of the benchmark [default: length of the path]" << endl
+       << endl
+    << bold << "  --benchppm" << endl << normal
+       << "         also save every benchmark frame as benchframeNNNNN.ppm" << endl
+       << endl
     << bold << "  -A, --noanimcolor" << endl << normal
        << "         do not switch to different color settings when displaying animation" << endl
        << endl
@@ -472,6 +518,10 @@ void usage(char* prog)
  * @param minDist parsing result - minimal distance
  * @param readInitial parsing result -  read a file containing a initial transformation matrix
  * @param type parsing result - file format to be read
+ * @param loaders parsing result - number of octree loader threads
+ * @param membudget parsing result - memory budget for the octrees in MB
+ * @param pagedlod parsing result - directory contains a paged hierarchy
+ * @param pointbudget parsing result - maximal number of points per frame
  * @return 0, if the parsing was successful, 1 otherwise
  */
 int parseArgs(int argc,char **argv,
@@ -480,7 +530,9 @@ int parseArgs(int argc,char **argv,
               PointType &ptype, float &fps, string &loadObj,
               bool &loadOct, bool &saveOct, int &origin, bool &originset,
               double &scale, IOType &type, bool& scanserver, 
-              double& sphereMode, string& customFilter)
+              double& sphereMode, string& customFilter,
+              int& loaders, double& membudget,
+              bool& pagedlod, unsigned int& pointbudget)
 {
   unsigned int types = PointType::USE_NONE;
   start   = 0;
@@ -524,6 +576,15 @@ int parseArgs(int argc,char **argv,
     { "sphere",          required_argument,   0,  'b' },
     { "noanimcolor",     no_argument,         0,  'A' },
     { "customFilter",    required_argument,   0,  'u' },
+    { "loaders",         required_argument,   0,  '3' },
+    { "membudget",       required_argument,   0,  '4' },
+    { "pagedlod",        no_argument,         0,  '5' },
+    { "pointbudget",     required_argument,   0,  '6' },
+    { "vbo",             no_argument,         0,  '7' },
+    { "benchmark",       required_argument,   0,  '8' },
+    { "benchframes",     required_argument,   0,  '9' },
+    { "benchppm",        no_argument,         0,  'B' },
+    { "occlusion",       no_argument,         0,  'N' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
@@ -650,6 +711,43 @@ int parseArgs(int argc,char **argv,
       case 'u':
         customFilter = optarg;
         break;
+      case '3':
+        loaders = atoi(optarg);
+        if (loaders < 1) {
+          cerr << "Error: At least one loader thread is needed.\n"; exit(1);
+        }
+        break;
+      case '4':
+        membudget = atof(optarg);
+        break;
+      case '5':
+        pagedlod = true;
+        break;
+      case '6':
+        if (atoi(optarg) < 1) {
+          cerr << "Error: At least one point has to be drawn.\n"; exit(1);
+        }
+        pointbudget = atoi(optarg);
+        break;
+      case '7':
+#ifndef USE_COMPACT_TREE
+        Show_BOctTree<sfloat>::batched = true;
+#else
+        cerr << "Vertex buffers are not supported by the compact octree." << endl;
+#endif
+        break;
+      case '8':
+        benchmark_path = optarg;
+        break;
+      case '9':
+        benchmark_frames = atoi(optarg);
+        break;
+      case 'B':
+        benchmark_ppm = true;
+        break;
+      case 'N':
+        occlusion_culling = true;
+        break;
       default:
         abort ();
     }
@@ -667,7 +765,7 @@ int parseArgs(int argc,char **argv,
   if (dir[dir.length()-1] != '\\') dir = dir + "\\";
 #endif
   
-  parseFormatFile(dir, w_type, w_start, w_end);
+  if (!pagedlod) parseFormatFile(dir, w_type, w_start, w_end);
 
   ptype = PointType(types);
   return 0;
@@ -880,6 +978,336 @@ void reloadFrames() {
     generateFrames(startScanIdx, endScanIdx, true);
 }
 
+/**
+ * Prints the memory footprint of a finished display octree
+ */
+void printOctreeFinished(unsigned int i, unsigned int tree_size)
+{
+  cout << "Scan " << i << " octree finished (";
+  bool space = false;
+  if (tree_size/1024/1024 > 0) {
+    cout << tree_size/1024/1024 << "M";
+    space = true;
+  }      
+  if ((tree_size/1024)%1024 > 0) {
+    if (space) cout << " ";
+    cout << (tree_size/1024)%1024 << "K";
+    space = true;
+  }
+  if (tree_size%1024 > 0) {
+    if (space) cout << " ";
+    cout << tree_size%1024 << "B";
+  }
+  cout << ")." << endl;
+}
+
+/**
+ * Background construction of the display octrees without the scanserver.
+ * A pool of threads builds the trees of all scans concurrently, while
+ * publishLoadedOctrees() hands them over to octpts in scan order from the
+ * idle callback, so that the viewer is usable right from the start and scans
+ * become visible as soon as they are finished.
+ */
+struct OctreeLoader {
+  enum State { PENDING, FINISHED, FAILED };
+  
+  //! Result of the octree construction of one scan
+  struct Slot {
+    Slot() : state(PENDING), tree(0) {}
+    State state;
+#ifdef USE_COMPACT_TREE
+    compactTree* tree;
+#else
+    DataOcttree* tree;
+#endif
+  };
+  
+  OctreeLoader() : next(0), published(0), active(0), used(0), budget(0),
+                   estimate(0), stop(false), running(false) {}
+  
+  vector<Slot> slots;
+  //! next scan to be built and next scan to be handed over to the viewer
+  unsigned int next, published;
+  //! number of octrees under construction
+  unsigned int active;
+  //! memory occupied by the finished and reserved for the octrees under
+  //! construction, and the allowed maximum
+  std::size_t used, budget;
+  //! size of the largest octree so far, reserved for each new one
+  std::size_t estimate;
+  bool stop, running;
+  
+  //! tree parameters for the compact trees, the others are set per scan
+  double red;
+  bool loadOct, saveOct;
+  string dir;
+  
+  boost::mutex mutex;
+  boost::condition_variable changed;
+  boost::thread_group threads;
+};
+
+OctreeLoader octree_loader;
+
+/**
+ * Worker of the OctreeLoader, builds the octrees of the next scans
+ * until all are done or the memory budget is used up
+ */
+void octreeLoaderThread()
+{
+  OctreeLoader& l = octree_loader;
+  
+  for (;;) {
+    unsigned int i;
+    std::size_t reserved = 0;
+    {
+      // reserve the size of the largest octree so far before building,
+      // only one octree is built until a size is known
+      boost::unique_lock<boost::mutex> lock(l.mutex);
+      while (!l.stop && l.next < l.slots.size() && l.budget > 0 &&
+             l.active > 0 &&
+             (l.estimate == 0 || l.used + l.estimate > l.budget))
+        l.changed.wait(lock);
+      if (l.stop || l.next >= l.slots.size()) return;
+      if (l.budget > 0 && l.used + l.estimate > l.budget) {
+        cout << "Stopping at scan " << l.next
+             << ", no more octtrees fit into the memory budget." << endl;
+        l.stop = true;
+        l.changed.notify_all();
+        return;
+      }
+      i = l.next++;
+      if (l.budget > 0) reserved = l.estimate;
+      l.used += reserved;
+      l.active++;
+    }
+    Scan* scan = Scan::allScans[i];
+    unsigned int tree_size = 0;
+    bool failed = false;
+    
+#ifdef USE_COMPACT_TREE
+    compactTree* tree = 0;
+    try {
+      if (l.loadOct) {
+        string sfName = l.dir + "scan" + to_string(i,3) + ".oct";
+        tree = new compactTree(sfName);
+      } else {
+        // the color manager is not thread safe, the tree is registered
+        // when it is handed over in publishLoadedOctrees()
+        if (l.red > 0) { // with reduction, only xyz points
+          DataXYZ xyz_r(scan->get("xyz reduced show"));
+          tree = new compactTree(PointerArray<double>(xyz_r).get(),
+                                 xyz_r.size(),
+                                 voxelSize,
+                                 pointtype,
+                                 0);
+        } else { // without reduction, xyz + attribute points
+          PointType ptype(pointtype);
+          PointBuffer<sfloat> pts(ptype, scan);
+          tree = new compactTree(pts.get(), pts.size(), voxelSize, ptype, 0);
+          if (l.saveOct) {
+            string sfName = l.dir + "scan" + to_string(i,3) + ".oct";
+            tree->serialize(sfName);
+          }
+        }
+      }
+      tree_size = tree->getMemorySize();
+    } catch(...) {
+      boost::lock_guard<boost::mutex> lock(l.mutex);
+      cout << "Scan " << i
+           << " could not be loaded into memory, stopping here."
+           << endl;
+      failed = true;
+    }
+#else
+    DataOcttree* tree = 0;
+    try {
+      tree = new DataOcttree(scan->get("octtree"));
+      tree_size = tree->get().getMemorySize();
+    } catch(exception& e) {
+      boost::lock_guard<boost::mutex> lock(l.mutex);
+      cout << "Scan " << i
+           << " could not be loaded into memory, stopping here. Reason: "
+           << e.what()
+           << endl;
+      failed = true;
+    }
+#endif
+    
+    boost::lock_guard<boost::mutex> lock(l.mutex);
+    l.active--;
+    l.used -= reserved;
+    if (tree_size > l.estimate) l.estimate = tree_size;
+    l.changed.notify_all();
+    if (!failed && l.budget > 0 && l.used + tree_size > l.budget) {
+      cout << "Stopping at scan " << i
+           << ", no more octtrees fit into the memory budget." << endl;
+      delete tree;
+      failed = true;
+    }
+    if (failed) {
+      // later scans could not be shown in order anyway
+      l.slots[i].state = OctreeLoader::FAILED;
+      l.stop = true;
+      return;
+    }
+    l.used += tree_size;
+    l.slots[i].tree = tree;
+    l.slots[i].state = OctreeLoader::FINISHED;
+    printOctreeFinished(i, tree_size);
+  }
+}
+
+/**
+ * Starts building the display octrees for all scans with \a nr_threads
+ * threads, the octrees may occupy \a budget bytes (0 for no limit)
+ */
+void startOctreeLoaders(int nr_threads, std::size_t budget,
+                        double red, bool loadOct, bool saveOct,
+                        const string& dir)
+{
+  OctreeLoader& l = octree_loader;
+  l.slots.resize(Scan::allScans.size());
+  l.budget = budget;
+  l.red = red;
+  l.loadOct = loadOct;
+  l.saveOct = saveOct;
+  l.dir = dir;
+  l.running = true;
+  for (int t = 0; t < nr_threads; ++t)
+    l.threads.create_thread(octreeLoaderThread);
+}
+
+/**
+ * Waits until no more octrees are being built
+ */
+void joinOctreeLoaders()
+{
+  octree_loader.threads.join_all();
+}
+
+/**
+ * Hands finished octrees over to the viewer, strictly in scan order, since
+ * octpts has to match the indices of MetaMatrix.
+ * Must be called from the thread owning the OpenGL context.
+ *
+ * @return true, if new scans or paged nodes have become visible
+ */
+bool publishLoadedOctrees()
+{
+  if (paged_lod) return paged_lod->update();
+  
+  OctreeLoader& l = octree_loader;
+  if (!l.running) return false;
+  
+  vector<OctreeLoader::Slot> ready;
+  {
+    boost::lock_guard<boost::mutex> lock(l.mutex);
+    while (l.published < l.slots.size() &&
+           l.slots[l.published].state == OctreeLoader::FINISHED) {
+      ready.push_back(l.slots[l.published]);
+      l.slots[l.published].tree = 0;
+      l.published++;
+    }
+    // done if everything is handed over or the next scan will never come
+    if (l.published == l.slots.size() ||
+        l.slots[l.published].state == OctreeLoader::FAILED ||
+        (l.stop && l.published == l.next)) {
+      l.running = false;
+    }
+  }
+  
+  for (unsigned int i = 0; i < ready.size(); ++i) {
+#ifdef USE_COMPACT_TREE
+    compactTree* tree = ready[i].tree;
+    tree->registerColorManager(cm);
+#else
+    // show structures
+    // associate show octtree with the scan and
+    // hand over octtree pointer ownership
+    Show_BOctTree<sfloat>* tree =
+      new Show_BOctTree<sfloat>(Scan::allScans[octpts.size()],
+                                ready[i].tree, cm);
+    
+    // unlock cached octtree to enable creation
+    // of more octtres without blocking the space for full scan points
+    tree->unlockCachedTree();
+#endif
+    octpts.push_back(tree);
+  }
+  
+  if (!l.running) {
+    // all trees that could be shown have been handed over
+    joinOctreeLoaders();
+    for (unsigned int i = l.published; i < l.slots.size(); ++i)
+      delete l.slots[i].tree;
+    l.slots.clear();
+    cout << octpts.size() << " of " << Scan::allScans.size()
+         << " scans loaded." << endl;
+  }
+  
+  if (ready.empty()) return false;
+  
+  if (octpts.size() == ready.size()) {
+    // the first trees set up the coloring from the menu
+    mapColorToValue(0);
+    changeColorMap(0);
+    setScansColored(0);
+  } else {
+    // later trees get color managers with the current settings
+    cm->makeValid();
+  }
+  return true;
+}
+
+/**
+ * Stops the octree construction and releases all trees not yet handed over
+ */
+void stopOctreeLoaders()
+{
+  OctreeLoader& l = octree_loader;
+  {
+    boost::lock_guard<boost::mutex> lock(l.mutex);
+    l.stop = true;
+  }
+  l.changed.notify_all();
+  joinOctreeLoaders();
+  for (unsigned int i = l.published; i < l.slots.size(); ++i)
+    delete l.slots[i].tree;
+  l.slots.clear();
+  l.running = false;
+}
+
+/**
+ * Sets up the viewer for a lod_build hierarchy instead of scans. The points
+ * are already in global coordinates, a single identity frame is used.
+ */
+void initPagedLOD(const string& dir, int loaders, double membudget,
+                  unsigned int pointbudget)
+{
+  if (membudget <= 0.0) membudget = 1024.0;
+  try {
+    paged_lod = new PagedLOD(dir, (std::size_t)(membudget * 1024 * 1024),
+                             pointbudget, loaders);
+  } catch (std::exception& e) {
+    cerr << e.what() << endl;
+    exit(-1);
+  }
+  
+  cm = new ScanColorManager(4096, pointtype, /* animation_color = */ true);
+  cm->setCurrentType(PointType::USE_HEIGHT);
+  
+  startScanIdx = endScanIdx = 0;
+  readIni = false;
+  generateFrames(0, 0, true);
+  selected_points = new set<sfloat*>[1];
+  
+  RVX = RVY = RVZ = X = Y = Z = 0.0;
+  for (unsigned int i = 0; i < 256; i++) {
+    keymap[i] = false;
+  }
+}
+
 void initShow(int argc, char **argv){
 
   /***************/
@@ -911,6 +1339,11 @@ void initShow(int argc, char **argv){
   double sphereMode = 0.0;
   bool customFilterActive = false;
   string customFilter;
+  int loaders = boost::thread::hardware_concurrency();
+  if (loaders < 1) loaders = 1;
+  double membudget = 0.0;
+  bool pagedlod = false;
+  unsigned int pointbudget = 5000000;
 
   pose_file_name = new char[1024];
   path_file_name = new char[1024];
@@ -922,7 +1355,8 @@ void initShow(int argc, char **argv){
 
   parseArgs(argc, argv, dir, start, end, maxDist, minDist, red, readInitial,
             octree, pointtype, idealfps, loadObj, loadOct, saveOct, origin,
-			originset, scale, type, scanserver, sphereMode, customFilter);
+			originset, scale, type, scanserver, sphereMode, customFilter,
+            loaders, membudget, pagedlod, pointbudget);
 
   // modify all scale dependant variables
   scale = 1.0 / scale;
@@ -955,6 +1389,11 @@ void initShow(int argc, char **argv){
   // init and create display
   M4identity(view_rotate_button);
   obj_pos_button[0] = obj_pos_button[1] = obj_pos_button[2] = 0.0;
+
+  if (pagedlod) {
+    initPagedLOD(dir, loaders, membudget, pointbudget);
+    return;
+  }
   
   // Loading scans, reducing, loading frames and generation if neccessary
   
@@ -1042,66 +1481,77 @@ void initShow(int argc, char **argv){
     cout << "Loading octtrees from file where possible instead of creating them from scans."
          << endl;
   
-  // for managed scans the input phase needs to know how much it can handle
-  std::size_t free_mem = 0;
-  if(scanserver)
-    free_mem = ManagedScan::getMemorySize();
-  
-  for(unsigned int i = 0; i < Scan::allScans.size(); ++i) {
-    Scan* scan = Scan::allScans[i];
+  if (!scanserver) {
+    // build the octrees in the background, the view is set up meanwhile
+#if !defined USE_COMPACT_TREE
+    for(unsigned int i = 0; i < Scan::allScans.size(); ++i) {
+      Scan::allScans[i]->setOcttreeParameter(red, voxelSize, pointtype,
+                                             loadOct, saveOct);
+    }
+#endif
+    cm->setNumberOfScans(Scan::allScans.size());
+    cout << "Creating the octrees with " << loaders << " threads." << endl;
+    startOctreeLoaders(loaders, (std::size_t)(membudget * 1024 * 1024),
+                       red, loadOct, saveOct, dir);
+  } else {
+#if !defined USE_COMPACT_TREE
+    // for managed scans the input phase needs to know how much it can handle
+    std::size_t free_mem = ManagedScan::getMemorySize();
+#endif
+    
+    for(unsigned int i = 0; i < Scan::allScans.size(); ++i) {
+      Scan* scan = Scan::allScans[i];
+      unsigned int tree_size = 0;
   
-  // create data structures
+    // create data structures
 #ifdef USE_COMPACT_TREE // FIXME: change compact tree, then this case can be removed
-    compactTree* tree;
-    try {
-      if (loadOct) {
-        string sfName = dir + "scan" + to_string(i,3) + ".oct";
-        cout << "Load " << sfName;
-        tree = new compactTree(sfName, cm);
-        cout << " done." << endl;
-      } else {
-        if (red > 0) { // with reduction, only xyz points
-          DataXYZ xyz_r(scan->get("xyz reduced show"));
-          tree = new compactTree(PointerArray<double>(xyz_r).get(),
-                                 xyz_r.size(),
-                                 voxelSize,
-                                 pointtype,
-                                 cm);
-        } else { // without reduction, xyz + attribute points
-          sfloat** pts = pointtype.createPointArray<sfloat>(scan);
-          unsigned int nrpts = scan->size<DataXYZ>("xyz");
-          tree = new compactTree(pts, nrpts, voxelSize, pointtype, cm);
-          for(unsigned int i = 0; i < nrpts; ++i) delete[] pts[i];
-          delete[] pts;
-          if (saveOct) {
-            string sfName = dir + "scan" + to_string(i,3) + ".oct";
-            tree->serialize(sfName);
+      compactTree* tree;
+      try {
+        if (loadOct) {
+          string sfName = dir + "scan" + to_string(i,3) + ".oct";
+          cout << "Load " << sfName;
+          tree = new compactTree(sfName, cm);
+          cout << " done." << endl;
+        } else {
+          if (red > 0) { // with reduction, only xyz points
+            DataXYZ xyz_r(scan->get("xyz reduced show"));
+            tree = new compactTree(PointerArray<double>(xyz_r).get(),
+                                   xyz_r.size(),
+                                   voxelSize,
+                                   pointtype,
+                                   cm);
+          } else { // without reduction, xyz + attribute points
+            PointBuffer<sfloat> pts(pointtype, scan);
+            tree = new compactTree(pts.get(), pts.size(), voxelSize,
+                                   pointtype, cm);
+            if (saveOct) {
+              string sfName = dir + "scan" + to_string(i,3) + ".oct";
+              tree->serialize(sfName);
+            }
           }
         }
+      } catch(...) {
+        cout << "Scan " << i
+             << " could not be loaded into memory, stopping here."
+             << endl;
+        break;
       }
-    } catch(...) {
-      cout << "Scan " << i
-           << " could not be loaded into memory, stopping here."
-           << endl;
-      break;
-    }
 #else // FIXME: remove the case above
-    scan->setOcttreeParameter(red, voxelSize, pointtype, loadOct, saveOct);
-    
-    DataOcttree* data_oct;
-    try {
-      data_oct = new DataOcttree(scan->get("octtree"));
-    } catch(runtime_error& e) {
-      cout << "Scan " << i
-           << " could not be loaded into memory, stopping here. Reason: "
-           << e.what()
-           << endl;
-      break;
-    }
-    BOctTree<float>* btree = &(data_oct->get());
-    unsigned int tree_size = btree->getMemorySize();
-    
-    if(scanserver) {
+      scan->setOcttreeParameter(red, voxelSize, pointtype, loadOct, saveOct);
+      
+      DataOcttree* data_oct;
+      try {
+        data_oct = new DataOcttree(scan->get("octtree"));
+      } catch(runtime_error& e) {
+        cout << "Scan " << i
+             << " could not be loaded into memory, stopping here. Reason: "
+             << e.what()
+             << endl;
+        break;
+      }
+      BOctTree<float>* btree = &(data_oct->get());
+      tree_size = btree->getMemorySize();
+      
       // check if the octtree would actually fit with all the others
       if(tree_size > free_mem) {
         delete data_oct;
@@ -1112,46 +1562,26 @@ void initShow(int argc, char **argv){
         // subtract available memory
         free_mem -= tree_size;
       }
-    }
 #endif //FIXME: COMPACT_TREE
-    
+      
 #if !defined USE_COMPACT_TREE
-    // show structures
-    // associate show octtree with the scan and
-    // hand over octtree pointer ownership
+      // show structures
+      // associate show octtree with the scan and
+      // hand over octtree pointer ownership
 
-    Show_BOctTree<sfloat>* tree = new Show_BOctTree<sfloat>(scan, data_oct, cm);
-    
-    // unlock cached octtree to enable creation
-    // of more octtres without blocking the space for full scan points
-    tree->unlockCachedTree();
+      Show_BOctTree<sfloat>* tree = new Show_BOctTree<sfloat>(scan, data_oct, cm);
+      
+      // unlock cached octtree to enable creation
+      // of more octtres without blocking the space for full scan points
+      tree->unlockCachedTree();
 #endif
 
-    // octtrees have been created successfully
-    octpts.push_back(tree);
-    
-    // print something
-#ifdef USE_COMPACT_TREE
-    // TODO: change compact tree for memory footprint output, remove this case
-    cout << "Scan " << i << " octree finished." << endl;
-#else
-    cout << "Scan " << i << " octree finished (";
-    bool space = false;
-    if (tree_size/1024/1024 > 0) {
-      cout << tree_size/1024/1024 << "M";
-      space = true;
-    }      
-    if ((tree_size/1024)%1024 > 0) {
-      if (space) cout << " ";
-      cout << (tree_size/1024)%1024 << "K";
-      space = true;
-    }
-    if (tree_size%1024 > 0) {
-      if (space) cout << " ";
-      cout << tree_size%1024 << "B";
+      // octtrees have been created successfully
+      octpts.push_back(tree);
+      
+      // print something
+      printOctreeFinished(i, tree_size);
     }
-    cout << ")." << endl;
-#endif
   }
 
 /*
@@ -1199,9 +1629,11 @@ void initShow(int argc, char **argv){
 #endif // !COMPACT_TREE
 
 
-  // load frames now that we know how many scans we actually loaded
+  // load frames now that we know how many scans we actually loaded, the
+  // octree loaders are going to provide all scans that fit into memory
+  unsigned int nr_scans = scanserver ? octpts.size() : Scan::allScans.size();
   unsigned int real_end = min((unsigned int)(end), 
-                              (unsigned int)(start + octpts.size() - 1));
+                              (unsigned int)(start + nr_scans - 1));
 
   // necessary to save these to allow filtering of scans from view and reloading frames; could also make those global..
   startScanIdx = start;
@@ -1217,10 +1649,15 @@ void initShow(int argc, char **argv){
   //cm->setColorMap(cmap);
   resetMinMax(0);
 
-  selected_points = new set<sfloat*>[octpts.size()];
+  selected_points = new set<sfloat*>[nr_scans];
 
   // sets (and computes if necessary) the pose that is used for the reset button
   if (originset) {
+    if (origin >= 0 && !scanserver) {
+      // the center of the scans is needed, wait for their octrees
+      joinOctreeLoaders();
+      publishLoadedOctrees();
+    }
     setResetView(origin);
   } else {
       RVX = RVY = RVZ = X = Y = Z = 0.0;
@@ -1241,6 +1678,9 @@ void deinitShow()
   done = true;
   
   cout << "Cleaning up octtrees and scans." << endl;
+  stopOctreeLoaders();
+  delete paged_lod;
+  paged_lod = 0;
   if(octpts.size()) {
     // delete octtrees to release the cache locks within
     for(vector<colordisplay*>::iterator it = octpts.begin();
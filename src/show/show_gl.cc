@@ -28,6 +28,18 @@ int    pointmode      = -1;
 bool   smallfont      = true;
 bool   label          = true;
 
+/**
+ * Benchmark mode: renders the frames of a saved camera path as fast as
+ * possible, reports the time per frame and exits
+ */
+string benchmark_path;                  // camera path file, empty if off
+int    benchmark_frames = 0;            // number of frames, 0 for the path
+bool   benchmark_ppm    = false;        // write each frame to a ppm file
+vector<unsigned long> benchmark_times;  // milliseconds per frame
+
+// waits for the octrees built in the background
+void joinOctreeLoaders();
+
 /**
  * Displays all data (i.e., points) that are to be displayed
  * @param mode spezification for drawing to screen or in selection mode
@@ -122,6 +134,8 @@ void DrawPoints(GLenum mode, bool interruptable)
         glDrawBuffer (GL_FRONT);
       }
       glPointSize(pointsize);
+      // the camera is set, the model transformations follow per scan
+      BeginOcclusion();
 
       vector<int> sequence;
       calcPointSequence(sequence, current_frame);
@@ -173,6 +187,7 @@ void DrawPoints(GLenum mode, bool interruptable)
           glFinish();
           if (isInterrupted()) {
             glPopMatrix();
+            EndOcclusion();
             return;
           }
           octpts[iterator]->display();
@@ -193,6 +208,25 @@ void DrawPoints(GLenum mode, bool interruptable)
         
         glPopMatrix();
       }
+
+      if (paged_lod) {
+        glPushMatrix();
+        if (invert)
+          glColor4d(1.0, 1.0, 1.0, 0.0);
+        else
+          glColor4d(0.0, 0.0, 0.0, 0.0);
+        glMultMatrixd(MetaMatrix[0].back());
+        ExtractFrustum(pointsize);
+        // gaps of one point size are acceptable once the view rests
+        if (pointmode == 1 || interruptable) {
+          paged_lod->display(pointsize);
+        } else {
+          paged_lod->display(pointsize / LevelOfDetail);
+        }
+        glPopMatrix();
+      }
+
+      EndOcclusion();
     }
   }
 
@@ -885,6 +919,89 @@ void CallBackDisplayFunc()
 
 }
 
+/**
+ * Writes the per frame timings to benchmark.txt and prints a summary
+ */
+void writeBenchmark()
+{
+  string filename = scan_dir + "benchmark.txt";
+  ofstream out(filename.c_str());
+  unsigned long total = 0;
+  for (unsigned int i = 0; i < benchmark_times.size(); i++) {
+    out << i << " " << benchmark_times[i] << endl;
+    total += benchmark_times[i];
+  }
+  out.close();
+
+  vector<unsigned long> sorted(benchmark_times);
+  sort(sorted.begin(), sorted.end());
+  unsigned int n = sorted.size();
+  double mean = (double)total / n;
+  cout << "Benchmark: " << n << " frames at " << current_width << "x"
+       << current_height << " in " << total << " ms" << endl
+       << "  mean " << mean << " ms (" << 1000.0 / mean << " fps), median "
+       << sorted[n/2] << " ms, min " << sorted[0] << " ms, max "
+       << sorted[n-1] << " ms, 95% " << sorted[(n*95)/100 < n ? (n*95)/100 : n-1]
+       << " ms" << endl
+       << "  per frame timings written to " << filename << endl;
+}
+
+/**
+ * Renders the next frame of the benchmark, called by the idle function
+ * @return false, if no benchmark is running
+ */
+bool benchmarkFrame()
+{
+  if (benchmark_path.empty()) return false;
+
+  if (benchmark_times.empty()) {
+    // timings are only comparable when all scans are shown
+    joinOctreeLoaders();
+    publishLoadedOctrees();
+
+    strncpy(path_file_name, benchmark_path.c_str(), 1023);
+    path_file_name[1023] = 0;
+    loadPath(0);
+    if (path_vectorX.empty()) {
+      cerr << "No camera path found in " << benchmark_path << endl;
+      exit(-1);
+    }
+    if (benchmark_frames <= 0) benchmark_frames = path_vectorX.size();
+
+    show_cameras = 0;
+    show_path = 0;
+    // always all points, otherwise the detail depends on the last frame rate
+    pointmode = 1;
+    cout << "Benchmark: rendering " << benchmark_frames << " frames of "
+         << benchmark_path << endl;
+  }
+
+  unsigned int frame = benchmark_times.size();
+  // DisplayItFunc follows the path like in the path animation
+  path_iterator = frame % path_vectorX.size();
+  haveToUpdate = 6;
+
+  glDrawBuffer(buffermode);
+  unsigned long time = GetCurrentTimeInMilliSec();
+  DisplayItFunc(GL_RENDER);
+  // wait for the driver, otherwise only the command submission is timed
+  glFinish();
+  benchmark_times.push_back(GetCurrentTimeInMilliSec() - time);
+
+  if (benchmark_ppm) {
+    string filename = scan_dir + "benchframe" + to_string(frame, 5) + ".ppm";
+    glWriteImagePPM(filename.c_str(), 1, 0);
+  }
+  glutSwapBuffers();
+  haveToUpdate = 0;
+
+  if ((int)benchmark_times.size() >= benchmark_frames) {
+    writeBenchmark();
+    exit(0);
+  }
+  return true;
+}
+
 /**
  * This function is called when there is nothing to be done
  * in the screen.
@@ -900,6 +1017,14 @@ void CallBackIdleFunc(void)
 
   if(glutGetWindow() != window_id)
     glutSetWindow(window_id);
+
+  // the benchmark takes over the whole main loop
+  if (benchmarkFrame()) return;
+
+  // show scans whose octrees have been finished in the meantime
+  if (publishLoadedOctrees() && haveToUpdate == 0) {
+    haveToUpdate = 1;
+  }
       
   // return as nothing has to be updated
   if (haveToUpdate == 0) {
@@ -17,6 +17,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
+#include <float.h>
+#include <vector>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #ifdef __APPLE__
 #include <GLUT/glut.h>
@@ -840,6 +846,244 @@ bool CubeInFrustum( float x, float y, float z, float size )
 }
 
 
+int CubeInFrustumMask( float x, float y, float z, float size,
+                       unsigned char &planes )
+{
+   int result = 2;
+   for( int p = 0; p < 6; p++ )
+   {
+      if( !(planes & (1 << p)) )
+         continue;
+
+      // distance of the center and the largest extent towards the normal
+      float d = frustum[p][0] * x + frustum[p][1] * y + frustum[p][2] * z
+              + frustum[p][3];
+      float r = size * ( fabs(frustum[p][0]) + fabs(frustum[p][1])
+                       + fabs(frustum[p][2]) );
+      if( d + r <= 0 )
+         return 0;
+      if( d - r >= 0 )
+         planes &= ~(1 << p);
+      else
+         result = 1;
+   }
+   return result;
+}
+
+unsigned char ChildrenInFrustum( const float center[3], float size,
+                                 unsigned char valid, unsigned char planes,
+                                 unsigned char childplanes[8] )
+{
+   for( int i = 0; i < 8; i++ )
+      childplanes[i] = planes;
+   if( planes == 0 )
+      return valid;
+
+   // child i is shifted by +-h along x, y and z according to bits 0, 1, 2
+   float h = size / 2.0;
+   unsigned char outside = 0;
+
+#ifdef __SSE__
+   const __m128 sx = _mm_setr_ps(-h, h, -h, h);
+   const __m128 sy = _mm_setr_ps(-h, -h, h, h);
+   const __m128 zero = _mm_setzero_ps();
+#endif
+
+   for( int p = 0; p < 6; p++ )
+   {
+      if( !(planes & (1 << p)) )
+         continue;
+      const float *f = frustum[p];
+      float d = f[0] * center[0] + f[1] * center[1] + f[2] * center[2] + f[3];
+      float r = h * ( fabs(f[0]) + fabs(f[1]) + fabs(f[2]) );
+      int out, in;
+
+#ifdef __SSE__
+      __m128 base = _mm_add_ps(_mm_set1_ps(d),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(f[0]), sx),
+                               _mm_mul_ps(_mm_set1_ps(f[1]), sy)));
+      __m128 dz = _mm_set1_ps(f[2] * h);
+      __m128 lo = _mm_sub_ps(base, dz);    // children 0 to 3
+      __m128 hi = _mm_add_ps(base, dz);    // children 4 to 7
+      __m128 vr = _mm_set1_ps(r);
+      out = _mm_movemask_ps(_mm_cmple_ps(_mm_add_ps(lo, vr), zero))
+          | _mm_movemask_ps(_mm_cmple_ps(_mm_add_ps(hi, vr), zero)) << 4;
+      in  = _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(lo, vr), zero))
+          | _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(hi, vr), zero)) << 4;
+#else
+      out = in = 0;
+      for( int i = 0; i < 8; i++ )
+      {
+         float dc = d + f[0] * (i & 1 ? h : -h) + f[1] * (i & 2 ? h : -h)
+                      + f[2] * (i & 4 ? h : -h);
+         if( dc + r <= 0 ) out |= 1 << i;
+         if( dc - r >= 0 ) in |= 1 << i;
+      }
+#endif
+
+      outside |= out;
+      for( int i = 0; i < 8; i++ )
+         if( in & (1 << i) )
+            childplanes[i] &= ~(1 << p);
+      if( (valid & ~outside) == 0 )
+         return 0;
+   }
+   return valid & ~outside;
+}
+
+/** width and height of the screen tiles of the finest pyramid level */
+#define OCCLUSION_TILE 8
+
+bool occlusion_culling = false;
+
+/** farthest window depth per tile, level 0 covers OCCLUSION_TILE pixels */
+static std::vector<std::vector<float> > pyramid;
+static std::vector<int> pyramid_width, pyramid_height;
+/** camera and viewport the pyramid has been built with */
+static GLdouble pyramid_camera[32];
+static GLint pyramid_viewport[4];
+/** camera and viewport of the current frame */
+static GLdouble frame_camera[32];
+static GLint frame_viewport[4];
+/** true, if the pyramid matches the current frame */
+static bool pyramid_valid = false;
+
+void BeginOcclusion()
+{
+   pyramid_valid = false;
+   if( !occlusion_culling )
+      return;
+
+   glGetDoublev( GL_MODELVIEW_MATRIX, frame_camera );
+   glGetDoublev( GL_PROJECTION_MATRIX, frame_camera + 16 );
+   glGetIntegerv( GL_VIEWPORT, frame_viewport );
+
+   pyramid_valid = !pyramid.empty()
+      && memcmp(frame_camera, pyramid_camera, sizeof(pyramid_camera)) == 0
+      && memcmp(frame_viewport, pyramid_viewport, sizeof(pyramid_viewport)) == 0;
+}
+
+void EndOcclusion()
+{
+   pyramid_valid = false;
+   if( !occlusion_culling )
+      return;
+
+   int width = frame_viewport[2], height = frame_viewport[3];
+   if( width <= 0 || height <= 0 )
+      return;
+
+   // read back whatever buffer the points went to
+   GLint buffer;
+   glGetIntegerv( GL_DRAW_BUFFER, &buffer );
+   glReadBuffer( buffer );
+   std::vector<float> depth(width * height);
+   glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+   glReadPixels( frame_viewport[0], frame_viewport[1], width, height,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, &depth[0] );
+
+   int w = (width + OCCLUSION_TILE - 1) / OCCLUSION_TILE;
+   int h = (height + OCCLUSION_TILE - 1) / OCCLUSION_TILE;
+   pyramid.clear();
+   pyramid_width.clear();
+   pyramid_height.clear();
+   pyramid.push_back(std::vector<float>(w * h, 0.0));
+   pyramid_width.push_back(w);
+   pyramid_height.push_back(h);
+
+   std::vector<float> &base = pyramid[0];
+   for( int y = 0; y < height; y++ )
+   {
+      float *tile = &base[(y / OCCLUSION_TILE) * w];
+      const float *row = &depth[y * width];
+      for( int x = 0; x < width; x++ )
+         if( row[x] > tile[x / OCCLUSION_TILE] )
+            tile[x / OCCLUSION_TILE] = row[x];
+   }
+
+   // every coarser level keeps the farthest depth of four tiles
+   while( w > 1 || h > 1 )
+   {
+      int pw = w, ph = h;
+      w = (w + 1) / 2;
+      h = (h + 1) / 2;
+      std::vector<float> level(w * h, 0.0);
+      const std::vector<float> &prev = pyramid.back();
+      for( int y = 0; y < ph; y++ )
+         for( int x = 0; x < pw; x++ )
+         {
+            float &t = level[(y / 2) * w + x / 2];
+            if( prev[y * pw + x] > t )
+               t = prev[y * pw + x];
+         }
+      pyramid.push_back(level);
+      pyramid_width.push_back(w);
+      pyramid_height.push_back(h);
+   }
+
+   memcpy(pyramid_camera, frame_camera, sizeof(pyramid_camera));
+   memcpy(pyramid_viewport, frame_viewport, sizeof(pyramid_viewport));
+}
+
+bool CubeOccluded( float x, float y, float z, float size )
+{
+   if( !pyramid_valid )
+      return false;
+
+   // onscreen bounds and nearest depth of the eight corners
+   float xmin = FLT_MAX, xmax = -FLT_MAX, ymin = FLT_MAX, ymax = -FLT_MAX;
+   float zmin = FLT_MAX;
+   for( int i = 0; i < 8; i++ )
+   {
+      float cx = x + (i & 1 ? size : -size);
+      float cy = y + (i & 2 ? size : -size);
+      float cz = z + (i & 4 ? size : -size);
+      float w = cx * matrix[3] + cy * matrix[7] + cz * matrix[11] + matrix[15];
+      // the cube reaches behind the camera
+      if( w <= 0 )
+         return false;
+      float sx = (cx * matrix[0] + cy * matrix[4] + cz * matrix[8] + matrix[12]) / w;
+      float sy = (cx * matrix[1] + cy * matrix[5] + cz * matrix[9] + matrix[13]) / w;
+      float sz = (cx * matrix[2] + cy * matrix[6] + cz * matrix[10] + matrix[14]) / w;
+      if( sx < xmin ) xmin = sx;
+      if( sx > xmax ) xmax = sx;
+      if( sy < ymin ) ymin = sy;
+      if( sy > ymax ) ymax = sy;
+      if( sz < zmin ) zmin = sz;
+   }
+   if( zmin < -1.0 )
+      return false;
+
+   // window coordinates relative to the viewport, clamped to the screen
+   float zwin = zmin * 0.5 + 0.5;
+   int width = pyramid_viewport[2], height = pyramid_viewport[3];
+   int x0 = (int)((xmin * 0.5 + 0.5) * width);
+   int x1 = (int)((xmax * 0.5 + 0.5) * width);
+   int y0 = (int)((ymin * 0.5 + 0.5) * height);
+   int y1 = (int)((ymax * 0.5 + 0.5) * height);
+   if( x1 < 0 || y1 < 0 || x0 >= width || y0 >= height )
+      return false;
+   x0 = x0 < 0 ? 0 : x0 / OCCLUSION_TILE;
+   y0 = y0 < 0 ? 0 : y0 / OCCLUSION_TILE;
+   x1 = (x1 >= width ? width - 1 : x1) / OCCLUSION_TILE;
+   y1 = (y1 >= height ? height - 1 : y1) / OCCLUSION_TILE;
+
+   // coarsest level at which the cube covers at most 2x2 tiles
+   unsigned int level = 0;
+   while( (x1 - x0 > 1 || y1 - y0 > 1) && level + 1 < pyramid.size() )
+   {
+      x0 /= 2; x1 /= 2; y0 /= 2; y1 /= 2;
+      level++;
+   }
+
+   const std::vector<float> &tiles = pyramid[level];
+   int w = pyramid_width[level];
+   for( int ty = y0; ty <= y1; ty++ )
+      for( int tx = x0; tx <= x1; tx++ )
+         if( zwin <= tiles[ty * w + tx] )
+            return false;
+   return true;
+}
 
 
 float minB[NUMDIM], maxB[NUMDIM];    /*box */
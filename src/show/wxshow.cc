@@ -552,6 +552,11 @@ void BasicGLPane::mouseEvent(wxMouseEvent& event)
 void BasicGLPane::idle() {
   if(glutGetWindow() != window_id)
     glutSetWindow(window_id);
+
+  // show scans whose octrees have been finished in the meantime
+  if (publishLoadedOctrees() && haveToUpdate == 0) {
+    haveToUpdate = 1;
+  }
 	 
   /*
   static unsigned long start = GetCurrentTimeInMilliSec();
@@ -35,6 +35,11 @@ void ChunkAllocator::printSize() const
   cout << " wasted  " << wastedspace/(1024*1024.0) << " Mb " << endl;
 }
 
+unsigned long int ChunkAllocator::getSize() const
+{
+  return memsize;
+}
+
 unsigned char* ChunkAllocator::allocate(unsigned int size)
 {
   unsigned char* chunk;
@@ -87,6 +92,11 @@ void PackedChunkAllocator::printSize() const
   cout << "wasted  " << wastedspace/(1024*1024.0) << " Mb " << endl;
 }
 
+unsigned long int PackedChunkAllocator::getSize() const
+{
+  return memsize;
+}
+
 unsigned char* PackedChunkAllocator::allocate(unsigned int size)
 {
   unsigned char* chunk;
@@ -129,6 +139,11 @@ void SequentialAllocator::printSize() const
   cout << "Using " << m_index << " of " << m_size << " bytes." << endl;
 }
 
+unsigned long int SequentialAllocator::getSize() const
+{
+  return m_index;
+}
+
 unsigned char* SequentialAllocator::allocate(unsigned int size)
 {
   if(m_index + size > m_size) {
@@ -483,14 +483,12 @@ void BasicScan::saveBOctTree(std::string & filename)
                                 octtree_pointtype,
                                 true);
   } else { // without reduction, xyz + attribute points
-    float** pts = octtree_pointtype.createPointArray<float>(this);
-    unsigned int nrpts = size<DataXYZ>("xyz");
-    btree = new BOctTree<float>(pts,
-                                nrpts,
+    PointBuffer<float> pts(octtree_pointtype, this);
+    btree = new BOctTree<float>(pts.get(),
+                                pts.size(),
                                 octtree_voxelSize,
                                 octtree_pointtype,
                                 true);
-    for(unsigned int i = 0; i < nrpts; ++i) delete[] pts[i]; delete[] pts;
   }
 
   btree->serialize(filename);
@@ -521,14 +519,12 @@ void BasicScan::createOcttree()
                                 octtree_pointtype,
                                 true);
   } else { // without reduction, xyz + attribute points
-    float** pts = octtree_pointtype.createPointArray<float>(this);
-    unsigned int nrpts = size<DataXYZ>("xyz");
-    btree = new BOctTree<float>(pts,
-                                nrpts,
+    PointBuffer<float> pts(octtree_pointtype, this);
+    btree = new BOctTree<float>(pts.get(),
+                                pts.size(),
                                 octtree_voxelSize,
                                 octtree_pointtype,
                                 true);
-    for(unsigned int i = 0; i < nrpts; ++i) delete[] pts[i]; delete[] pts;
   }
 
   // save created octtree            
@@ -563,14 +559,12 @@ BOctTree<float>* BasicScan::convertScanToShowOcttree()
                                 octtree_pointtype,
                                 true);
   } else { // without reduction, xyz + attribute points
-    float** pts = octtree_pointtype.createPointArray<float>(this);
-    unsigned int nrpts = size<DataXYZ>("xyz");
-    btree = new BOctTree<float>(pts,
-                                nrpts,
+    PointBuffer<float> pts(octtree_pointtype, this);
+    btree = new BOctTree<float>(pts.get(),
+                                pts.size(),
                                 octtree_voxelSize,
                                 octtree_pointtype,
                                 true);
-    for(unsigned int i = 0; i < nrpts; ++i) delete[] pts[i]; delete[] pts;
   }
 
   // save created octtree            
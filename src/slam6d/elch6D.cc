@@ -39,6 +39,124 @@ using boost::graph_traits;
 #include "slam6d/globals.icc"
 #include "slam6d/elch6D.h"
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <iostream>
+using std::cout;
+using std::endl;
+using std::pair;
+using std::make_pair;
+using namespace NEWMAT;
+
+/**
+ * a cached edge covariance is recomputed once one of its scans has moved
+ * further than this fraction of the maximal match distance
+ */
+#define ELCH_COV_MAX_MOVE 0.1
+/** or has turned by more than this angle (rad) */
+#define ELCH_COV_MAX_TURN 0.005
+
+/**
+ * checks whether a scan has left the pose a covariance was computed for
+ */
+static bool pose_moved(const double *pose, Scan *scan, double max_move)
+{
+  const double *rPos = scan->get_rPos();
+  const double *rPosTheta = scan->get_rPosTheta();
+  if(sqr(rPos[0] - pose[0]) + sqr(rPos[1] - pose[1]) +
+     sqr(rPos[2] - pose[2]) > sqr(max_move)) {
+    return true;
+  }
+  for(int i = 0; i < 3; i++) {
+    if(fabs(rPosTheta[i] - pose[i + 3]) > ELCH_COV_MAX_TURN) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void store_pose(double *pose, Scan *scan)
+{
+  for(int i = 0; i < 3; i++) {
+    pose[i] = scan->get_rPos()[i];
+    pose[i + 3] = scan->get_rPosTheta()[i];
+  }
+}
+
+/**
+ * computes the inverse covariances of all edges of the graph, in the order
+ * of edges(g). The covariances of earlier loop closings are reused for all
+ * edges whose scans have not moved since, the remaining ones are computed
+ * in parallel.
+ *
+ * @param allScans all laser scans
+ * @param g graph for loop optimization
+ * @param C inverse covariance for each edge
+ */
+void elch6D::edge_covariances(const vector <Scan *> &allScans, graph_t &g,
+                              vector <Matrix> &C)
+{
+  double max_move = ELCH_COV_MAX_MOVE * sqrt(my_icp6D->get_max_dist_match2());
+
+  vector <pair <int, int> > scan_pairs;
+  graph_traits <graph_t>::edge_iterator ei, ei_end;
+  for(boost::tuples::tie(ei, ei_end) = edges(g); ei != ei_end; ei++) {
+    scan_pairs.push_back(make_pair((int)source(*ei, g), (int)target(*ei, g)));
+  }
+  C.resize(scan_pairs.size());
+
+  vector <int> missing;
+  for(unsigned int i = 0; i < scan_pairs.size(); i++) {
+    std::map <pair <int, int>, CachedEdge>::iterator it =
+      cov_cache.find(scan_pairs[i]);
+    if(it != cov_cache.end() &&
+       !pose_moved(it->second.pose_from, allScans[scan_pairs[i].first], max_move) &&
+       !pose_moved(it->second.pose_to, allScans[scan_pairs[i].second], max_move)) {
+      C[i] = it->second.C;
+    } else {
+      missing.push_back(i);
+    }
+  }
+
+  if(!quiet) {
+    cout << "ELCH: computing " << missing.size() << " of "
+         << scan_pairs.size() << " edge covariances" << endl;
+  }
+
+  // search trees are created on first use, not by several threads at once
+  for(unsigned int i = 0; i < missing.size(); i++) {
+    allScans[scan_pairs[missing[i]].first]->getSearchTree();
+  }
+
+  // covarianceEuler uses the thread number as search tree slot
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int i = 0; i < (int)missing.size(); i++) {
+    int e = missing[i];
+    edge_covariance(allScans[scan_pairs[e].first],
+                    allScans[scan_pairs[e].second],
+                    C[e]);
+  }
+
+  for(unsigned int i = 0; i < missing.size(); i++) {
+    int e = missing[i];
+    CachedEdge &cached = cov_cache[scan_pairs[e]];
+    cached.C = C[e];
+    store_pose(cached.pose_from, allScans[scan_pairs[e].first]);
+    store_pose(cached.pose_to, allScans[scan_pairs[e].second]);
+  }
+}
+
 /*
 void printout(graph_t &g, vector<Vertex> &p, vector<int> &d, double *weights)
 {
@@ -30,6 +30,21 @@ using std::ofstream;
 using boost::graph_traits;
 using namespace NEWMAT;
 
+/**
+ * inverse covariance of the pose difference of two scans, see lum6DEuler::covarianceEuler
+ */
+void elch6Deuler::edge_covariance(Scan *first, Scan *second, Matrix &C)
+{
+  C.ReSize(6, 6);
+  lum6DEuler::covarianceEuler(first,
+                              second,
+                              my_icp6D->get_nns_method(),
+                              my_icp6D->get_rnd(),
+                              my_icp6D->get_max_dist_match2(),
+                              &C);
+  C = C.i();
+}
+
 /**
  * ELCH loop closing function using Euler angles
  * matches first and last scan of a loop with ICP
@@ -47,20 +62,15 @@ void elch6Deuler::close_loop(const vector <Scan *> &allScans,
 {
   int n = num_vertices(g);
   graph_t grb[6];
-  Matrix C(6, 6);
+  vector <Matrix> C;
+  edge_covariances(allScans, g, C);
   graph_traits <graph_t>::edge_iterator ei, ei_end;
-  for(boost::tuples::tie(ei, ei_end) = edges(g); ei != ei_end; ei++) {
+  int e = 0;
+  for(boost::tuples::tie(ei, ei_end) = edges(g); ei != ei_end; ei++, e++) {
     int from = source(*ei, g);
     int to = target(*ei, g);
-    lum6DEuler::covarianceEuler(allScans[from],
-                                allScans[to],
-                                my_icp6D->get_nns_method(),
-                                my_icp6D->get_rnd(),
-                                my_icp6D->get_max_dist_match2(),
-                                &C);
-    C = C.i();
     for(int j = 0; j < 6; j++) {
-      add_edge(from, to, fabs(C(j + 1, j + 1)), grb[j]);
+      add_edge(from, to, fabs(C[e](j + 1, j + 1)), grb[j]);
     }
   }
 
@@ -31,6 +31,21 @@ using std::ofstream;
 #include <boost/graph/graph_traits.hpp>
 using boost::graph_traits;
 using namespace NEWMAT;
+
+/**
+ * inverse covariance of the pose difference of two scans, see lum6DQuat::covarianceQuat
+ */
+void elch6Dslerp::edge_covariance(Scan *first, Scan *second, Matrix &C)
+{
+  C.ReSize(7, 7);
+  lum6DQuat::covarianceQuat(first,
+                            second,
+                            my_icp6D->get_nns_method(),
+                            my_icp6D->get_rnd(),
+                            my_icp6D->get_max_dist_match2(),
+                            &C);
+  C = C.i();
+}
 /**
  * ELCH loop closing function using SLERP
  * matches first and last scan of a loop with ICP
@@ -48,40 +63,20 @@ void elch6Dslerp::close_loop(const vector <Scan *> &allScans,
 {
   int n = num_vertices(g);
   graph_t grb[4];
-  graph_traits <graph_t>::edge_iterator ei = edges(g).first;
-  int num_arcs = num_edges(g);
-  int li = 0;
-#ifdef _OPENMP
-#pragma omp parallel for firstprivate(li, ei)
-#endif
-  for(int i = 0; i < num_arcs; i++) {
-    for(;i > li; li++, ei++) ;
-    for(;i < li; li--, ei--) ;
-    Matrix C(7, 7);
+  vector <Matrix> C;
+  edge_covariances(allScans, g, C);
+  graph_traits <graph_t>::edge_iterator ei, ei_end;
+  int e = 0;
+  for(boost::tuples::tie(ei, ei_end) = edges(g); ei != ei_end; ei++, e++) {
     int from = source(*ei, g);
     int to = target(*ei, g);
-    lum6DQuat::covarianceQuat(allScans[from],
-                              allScans[to],
-                              my_icp6D->get_nns_method(),
-                              my_icp6D->get_rnd(),
-                              my_icp6D->get_max_dist_match2(),
-                              &C);
-    C = C.i();
     for(int j = 0; j < 3; j++) {
-#ifdef _OPENMP
-#pragma omp critical
-#endif
-      add_edge(from, to, fabs(C(j + 1, j + 1)), grb[j]);
+      add_edge(from, to, fabs(C[e](j + 1, j + 1)), grb[j]);
     }
-#ifdef _OPENMP
-#pragma omp critical
-#endif
     add_edge(from, to,
-             fabs(C(4, 4)) + fabs(C(5, 5)) +
-             fabs(C(6, 6)) + fabs(C(7, 7)),
+             fabs(C[e](4, 4)) + fabs(C[e](5, 5)) +
+             fabs(C[e](6, 6)) + fabs(C[e](7, 7)),
              grb[3]);
-    li++;
-    ei++;
   }
 
   double *weights[4];
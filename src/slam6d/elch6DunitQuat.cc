@@ -32,6 +32,21 @@ using std::ofstream;
 using boost::graph_traits;
 using namespace NEWMAT;
 
+/**
+ * inverse covariance of the pose difference of two scans, see lum6DQuat::covarianceQuat
+ */
+void elch6DunitQuat::edge_covariance(Scan *first, Scan *second, Matrix &C)
+{
+  C.ReSize(7, 7);
+  lum6DQuat::covarianceQuat(first,
+                            second,
+                            my_icp6D->get_nns_method(),
+                            my_icp6D->get_rnd(),
+                            my_icp6D->get_max_dist_match2(),
+                            &C);
+  C = C.i();
+}
+
 /**
  * ELCH loop closing function using unit Quaternion
  * matches first and last scan of a loop with ICP
@@ -49,22 +64,19 @@ void elch6DunitQuat::close_loop(const vector <Scan *> &allScans,
 {
   int n = num_vertices(g);
   graph_t grb[4];
-  Matrix C(7, 7);
+  vector <Matrix> C;
+  edge_covariances(allScans, g, C);
   graph_traits <graph_t>::edge_iterator ei, ei_end;
-  for(boost::tuples::tie(ei, ei_end) = edges(g); ei != ei_end; ei++) {
+  int e = 0;
+  for(boost::tuples::tie(ei, ei_end) = edges(g); ei != ei_end; ei++, e++) {
     int from = source(*ei, g);
     int to = target(*ei, g);
-    lum6DQuat::covarianceQuat(allScans[from], allScans[to],
-                              my_icp6D->get_nns_method(),
-                              my_icp6D->get_rnd(),
-                              my_icp6D->get_max_dist_match2(),
-                              &C);
-    C = C.i();
     for(int j = 0; j < 3; j++) {
-      add_edge(from, to, abs(C(j + 1, j + 1)), grb[j]);
+      add_edge(from, to, abs(C[e](j + 1, j + 1)), grb[j]);
     }
     add_edge(from, to,
-             abs(C(4, 4)) + abs(C(5, 5)) + abs(C(6, 6)) + abs(C(7, 7)), grb[3]);
+             abs(C[e](4, 4)) + abs(C[e](5, 5)) + abs(C[e](6, 6)) + abs(C[e](7, 7)),
+             grb[3]);
   }
 
   double *weights[4];
@@ -63,6 +63,9 @@ void usage(char* prog)
       << "   " << prog << " [options] directory" << endl << endl;
   cout << bold << "OPTIONS" << normal << endl
 
+      << endl
+      << bold << "  -b, --binary" << normal << endl
+      << "         export the points in binary PLY format to \"points.ply\"" << endl
       << endl
       << bold << "  -e" << normal << " NR, " << bold << "--end=" << normal << "NR" << endl
       << "         end after scan NR" << endl
@@ -146,7 +149,8 @@ void usage(char* prog)
  */
 int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
             int &start, int &end, int &maxDist, int &minDist, bool &extrapolate_pose,
-            bool &use_xyz, bool &use_reflectance, bool &use_color, int &octree, IOType &type, string& customFilter, double &scaleFac)
+            bool &use_xyz, bool &use_reflectance, bool &use_color, int &octree, IOType &type, string& customFilter, double &scaleFac,
+            bool &binary)
 {
   int  c;
   // from unistd.h:
@@ -168,11 +172,12 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     { "xyz",             no_argument,         0,  'x' },
     { "scale",           required_argument,   0,  'y' },
     { "customFilter",    required_argument,   0,  'u' },
+    { "binary",          no_argument,         0,  'b' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
   cout << endl;
-  while ((c = getopt_long(argc, argv, "f:s:e:r:O:Rm:y:M:u:pxc", longopts, NULL)) != -1)
+  while ((c = getopt_long(argc, argv, "f:s:e:r:O:Rm:y:M:u:pxcb", longopts, NULL)) != -1)
     switch (c)
      {
      case 'r':
@@ -217,6 +222,9 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
        break;
      case 'u':
        customFilter = optarg;
+       break;
+     case 'b':
+       binary = true;
        break;
      case 'f':
     try {
@@ -334,9 +342,11 @@ int main(int argc, char **argv)
   bool customFilterActive = false;
   string customFilter;
   double scaleFac = 0.01;
+  bool binary = false;
 
   parseArgs(argc, argv, dir, red, rand, start, end,
-      maxDist, minDist, eP, use_xyz, use_reflectance, use_color, octree, iotype, customFilter, scaleFac);
+      maxDist, minDist, eP, use_xyz, use_reflectance, use_color, octree, iotype, customFilter, scaleFac,
+      binary);
 
 
   rangeFilterActive = minDist > 0 || maxDist > 0;
@@ -452,16 +462,25 @@ int main(int argc, char **argv)
   }
   readFrames(dir, start, end, eP);
   
- cout << "Export all 3D Points to file \"points.pts\"" << endl;
+ string ptsFileName = binary ? "points.ply" : "points.pts";
+ cout << "Export all 3D Points to file \"" << ptsFileName << "\"" << endl;
  cout << "Export all 6DoF poses to file \"positions.txt\"" << endl;
  cout << "Export all 6DoF matrices to file \"poses.txt\"" << endl;
- ofstream redptsout("points.pts");
+ ofstream redptsout(ptsFileName.c_str(), binary ? ios::out | ios::binary : ios::out);
  ofstream posesout("positions.txt");
  ofstream matricesout("poses.txt");
+
+  string red_string = red > 0 ? " reduced" : "";
+  ExportWriter::Attributes attributes = use_reflectance ? ExportWriter::REFLECTANCE :
+      (use_color ? ExportWriter::COLOR : ExportWriter::NONE);
+  ExportWriter ptswriter(redptsout, attributes, use_xyz, scaleFac, binary);
+
+  if(binary) {
+    ptswriter.writeHeader();
+  }
   
   for(unsigned int i = 0; i < Scan::allScans.size(); i++) {
     Scan *source = Scan::allScans[i];
-    string red_string = red > 0 ? " reduced" : "";
       
     DataXYZ xyz  = source->get("xyz" + red_string);
     
@@ -473,11 +492,7 @@ int main(int argc, char **argv)
       if (!(types & PointType::USE_REFLECTANCE)) {
         for(unsigned int i = 0; i < xyz.size(); i++) xyz_reflectance[i] = 255;
       }
-      if(use_xyz) {
-        write_xyzr(xyz, xyz_reflectance, redptsout, scaleFac);
-      } else {
-        write_uosr(xyz, xyz_reflectance, redptsout);
-      }
+      ptswriter.write(xyz, &xyz_reflectance);
       
     } else if(use_color) {
       string data_string = red > 0 ? "color reduced" : "rgb";
@@ -492,18 +507,10 @@ int main(int argc, char **argv)
             xyz_color[i][2] = 0;
         }
       }
-      if(use_xyz) {
-        write_xyz_rgb(xyz, xyz_color, redptsout, scaleFac);
-      } else {
-        write_uos_rgb(xyz, xyz_color, redptsout);
-      }
+      ptswriter.write(xyz, 0, &xyz_color);
 
     } else {
-      if(use_xyz) {
-        write_xyz(xyz, redptsout, scaleFac);
-      } else {
-        write_uos(xyz, redptsout);
-      }
+      ptswriter.write(xyz);
     
     }
     if(use_xyz) {
@@ -515,7 +522,8 @@ int main(int argc, char **argv)
     }
 
   }
-   
+
+  ptswriter.flush();
   redptsout.close();
   redptsout.clear();
   posesout.close();
@@ -19,11 +19,61 @@
 #include "slam6d/fbr/panorama.h"
 #include <limits.h>
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 namespace fbr
 {
 
+  extended_map::extended_map()
+  {
+    width_ = 0;
+    height_ = 0;
+  }
+
+  void extended_map::clear()
+  {
+    width_ = 0;
+    height_ = 0;
+    vector<unsigned int>().swap(index_);
+    vector<cv::Vec3f>().swap(points_);
+  }
+
+  void extended_map::build(unsigned int width, unsigned int height, const vector<unsigned int>& pixels, const vector<cv::Vec3f>& points)
+  {
+    width_ = width;
+    height_ = height;
+    //count the points of each pixel
+    index_.assign(width * height + 1, 0);
+    for(unsigned int i = 0; i < pixels.size(); i++)
+      index_[pixels[i] + 1]++;
+    for(unsigned int p = 0; p < width * height; p++)
+      index_[p + 1] += index_[p];
+    //copy the points to their pixels
+    points_.resize(points.size());
+    vector<unsigned int> next(index_.begin(), index_.end() - 1);
+    for(unsigned int i = 0; i < pixels.size(); i++)
+      points_[next[pixels[i]]++] = points[i];
+  }
+
+  /**
+   * The rectilinear, pannini, stereographic and azimuthal projections
+   * store intermediate results in the projection class.
+   */
+  static bool isReentrant(projection_method method)
+  {
+    return method != RECTILINEAR && method != PANNINI && method != STEREOGRAPHIC && method != AZIMUTHAL;
+  }
+
   panorama::panorama()
   {
     init(3600, 1000, EQUIRECTANGULAR, 1, 0, FARTHEST);
@@ -113,6 +163,8 @@ namespace fbr
     iRange_.release();
     iColor_.release();
     extendedIMap_.clear();
+    vector<unsigned int>().swap(extendedPixels_);
+    vector<cv::Vec3f>().swap(extendedPoints_);
   }
 
   void panorama::createPanorama(cv::Mat scan) 
@@ -125,21 +177,37 @@ namespace fbr
   {
     initMap();      	
 
-    cv::MatIterator_<cv::Vec4f> it, end; 
+    int nPoints = scan.total();
+    cv::MatIterator_<cv::Vec4f> begin = scan.begin<cv::Vec4f>();
     cv::MatIterator_<cv::Vec3f> itColor;
     if(color.empty() == false)
       {
 	itColor = color.begin<cv::Vec3f>();
       }
 
-    for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it)
+    //project all points first, each point on its own
+    vector<int> xs(nPoints), ys(nPoints);
+    vector<double> ranges(nPoints);
+    bool reentrant = isReentrant(projection_->getProjectionMethod());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(reentrant)
+#endif
+    for(int i = 0; i < nPoints; i++)
       {
-	int x, y;
-	double range;
-	projection_->calcPanoramaPositionForAPoint(x, y, it, range);
+	projection_->calcPanoramaPositionForAPoint(xs[i], ys[i], begin + i, ranges[i]);
+      }
+
+    if(mapMethod_ == EXTENDED)
+      {
+	extendedPixels_.reserve(nPoints);
+	extendedPoints_.reserve(nPoints);
+      }
 
+    cv::MatIterator_<cv::Vec4f> it = begin;
+    for(int i = 0; i < nPoints; i++, ++it)
+      {
 	//create the iReflectance iRange iolor and map
-	map(x, y, it, itColor, range);
+	map(xs[i], ys[i], it, itColor, ranges[i]);
 
 	//increase the color
 	if(color.empty() == false)
@@ -147,6 +215,9 @@ namespace fbr
 	    ++itColor;
 	  }  
       }
+
+    if(mapMethod_ == EXTENDED)
+      buildExtendedMap();
   }
   
   void panorama::createPanoramaFromOctree(PointType pointtype, scanner_type sType, double minReflectance, double maxReflectance)
@@ -368,8 +439,11 @@ namespace fbr
     return iMap_;
   }
 
-  vector<vector<vector<cv::Vec3f> > > panorama::getExtendedMap()
+  const extended_map& panorama::getExtendedMap()
   {
+    //points added from an octree are sorted on first access
+    if(extendedPoints_.empty() == false)
+      buildExtendedMap();
     return extendedIMap_;
   }
 
@@ -387,9 +461,9 @@ namespace fbr
       }
     else if(mapMethod_ == EXTENDED)
       {
-	extendedIMap_.resize(height);
-	for (unsigned int i = 0; i < height; i++)
-	  extendedIMap_[i].resize(width);
+	extendedIMap_.clear();
+	extendedPixels_.clear();
+	extendedPoints_.clear();
       }
     //init the compresed map
     else if(mapMethod_ == FULL)
@@ -415,6 +489,13 @@ namespace fbr
       }
   }
 
+  void panorama::buildExtendedMap()
+  {
+    extendedIMap_.build(projection_->getProjectionWidth(), projection_->getProjectionHeight(), extendedPixels_, extendedPoints_);
+    vector<unsigned int>().swap(extendedPixels_);
+    vector<cv::Vec3f>().swap(extendedPoints_);
+  }
+
   void panorama::map(int x, int y, cv::MatIterator_<cv::Vec4f> it, cv::MatIterator_<cv::Vec3f> itColor, double range)
   {    
     if (maxRange_ < (float)range)
@@ -459,7 +540,8 @@ namespace fbr
 	point[0] = (*it)[0]; // x
 	point[1] = (*it)[1]; // y
 	point[2] = (*it)[2]; // z
-	extendedIMap_[y][x].push_back(point);
+	extendedPixels_.push_back(y * projection_->getProjectionWidth() + x);
+	extendedPoints_.push_back(point);
       }
     //compressed map
     else if(mapMethod_ == FULL)
@@ -18,6 +18,16 @@
 
 #include "slam6d/fbr/projection.h"
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 namespace fbr
@@ -328,9 +338,17 @@ namespace fbr
 	reflectanceImage = cv::Scalar::all(0);
       }
 
-    for (int row = 0; row < rangeImage.size().height; ++row) 
+    //recover the rows in parallel, each into its own part of the buffer
+    int rows = rangeImage.size().height, cols = rangeImage.size().width;
+    vector<cv::Vec4f> points((size_t)rows * cols);
+    vector<int> counts(rows, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int row = 0; row < rows; ++row) 
       {
-	for (int col = 0; col < rangeImage.size().width; ++col) 
+	cv::Vec4f *out = &points[(size_t)row * cols];
+	for (int col = 0; col < cols; ++col) 
 	  {
 	    double range,reflectance, x, y, z;
 	    range = rangeImage.at<float>(row, col);
@@ -342,9 +360,17 @@ namespace fbr
 	      {
 		continue;
 	      }
-	    reducedPoints.push_back(cv::Vec4f(x, y, z, reflectance));
+	    out[counts[row]++] = cv::Vec4f(x, y, z, reflectance);
 	  }
       }
+
+    size_t total = reducedPoints.size();
+    for (int row = 0; row < rows; ++row)
+      total += counts[row];
+    reducedPoints.reserve(total);
+    for (int row = 0; row < rows; ++row)
+      reducedPoints.insert(reducedPoints.end(), points.begin() + (size_t)row * cols,
+			   points.begin() + (size_t)row * cols + counts[row]);
   }
 
   void projection::calcPointFromPanoramaPosition(double& x, double& y, double& z, int row, int col, double range)
@@ -9,6 +9,16 @@
 
 #include "slam6d/fbr/registration.h"
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 namespace fbr{
@@ -35,7 +45,7 @@ namespace fbr{
       bestAlign[i] = 0;
   }
   
-  int registration::getCoord(vector<cv::KeyPoint> fKeypoints, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches, cv::Mat fPMap, cv::Mat sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct){
+  int registration::getCoord(const vector<cv::KeyPoint>& fKeypoints, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches, const cv::Mat& fPMap, const cv::Mat& sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct){
     int x, y;
     y = fKeypoints[matches[idx].queryIdx].pt.x;
     x = fKeypoints[matches[idx].queryIdx].pt.y;
@@ -88,68 +98,62 @@ namespace fbr{
   }
 
 
-  int registration::findAlign(unsigned int i, unsigned int j, unsigned int k, cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches){
-    cv::Point3f c1q, c2q, c3q, c1t, c2t, c3t;
+  /**
+   * squared distance of two points stored as three doubles
+   */
+  static inline double sqrDist(const double *a, const double *b){
+    return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+  }
+
+  int registration::findAlign(unsigned int i, unsigned int j, unsigned int k, const double* fCoord, const double* sCoord, const unsigned char* valid, unsigned int nr){
     if(i == j || i == k || j == k)
       return 0;
-    //get the coordinates
-    if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, i, c1q, c1t) == 0)
-      return 0;
-    if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, j, c2q, c2t) == 0)
-      return 0;
-    if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, k, c3q, c3t) == 0)
+    if(!valid[i] || !valid[j] || !valid[k])
       return 0;
+    const double *c1qd = fCoord + 3*i, *c2qd = fCoord + 3*j, *c3qd = fCoord + 3*k;
+    const double *c1td = sCoord + 3*i, *c2td = sCoord + 3*j, *c3td = sCoord + 3*k;
     //check for min distance
-    if(norm(c1q - c2q) < minDistance || norm(c1q - c3q) < minDistance || norm(c2q - c3q) < minDistance || norm(c1t - c2t) < minDistance || norm(c1t - c3t) < minDistance || norm(c2t - c3t) < minDistance)
+    double minSqr = minDistance * minDistance;
+    if(sqrDist(c1qd, c2qd) < minSqr || sqrDist(c1qd, c3qd) < minSqr || sqrDist(c2qd, c3qd) < minSqr || sqrDist(c1td, c2td) < minSqr || sqrDist(c1td, c3td) < minSqr || sqrDist(c2td, c3td) < minSqr)
       return 0;
     //calculate the centroids
-    cv::Point3f centroidq, centroidt;
-    centroidq = (c1q + c2q + c3q);
-    centroidt = (c1t + c2t + c3t);
-    centroidq.x = centroidq.x / 3;
-    centroidq.y = centroidq.y / 3;
-    centroidq.z = centroidq.z / 3;
-    centroidt.x = centroidt.x / 3;
-    centroidt.y = centroidt.y / 3;
-    centroidt.z = centroidt.z / 3;
-    //put each point into double array
-    double c1qd[3], c2qd[3], c3qd[3], c1td[3], c2td[3], c3td[3];
-    cv::Point3f temp;
-    pointToArray(c1q, c1qd);
-    pointToArray(c2q, c2qd);
-    pointToArray(c3q, c3qd);
-    pointToArray(c1t, c1td);
-    pointToArray(c2t, c2td);
-    pointToArray(c3t, c3td);
+    double centroidqd[3], centroidtd[3];
+    for(int c = 0; c < 3; c++){
+      centroidqd[c] = (c1qd[c] + c2qd[c] + c3qd[c]) / 3;
+      centroidtd[c] = (c1td[c] + c2td[c] + c3td[c]) / 3;
+    }
     //create PtPair and calc the align with icp6D_QUAT
     vector<PtPair> pairs;
-    pairs.push_back(PtPair(c1qd, c1td));
-    pairs.push_back(PtPair(c2qd, c2td));
-    pairs.push_back(PtPair(c3qd, c3td));
+    pairs.push_back(PtPair((double*)c1qd, (double*)c1td));
+    pairs.push_back(PtPair((double*)c2qd, (double*)c2td));
+    pairs.push_back(PtPair((double*)c3qd, (double*)c3td));
     double align[16];
-    double centroidqd[3], centroidtd[3];
-    pointToArray(centroidq, centroidqd);
-    pointToArray(centroidt, centroidtd);
     icp6D_QUAT q(true);
     q.Align(pairs, align, centroidqd, centroidtd);
     //transform the matches with align if the error is less than minerror
     double iError = 0;
     unsigned int eIdx = 0;
-    for(unsigned int p = 0; p < matches.size(); p++){
-      if(p == i || p == j || p == k)
-	continue;
-      cv::Point3f cq, ct, ct_trans;
-      if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, p, cq, ct) == 0)
+    double minSqrError = minError * minError;
+    for(unsigned int p = 0; p < nr; p++){
+      if(p == i || p == j || p == k || !valid[p])
 	continue;
-      ct_trans = coordTransform(ct, align);
-      if(norm(ct_trans - cq) < minError){
-	iError += norm(ct_trans - cq);
+      const double *cq = fCoord + 3*p, *ct = sCoord + 3*p;
+      double ct_trans[3];
+      ct_trans[0] = align[0]*ct[0] + align[4]*ct[1] + align[8]*ct[2] + align[12];
+      ct_trans[1] = align[1]*ct[0] + align[5]*ct[1] + align[9]*ct[2] + align[13];
+      ct_trans[2] = align[2]*ct[0] + align[6]*ct[1] + align[10]*ct[2] + align[14];
+      double d = sqrDist(ct_trans, cq);
+      if(d < minSqrError){
+	iError += sqrt(d);
 	eIdx++;
       }
     }
     //check for mininlier and find the best align
     if(eIdx > minInlier){ 
       double aError = iError / eIdx;
+#ifdef _OPENMP
+#pragma omp critical (registration_best)
+#endif
       if(aError - iInfluence*eIdx < bestError - iInfluence*bestErrorIndex){
 	bestError = aError;
 	bestErrorIndex = eIdx;
@@ -160,26 +164,83 @@ namespace fbr{
     return 1;
   }
   
-  void registration::findRegistration(cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches){
+  void registration::findRegistration(const cv::Mat& fPMap, const vector<cv::KeyPoint>& fKeypoints, const cv::Mat& sPMap, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches){
+    unsigned int nr = matches.size();
+    if(nr == 0)
+      return;
+    //look up the 3D coordinates of all matches once
+    vector<double> fCoord(3*nr), sCoord(3*nr);
+    vector<unsigned char> valid(nr);
+    unsigned int nrValid = 0;
+    for(unsigned int p = 0; p < nr; p++){
+      cv::Point3f cq, ct;
+      valid[p] = getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, p, cq, ct);
+      if(valid[p]){
+	pointToArray(cq, &fCoord[3*p]);
+	pointToArray(ct, &sCoord[3*p]);
+	nrValid++;
+      }
+    }
+    if(nrValid < 3)
+      return;
     //go through all matches
     if(rMethod == ALL){
-      for(unsigned int i = 0; i < matches.size(); i++)
-	for(unsigned int j = 0; j < matches.size(); j++)
-	  for(unsigned int k = 0; k < matches.size(); k++){
-	    findAlign(i, j, k, fPMap, fKeypoints, sPMap, sKeypoints, matches);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+      for(int i = 0; i < (int)nr; i++)
+	for(unsigned int j = 0; j < nr; j++)
+	  for(unsigned int k = 0; k < nr; k++){
+	    findAlign(i, j, k, &fCoord[0], &sCoord[0], &valid[0], nr);
 	  }
     }
     //RANSAC
-    if(rMethod == RANSAC)
-      for(int r = 0; r < RANSACITR; r++){
-	if((r % (RANSACITR/10)) == 0){
-	  cout<<"RANSAC iteration: "<<(r / (RANSACITR/10) + 1) * 10 <<"%"<<endl;
+    if(rMethod == RANSAC){
+      //hypotheses evaluated between two updates of the needed iterations
+      const int batch = RANSACITR / 100;
+      int needed = RANSACITR;
+      int r = 0;
+      while(r < needed){
+	int n = min(batch, needed - r);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+	  unsigned int seed;
+#ifdef _OPENMP
+#pragma omp critical (registration_seed)
+#endif
+	  seed = rand();
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+	  for(int h = 0; h < n; h++){
+	    unsigned int idx[3];
+	    for(int c = 0; c < 3; c++){
+	      seed = seed * 1103515245u + 12345u;
+	      idx[c] = (seed >> 8) % nr;
+	    }
+	    findAlign(idx[0], idx[1], idx[2], &fCoord[0], &sCoord[0], &valid[0], nr);
+	  }
+	}
+	if(((r + n) / (RANSACITR/10)) != (r / (RANSACITR/10)))
+	  cout<<"RANSAC iteration: "<<((r + n) / (RANSACITR/10)) * 10 <<"%"<<endl;
+	r += n;
+	//stop as soon as an all inlier sample was drawn with RANSACCONFIDENCE
+	double w = (double)bestErrorIndex / nrValid;
+	if(w > 0){
+	  double good = w * w * w;
+	  if(good >= 1)
+	    needed = r;
+	  else{
+	    double it = log(1 - RANSACCONFIDENCE) / log(1 - good);
+	    if(it < needed)
+	      needed = (int)ceil(it);
+	  }
 	}
-	unsigned int i = rand() % matches.size();
-	unsigned int j = rand() % matches.size();
-	unsigned int k = rand() % matches.size();
-	findAlign(i, j, k, fPMap, fKeypoints, sPMap, sKeypoints, matches);
       }
+      cout<<"RANSAC finished after "<<r<<" iterations"<<endl;
+    }
   }
 
   double registration::getMinDistance(){
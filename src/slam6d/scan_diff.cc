@@ -20,6 +20,9 @@
  * the first scan that do NOT have a corresponding point in the second scan 
  * within a distance of less than NR units.
  * Difference scans will be written to 'dir/diff'
+ * With -p all scans between START and END are compared pairwise, each one
+ * with its successor, and the differences in both directions are written
+ * to binary files 'dir/diff/scanAAA_BBB.diff'.
  * ATTENTION: All scans between START and END will be loaded!
  * @author Dorit Borrmann. Automation Group, Jacobs University Bremen gGmbH, Germany. 
  */
@@ -40,11 +43,15 @@ using std::endl;
 using std::ofstream;
 using std::ifstream;
 #include <errno.h>
+#include <math.h>
+#include <string.h>
 #include <vector>
+#include <limits>
 
 #include "slam6d/globals.icc"
 #include "slam6d/io_utils.h"
 #include "slam6d/scan.h"
+#include "slam6d/kd.h"
 
 #include "scanserver/clientInterface.h"
 
@@ -70,6 +77,22 @@ using std::ifstream;
   #include <dlfcn.h>
 #endif
 
+/** Magic number at the start of a pairwise difference file */
+#define DIFF_MAGIC "3DTKDIF"
+
+/**
+ * Header of a pairwise difference file. It is followed by nrRemoved
+ * points of the first scan that have no point of the second scan within
+ * dist, then by nrAdded points of the second scan without a point of the
+ * first one. Each point is four doubles: x, y and z in global coordinates
+ * and the distance to the closest point of the other scan.
+ */
+struct diffheader {
+  char magic[8];
+  double dist;
+  long long nrRemoved;
+  long long nrAdded;
+};
 
 /**
  * Explains the usage of this program's command line parameters
@@ -107,6 +130,13 @@ void usage(char* prog)
 	  << endl
 	  << bold << "  -d" << normal << " NR, " << bold << "--dist=" << normal << "NR" << endl
 	  << "         write all points that have no corresponding point closer than NR 'units'" << endl
+	  << "         (a plain distance, not squared, in both modes)" << endl
+	  << endl
+	  << bold << "  -p, --pairwise" << normal << endl
+	  << "         compare every scan from START to END with its successor, in both" << endl
+	  << "         directions, and write the differences with the distance of each" << endl
+	  << "         point in binary form to 'dir/diff/scanAAA_BBB.diff'" << endl
+	  << endl
 	  << bold << "  -S, --scanserver" << normal << endl
 	  << "         Use the scanserver as an input method and handling of scan data" << endl
     << endl << endl;
@@ -129,11 +159,12 @@ void usage(char* prog)
  * @param dist the maximal distance for a point pair
  * @param type the scan format
  * @param desc true if start is greater than end
+ * @param pairwise compare all consecutive scans in both directions
  * @return 0, if the parsing was successful. 1 otherwise
  */
 int parseArgs(int argc, char **argv, string &dir, 
 		    int &start, int &end, int &maxDist, int &minDist, double &dist, 
-		    IOType &type, bool &desc, bool scanserver)
+		    IOType &type, bool &desc, bool &pairwise, bool scanserver)
 {
   int  c;
   // from unistd.h:
@@ -153,11 +184,12 @@ int parseArgs(int argc, char **argv, string &dir,
     { "end",             required_argument,   0,  'e' },
     { "dist",            required_argument,   0,  'd' },
     { "scanserver",      no_argument,         0,  'S' },
+    { "pairwise",        no_argument,         0,  'p' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
   cout << endl;
-  while ((c = getopt_long(argc, argv, "f:d:s:e:m:M:", longopts, NULL)) != -1)
+  while ((c = getopt_long(argc, argv, "f:d:s:e:m:M:p", longopts, NULL)) != -1)
     switch (c)
 	 {
 	 case 'd':
@@ -185,6 +217,9 @@ int parseArgs(int argc, char **argv, string &dir,
 	 case 'M':
 	   minDist = atoi(optarg);
 	   break;
+	 case 'p':
+	   pairwise = true;
+	   break;
 	 case '?':
 	   usage(argv[0]);
 	   return 1;
@@ -223,6 +258,142 @@ int parseArgs(int argc, char **argv, string &dir,
 }
 
 
+/**
+ * Reads the final pose of a scan from its .frames file.
+ * @param dir the directory of the scans
+ * @param identifier the identifier of the scan
+ * @param matrix the pose (4x4 matrix and color)
+ * @return true if the file could be read
+ */
+bool readFrames(const string &dir, const string &identifier, double matrix[17])
+{
+  string framesFileName = dir + "scan" + identifier + ".frames";
+  ifstream frames_in(framesFileName.c_str());
+  if (!frames_in.good()) return false;
+  while (frames_in.good()) {
+    for (unsigned int i = 0; i < 17; frames_in >> matrix[i++]);
+  }
+  return true;
+}
+
+/**
+ * Finds all points of source without a point of target closer than dist.
+ * The queries are spread over all threads, each one using its own slot of
+ * the search tree. Only for the points that are found the unbounded
+ * distance to the closest point of target is computed.
+ * @param result the points, four doubles each (x, y, z, distance)
+ * @param source the points to be tested
+ * @param target the search tree of the other scan, NULL if it is empty
+ * @param dist the maximal distance for a point pair
+ */
+void getNoPairsParallel(vector<double> &result, DataXYZ &source,
+                        const KDtree *target, double dist)
+{
+  int n = source.size();
+  double dist2 = sqr(dist);
+  // distance of every point to the other scan, -1 if it has a partner
+  vector<double> distance(n, -1.0);
+
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+  for (int i = 0; i < n; i++) {
+#ifdef _OPENMP
+    int thread_num = omp_get_thread_num();
+#else
+    int thread_num = 0;
+#endif
+    if (target == 0) {
+      distance[i] = std::numeric_limits<double>::infinity();
+      continue;
+    }
+    double p[3] = { source[i][0], source[i][1], source[i][2] };
+    if (target->FindClosest(p, dist2, thread_num)) continue;
+    double *closest = target->FindClosest(p, std::numeric_limits<double>::max(), thread_num);
+    distance[i] = sqrt(Dist2(p, closest));
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (distance[i] < 0.0) continue;
+    result.push_back(source[i][0]);
+    result.push_back(source[i][1]);
+    result.push_back(source[i][2]);
+    result.push_back(distance[i]);
+  }
+}
+
+/**
+ * Compares every loaded scan with its successor. The points of all scans
+ * are transformed with the poses of their .frames files and every scan
+ * gets a single search tree, which is used for both of its neighbours.
+ * @param dir the directory of the scans
+ * @param dist the maximal distance for a point pair
+ */
+void pairwiseDiff(const string &dir, double dist)
+{
+  unsigned int nrScans = Scan::allScans.size();
+  vector<DataXYZ*> xyz(nrScans);
+  vector<KDtree*> trees(nrScans, (KDtree*)0);
+
+  for (unsigned int i = 0; i < nrScans; i++) {
+    Scan *scan = Scan::allScans[i];
+    double inMatrix[17];
+    if (!readFrames(dir, scan->getIdentifier(), inMatrix)) {
+      cerr << "Couldn't read frames " << scan->getIdentifier() << endl;
+      exit(1);
+    }
+    scan->transform(inMatrix, Scan::INVALID);
+    xyz[i] = new DataXYZ(scan->get("xyz reduced"));
+    cout << "Scan " << scan->getIdentifier() << " with " << xyz[i]->size() << " points" << endl;
+  }
+
+  // the trees are independent of each other
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < (int)nrScans; i++) {
+    if (xyz[i]->size() == 0) continue;
+    trees[i] = new KDtree(PointerArray<double>(*xyz[i]).get(), xyz[i]->size());
+  }
+
+  for (unsigned int i = 0; i + 1 < nrScans; i++) {
+    vector<double> removed, added;
+    getNoPairsParallel(removed, *xyz[i], trees[i+1], dist);
+    getNoPairsParallel(added, *xyz[i+1], trees[i], dist);
+
+    string diffFileName = dir + "diff/scan" + Scan::allScans[i]->getIdentifier()
+      + "_" + Scan::allScans[i+1]->getIdentifier() + ".diff";
+    cout << "Writing " << removed.size() / 4 << " removed and "
+         << added.size() / 4 << " added points to " << diffFileName << endl;
+
+    diffheader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, DIFF_MAGIC, sizeof(header.magic));
+    header.dist = dist;
+    header.nrRemoved = removed.size() / 4;
+    header.nrAdded = added.size() / 4;
+
+    ofstream diffout(diffFileName.c_str(), std::ios::binary);
+    diffout.write((const char*)&header, sizeof(header));
+    if (!removed.empty())
+      diffout.write((const char*)&removed[0], removed.size() * sizeof(double));
+    if (!added.empty())
+      diffout.write((const char*)&added[0], added.size() * sizeof(double));
+    if (!diffout.good()) {
+      cerr << "Writing " << diffFileName << " failed" << endl;
+      exit(1);
+    }
+    diffout.close();
+  }
+
+  for (unsigned int i = 0; i < nrScans; i++) {
+    delete trees[i];
+    delete xyz[i];
+  }
+}
+
 /**
  * Main program for calculating the difference of two scans.
  * Usage: bin/scan_diff -d <NR> -s <NR> -e <NR> 'dir',
@@ -251,8 +422,9 @@ int main(int argc, char **argv)
   IOType type    = RIEGL_TXT;
   bool desc = false;  
   bool scanserver = false;
+  bool pairwise = false;
 
-  parseArgs(argc, argv, dir, start, end, maxDist, minDist, dist, type, desc, scanserver);
+  parseArgs(argc, argv, dir, start, end, maxDist, minDist, dist, type, desc, pairwise, scanserver);
 
   if (scanserver) {
     try {
@@ -279,6 +451,27 @@ int main(int argc, char **argv)
     cerr << "Creating directory " << diffdir << " failed" << endl;
     exit(1);
   }
+
+  if (pairwise) {
+    Scan::openDirectory(scanserver, dir, type, start, end);
+
+    if(Scan::allScans.size() < 2) {
+      cerr << "Less than two scans found. Did you use the correct format?" << endl;
+      exit(-1);
+    }
+
+    pairwiseDiff(dir, dist);
+
+    cout << endl << endl;
+    cout << "Normal program end." << endl << endl;
+
+    if (scanserver) {
+      Scan::closeDirectory();
+    }
+
+    return 0;
+  }
+
   string scanFileName;
   string framesFileName;
   ifstream frames_in;
@@ -343,13 +536,15 @@ int main(int argc, char **argv)
   int thread_num = 0;
   std::vector<double*> diff;
   double transMat[16];
+  // -d is a distance, getNoPairsSimple expects it squared
+  double dist2 = sqr(dist);
   
   if(desc) {
-    Scan::getNoPairsSimple(diff, scan_second, scan_first, thread_num, dist);
+    Scan::getNoPairsSimple(diff, scan_second, scan_first, thread_num, dist2);
     M4inv(inMatrix1, transMat);
     scanFileName = dir + "diff/scan" + to_string(end,3) + ".3d";
   } else {
-    Scan::getNoPairsSimple(diff, scan_first, scan_second, thread_num, dist);
+    Scan::getNoPairsSimple(diff, scan_first, scan_second, thread_num, dist2);
     M4inv(inMatrix0, transMat);
     scanFileName = dir + "diff/scan" + to_string(start,3) + ".3d";
   }
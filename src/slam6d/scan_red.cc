@@ -81,9 +81,77 @@ using namespace fbr;
 
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 enum reduction_method {OCTREE, RANGE, INTERPOLATE};
 
+/**
+ * Limits the scans reduced in parallel to a memory budget. The size of a
+ * scan is only known after loading it, so the largest scan seen so far
+ * is the estimate for the next one, and until the first scan is loaded
+ * no other one is started. A scan is always admitted if no other one is
+ * in progress.
+ */
+class MemoryBudget {
+public:
+  MemoryBudget(size_t budget) : budget(budget), used(0), estimate(0), active(0) {}
+
+  /** Waits until a scan fits into the budget, returns the reserved bytes */
+  size_t acquire() {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (active > 0 && (estimate == 0 || used + estimate > budget))
+      changed.wait(lock);
+    active++;
+    used += estimate;
+    return estimate;
+  }
+
+  /** Replaces the reservation by the memory of the loaded scan */
+  void loaded(size_t &reserved, size_t bytes) {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    used = used - reserved + bytes;
+    reserved = bytes;
+    if (bytes > estimate) estimate = bytes;
+    changed.notify_all();
+  }
+
+  /** Frees the memory of a finished scan */
+  void release(size_t reserved) {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    used -= reserved;
+    active--;
+    changed.notify_all();
+  }
+
+  /** Number of scans in progress */
+  int getActive() {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    return active;
+  }
+
+private:
+  size_t budget;
+  size_t used;
+  size_t estimate;
+  int active;
+  boost::mutex mutex;
+  boost::condition_variable changed;
+};
+
+/*
+ * shares the threads among the scans in progress, the loops inside a scan
+ * run in a nested parallel region with the returned number of threads
+ */
+void share_threads(MemoryBudget &budget)
+{
+#ifdef _OPENMP
+  int active = budget.getActive();
+  int threads = OPENMP_NUM_THREADS / (active > 0 ? active : 1);
+  omp_set_num_threads(threads > 0 ? threads : 1);
+#endif
+}
+
 /* Function used to check that 'opt1' and 'opt2' are not specified
    at the same time. */
 void conflicting_options(const po::variables_map & vm,
@@ -216,7 +284,8 @@ void parse_options(int argc, char **argv, int &start, int &end,
                    int &maxDist, int &minDist, reduction_method &rtype, double &scale,
                    double &voxel, int &octree, bool &use_reflectance,
 		   int &MIN_ANGLE, int &MAX_ANGLE, int &nImages, double &pParam,
-		   fbr::scanner_type &sType, bool &loadOct, bool &use_color)
+		   fbr::scanner_type &sType, bool &loadOct, bool &use_color,
+		   int &memory)
 {
   po::options_description generic("Generic options");
   generic.add_options()
@@ -242,7 +311,9 @@ void parse_options(int argc, char **argv, int &start, int &end,
     ("loadOct,l", po::bool_switch(&loadOct)->default_value(false),
      "Use Octree to load data if it is available")
     ("sType,t", po::value<fbr::scanner_type>(&sType),
-     "Choose scanner type");
+     "Choose scanner type")
+    ("memory", po::value<int>(&memory)->default_value(2048),
+     "memory budget in MB for the scans reduced in parallel");
 
 
   po::options_description reduction("Reduction options");
@@ -395,11 +466,12 @@ void reduce_octree(Scan *scan, vector<cv::Vec4f> &reduced_points, vector<cv::Vec
       return;
     }
     
+    reduced_points.resize(xyz_reduced.size());
     for(unsigned int j = 0; j < xyz_reduced.size(); j++) {
-      reduced_points.push_back(cv::Vec4f(xyz_reduced[j][0],
-                                         xyz_reduced[j][1],
-                                         xyz_reduced[j][2],
-                                         reflectance_reduced[j]));
+      reduced_points[j] = cv::Vec4f(xyz_reduced[j][0],
+                                    xyz_reduced[j][1],
+                                    xyz_reduced[j][2],
+                                    reflectance_reduced[j]);
     }
   } else if (use_color) {
     unsigned int types = PointType::USE_COLOR;
@@ -418,26 +490,29 @@ void reduce_octree(Scan *scan, vector<cv::Vec4f> &reduced_points, vector<cv::Vec
       return;
     }
     
+    reduced_points.resize(xyz_reduced.size());
+    color.resize(xyz_reduced.size());
     for(unsigned int j = 0; j < xyz_reduced.size(); j++) {
-      reduced_points.push_back(cv::Vec4f(xyz_reduced[j][0],
-                                         xyz_reduced[j][1],
-                                         xyz_reduced[j][2],
-                                         0.0));
-
-      color.push_back(cv::Vec3b(color_reduced[j][0],
-                                color_reduced[j][1],
-                                color_reduced[j][2]));
+      reduced_points[j] = cv::Vec4f(xyz_reduced[j][0],
+                                    xyz_reduced[j][1],
+                                    xyz_reduced[j][2],
+                                    0.0);
+
+      color[j] = cv::Vec3b(color_reduced[j][0],
+                           color_reduced[j][1],
+                           color_reduced[j][2]);
     }
   } else {
     scan->setReductionParameter(red, octree);
     scan->calcReducedPoints();
 
     DataXYZ xyz_reduced(scan->get("xyz reduced"));
+    reduced_points.resize(xyz_reduced.size());
     for(unsigned int j = 0; j < xyz_reduced.size(); j++) {
-      reduced_points.push_back(cv::Vec4f(xyz_reduced[j][0],
-                                         xyz_reduced[j][1],
-                                         xyz_reduced[j][2],
-                                         0.0));
+      reduced_points[j] = cv::Vec4f(xyz_reduced[j][0],
+                                    xyz_reduced[j][1],
+                                    xyz_reduced[j][2],
+                                    0.0);
     }
   }
 }
@@ -510,14 +585,20 @@ void reduce_interpolation(cv::Mat mat,
 	   //cv::Size(), scale, scale, cv::INTER_LINEAR);
   }
   
-  for(int i = 0; i < range_image_resized.rows; i++) {
-    for(int j = 0; j < range_image_resized.cols; j++) {
+  // one point per pixel, the rows are filled in parallel
+  int rows = range_image_resized.rows, cols = range_image_resized.cols;
+  reduced_points.resize(rows * cols);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int i = 0; i < rows; i++) {
+    for(int j = 0; j < cols; j++) {
       cv::Vec3f vec = range_image_resized.at<cv::Vec3f>(i, j);
       if (use_reflectance) {
-        reduced_points.push_back(cv::Vec4f(vec[0], vec[1], vec[2],
-                    reflectance_image_resized.at<uchar>(i, j)/255.0));
+        reduced_points[i * cols + j] = cv::Vec4f(vec[0], vec[1], vec[2],
+                    reflectance_image_resized.at<uchar>(i, j)/255.0);
       } else {
-	reduced_points.push_back(cv::Vec4f(vec[0], vec[1], vec[2], 0.0));
+	reduced_points[i * cols + j] = cv::Vec4f(vec[0], vec[1], vec[2], 0.0);
       }
     }
   }
@@ -558,31 +639,50 @@ int main(int argc, char **argv)
   bool imageOptimization = false;
 
 
+  int memory;
+
   parse_options(argc, argv, start, end, scanserver, width, height, ptype,
                 dir, iotype, maxDist, minDist, rtype, scale, voxel, octree,
                 use_reflectance, MIN_ANGLE, MAX_ANGLE, nImages, pParam,
-		sType, loadOct, use_color);
+		sType, loadOct, use_color, memory);
 
-  for (int iter = start; iter <= end; iter++) {
-    
-    vector<cv::Vec4f> reduced_points;
-    vector<cv::Vec3b> color;
-      
-    string reddir = dir + "reduced";
-    createdirectory(reddir);
-    
-    if(rtype == OCTREE)
-    {
-      Scan::openDirectory(scanserver, dir, iotype, iter, iter);
-      if(Scan::allScans.size() == 0) {
-        cerr << "No scans found. Did you use the correct format?" << endl;
-        exit(-1);
-      }
+  string reddir = dir + "reduced";
+  createdirectory(reddir);
+
+  // scans are reduced in parallel, each one with a share of the threads
+  MemoryBudget budget((size_t)memory * 1024 * 1024);
+#ifdef _OPENMP
+  omp_set_nested(1);
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#endif
+
+  if(rtype == OCTREE)
+  {
+    Scan::openDirectory(scanserver, dir, iotype, start, end);
+    if(Scan::allScans.size() == 0) {
+      cerr << "No scans found. Did you use the correct format?" << endl;
+      exit(-1);
+    }
 
-      Scan* scan = *Scan::allScans.begin();
+    int nScans = Scan::allScans.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < nScans; i++) {
+      Scan* scan = Scan::allScans[i];
+      size_t reserved = budget.acquire();
+      share_threads(budget);
+
+      vector<cv::Vec4f> reduced_points;
+      vector<cv::Vec3b> color;
 
       scan->setRangeFilter(maxDist, minDist);
 
+      // points and attributes, their reduced copies and the result
+      unsigned int nPoints = scan->size<DataXYZ>("xyz");
+      budget.loaded(reserved, (size_t)nPoints * 2 * (3 * sizeof(double) + sizeof(float) + 3)
+                    + (size_t)nPoints * (sizeof(cv::Vec4f) + sizeof(cv::Vec3b)));
+
       reduce_octree(scan,
           reduced_points,
           color,
@@ -611,14 +711,44 @@ int main(int argc, char **argv)
           scan->get_rPosTheta(),
           scan->getIdentifier());
 
+      // all scans stay open, only their data is freed
+      scan->clear("xyz");
+      scan->clear("reflectance");
+      scan->clear("rgb");
+      scan->clear("xyz reduced");
+      scan->clear("xyz reduced original");
+      scan->clear("reflectance reduced");
+      scan->clear("color reduced");
+
+      budget.release(reserved);
     }
-    else
-    {
+    Scan::closeDirectory();
+  }
+  else
+  {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int iter = start; iter <= end; iter++) {
+      size_t reserved = budget.acquire();
+
+      vector<cv::Vec4f> reduced_points;
+
       scan_cv sMat(dir, iter, iotype, scanserver, sType, loadOct, saveOct, use_reflectance, use_color);
 
+      // scan_cv loads through the global list of scans
+#ifdef _OPENMP
+#pragma omp critical (scan_red_load)
+#endif
+      sMat.convertScanToMat();
+
+      // the scan, the panorama images and the result
+      budget.loaded(reserved, (size_t)sMat.getNumberOfPoints() * (2 * sizeof(cv::Vec4f) + sizeof(cv::Vec3f))
+                    + (size_t)width * height * (sizeof(float) + 1 + sizeof(cv::Vec3f) + sizeof(cv::Vec4f)));
+      share_threads(budget);
+
       if(rtype == RANGE)
       {
-        sMat.convertScanToMat();
         reduce_range(sMat.getMatScan(),
             reduced_points,
             width,
@@ -639,7 +769,6 @@ int main(int argc, char **argv)
       }
       else if(rtype == INTERPOLATE)
       {
-        sMat.convertScanToMat();
         reduce_interpolation(sMat.getMatScan(),
             reduced_points,
             width,
@@ -677,7 +806,7 @@ int main(int argc, char **argv)
             reddir,		  
             to_string(iter,3));
 
+      budget.release(reserved);
     }
-    Scan::closeDirectory();
   }
 }
@@ -7,9 +7,21 @@ using namespace NEWMAT;
 using namespace cvb;
 
 #include <cmath>
+#include <cfloat>
+#include <cstdio>
 
 #include <slam6d/globals.icc>
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifndef _MSC_VER
 #include <getopt.h>
 #include <sys/stat.h>
@@ -363,9 +375,10 @@ IplImage* detectCorners(IplImage *orgimage, int &corner_exp, int board_h, int bo
   CvSize size = cvGetSize(image);
   CvPoint2D32f* corners = new CvPoint2D32f[corner_exp];
 	CvSize board_sz = cvSize(board_w, board_h);
-  IplImage *gray_image = cvCreateImage(size,8,1);
+  IplImage *gray_image;
 
   if (image->nChannels == 3) {
+    gray_image = cvCreateImage(size,8,1);
     cvCvtColor(image, gray_image, CV_BGR2GRAY);
   } else {
     gray_image = image;
@@ -393,10 +406,120 @@ IplImage* detectCorners(IplImage *orgimage, int &corner_exp, int board_h, int bo
     point_array2[i][1] = corners[i].y;
   }
   delete[] corners;
+  if (image != gray_image) cvReleaseImage(&image);
   return gray_image;
    
 }
 
+/**
+  * Hashes the content of a file with 64 bit FNV-1a.
+  * @return false if the file cannot be read
+  */
+bool hashFile(string filename, unsigned long long &hash) {
+  ifstream infile(filename.c_str(), ios::in | ios::binary);
+  if (!infile) return false;
+  hash = 14695981039346656037ULL;
+  char buffer[65536];
+  while (infile) {
+    infile.read(buffer, sizeof(buffer));
+    streamsize n = infile.gcount();
+    for (streamsize i = 0; i < n; i++) {
+      hash ^= (unsigned char)buffer[i];
+      hash *= 1099511628211ULL;
+    }
+  }
+  return true;
+}
+
+/**
+  * Name of the file caching the features of an image, depends on the image
+  * content and on everything that changes the detection.
+  */
+string cornerCacheName(string dir, unsigned long long hash, bool chess, int board_w, int board_h, int scale) {
+  char name[128];
+  if (chess) {
+    snprintf(name, 128, "%016llx_chess_%dx%d_%d.txt", hash, board_w, board_h, scale);
+  } else {
+    snprintf(name, 128, "%016llx_blob_%dx%d.txt", hash, board_w, board_h);
+  }
+  return dir + "/corners/" + name;
+}
+
+/**
+  * Reads the cached features of an image.
+  */
+bool readCornerCache(string filename, CalibView &view, int corner_exp) {
+  ifstream infile(filename.c_str(), ios::in);
+  if (!infile) return false;
+  infile >> view.corners >> view.size.width >> view.size.height;
+  if (!infile || view.corners < 0 || view.corners > corner_exp) return false;
+  view.points.assign(corner_exp, vector<double>(2, 0.0));
+  for (int i = 0; i < view.corners; i++) {
+    infile >> view.points[i][0] >> view.points[i][1];
+  }
+  return (bool)infile;
+}
+
+/**
+  * Writes the features of an image to the cache.
+  */
+void writeCornerCache(string filename, const CalibView &view) {
+  ofstream outfile(filename.c_str(), ios::out);
+  outfile.precision(17);
+  outfile << view.corners << " " << view.size.width << " " << view.size.height << endl;
+  for (int i = 0; i < view.corners; i++) {
+    outfile << view.points[i][0] << " " << view.points[i][1] << endl;
+  }
+}
+
+/**
+  * Detects the calibration features in the images of a calibration. The
+  * images are processed in parallel, features found before are read from
+  * the cache in dir/corners instead.
+  * @param files the images, an empty name skips the image
+  * @param views the features of each image, views[i].corners is -1 if the
+  * image cannot be loaded
+  */
+void detectViews(vector<string> &files, vector<CalibView> &views, int board_w,
+int board_h, bool chess, bool quiet, string dir, int scale) {
+  int corner_exp = board_w * board_h;
+  openOutputDirectory(dir + "/corners");
+  views.resize(files.size());
+
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < (int)files.size(); i++) {
+    CalibView &view = views[i];
+    view.corners = -1;
+    if (files[i].empty()) continue;
+
+    unsigned long long hash;
+    if (!hashFile(files[i], hash)) continue;
+    string cache = cornerCacheName(dir, hash, chess, board_w, board_h, scale);
+    if (readCornerCache(cache, view, corner_exp)) continue;
+
+    IplImage* image1 = cvLoadImage(files[i].c_str(), -1);
+    if (!image1) {
+      view.corners = -1;
+      continue;
+    }
+    view.points.assign(corner_exp, vector<double>(2, 0.0));
+    view.corners = corner_exp;
+    IplImage *image;
+    if(chess) {
+      image = detectCorners(image1, view.corners, board_h, board_w, quiet, view.points, scale);
+    } else {
+      image = detectBlobs(image1, view.corners, board_h, board_w, quiet, view.points);
+    }
+    view.size = cvGetSize(image);
+    writeCornerCache(cache, view);
+    cvReleaseImage(&image);
+    cvReleaseImage(&image1);
+  }
+}
+
 /**
   * Writes the intrinsic calibration parameters to files.
   */
@@ -469,10 +592,6 @@ image_points, CvSize size, string dir, string substring) {
   */
 void CalibFunc(int board_w, int board_h, int start, int end, bool optical, bool
 chess, bool quiet, string dir, int scale) {
-  cvNamedWindow("Original Image", 0);
-  cvNamedWindow("Final Result", 0);
-  cvResizeWindow( "Original Image", 480, 640 ); 
-  cvResizeWindow( "Final Result", 480, 640 ); 
   int nr_img = end - start + 1;
 	if (nr_img == 0) {
 		cout << "ImageCount is zero!" << endl;
@@ -480,91 +599,45 @@ chess, bool quiet, string dir, int scale) {
 	}
 	
   int corner_exp = board_w * board_h;
-	CvSize board_sz = cvSize(board_w, board_h);
 	CvSize size;
 	//ALLOCATE STORAGE(depending upon the number of images in(in case if command line arguments are given )
 	//not on the basis of number of images in which all corner extracted/while in the other case the number is the same )
 	CvMat* image_points = cvCreateMat(nr_img * corner_exp, 2, CV_32FC1);
-	//TODO CvPoint2D32f* corners = new CvPoint2D32f[ board_n ];
 	
   int successes = 0;
 	int step = 0;
-	
-  for (int count = start; count <= end; count++) {
-		cout << "count : " << count << endl;
-    string t;
-    string t1;
 
+  vector<string> files;
+  for (int count = start; count <= end; count++) {
     if(optical) {
-      //TODO t = dir + "/photo" + to_string(count, 3) + ".ppm";
-      t = dir + "/photo" + to_string(count, 3) + ".jpg";
-      //t = dir + to_string(count, 3) + "/photo" + to_string(count, 3) + ".ppm";
+      files.push_back(dir + "/photo" + to_string(count, 3) + ".jpg");
     } else {
-      //t = dir + to_string(count, 3) + "/image" + to_string(count, 3) + ".ppm";
-      t = dir + "/image" + to_string(count, 3) + ".ppm";
+      files.push_back(dir + "/image" + to_string(count, 3) + ".ppm");
     }
-    cout << t << endl;
-		//loading images and finding corners
-		IplImage* image1 = cvLoadImage(t.c_str(), -1);
-		if (!image1) {
+  }
+  vector<CalibView> views;
+  detectViews(files, views, board_w, board_h, chess, quiet, dir, scale);
+	
+  // accepting the views in the order of the images
+  for (int count = start; count <= end; count++) {
+    CalibView &view = views[count - start];
+		cout << "count : " << count << endl;
+    cout << files[count - start] << endl;
+		if (view.corners < 0) {
 			cout << "image cannot be loaded" << endl;
+			cvReleaseMat(&image_points);
 			return;
 		}
-    cvShowImage("Original Image", image1);
-	
-    /////////////////////////////////////////////////////////////
-//    double point_array2[corner_exp][2];
-	vector<vector<double> > point_array2(corner_exp, vector<double>(2));
-    IplImage *image;
-    
-    int tmp_corners = corner_exp;
-    if(chess) {
-      cout << "detect corners" << endl;
-      image = detectCorners(image1, tmp_corners, board_h, board_w, quiet, point_array2, scale);
-    } else {
-      cout << "detect blob" << endl;
-      image = detectBlobs(image1, tmp_corners, board_h, board_w, quiet, point_array2);
-    }
-
-    /*
-    for(int i = 0; i < corner_exp; i++) {
-      cout << (float) point_array2[i][0] << " " << (float) point_array2[i][1] <<
-      endl;
-    }
-    
-		//drawing the lines on the image now
-    */
-		drawLines(point_array2, corner_exp, image);
-    //cvDrawChessboardCorners(image, size, point_array2, tmp_corners, true);
-    //cvShowImage("Final Result", image);
-		char in;
-    if(tmp_corners == corner_exp) {
-      cout << "\nDo you want to use the data from this image ('y' or 'n'). 'x' aborts the calibration? : ";
-      in = 'y';
-      /*
-      int c = cvWaitKey(100);
-      if (c == 27) {
-        break;
-      }
-      cin >> in;
-      */
-      if (in == 'y') {
-        //cvSaveImage(t1.c_str(), image);
-        size = cvGetSize(image);
-        step = successes * corner_exp;
-        //appending corner data to a generic data structure for all images
-        for (int i = step, j = 0; j < corner_exp; ++i, ++j) {
-          CV_MAT_ELEM(*image_points, float,i,0) = (float) point_array2[j][0];
-          CV_MAT_ELEM(*image_points, float,i,1) = (float) point_array2[j][1];
-        }
-        successes++;
-      } else if(in == 'x') {
-        break;
+    if(view.corners == corner_exp) {
+      size = view.size;
+      step = successes * corner_exp;
+      //appending corner data to a generic data structure for all images
+      for (int i = step, j = 0; j < corner_exp; ++i, ++j) {
+        CV_MAT_ELEM(*image_points, float,i,0) = (float) view.points[j][0];
+        CV_MAT_ELEM(*image_points, float,i,1) = (float) view.points[j][1];
       }
+      successes++;
     }
-		cvReleaseImage(&image);
-		cvReleaseImage(&image1);
-
 	}
 	cout << "Images for which all corners were found successfully="
 			<< successes << endl;
@@ -991,7 +1064,6 @@ void ExtrCalibFunc(int board_w, int board_h, int start, int end, bool optical, b
   int corner_exp = board_w * board_h;
   CvSize board_sz = cvSize(board_w, board_h);
   CvSize size;
-  CvPoint3D32f* corners = new CvPoint3D32f[corner_exp];
   
   //ALLOCATE STORAGE(depending upon the number of images in(in case if command line arguments are given )
   //not on the basis of number of images in which all corner extracted/while in the other case the number is the same )
@@ -1007,28 +1079,32 @@ void ExtrCalibFunc(int board_w, int board_h, int start, int end, bool optical, b
   CvMat* points2D = cvCreateMat(nr_img, corner_exp, CV_32FC2);
   int successes = 0;
 
-  int tmp_corners = corner_exp;
+  // Load points from scans, detect corners in the images of those
+  vector<string> files;
+  vector<CvPoint3D32f> scan_corners(nr_img * corner_exp);
   for (int count = start; count <= end; count++) {
-    corner_exp = tmp_corners;
-    string i;
-    string p;
-
-    cout << "Reading data " << to_string(count, 3) << endl;
-    if(optical) {
-      //TODO i = dir + "/photo" + to_string(count, 3) + ".ppm";
-      i = dir + "/photo" + to_string(count, 3) + ".jpg";
+    string p = dir + "cali/scan" + to_string(count,3) + ".3d";
+    cout << p << endl;
+    if(!readPoints(p, &scan_corners[(count - start) * corner_exp], corner_exp)) {
+      files.push_back("");
+    } else if(optical) {
+      files.push_back(dir + "/photo" + to_string(count, 3) + ".jpg");
     } else {
-      i = dir + "/image" + to_string(count, 3) + ".ppm";
+      files.push_back(dir + "/image" + to_string(count, 3) + ".ppm");
     }
-    p = dir + "cali/scan" + to_string(count,3) + ".3d";
-    cout << p << endl;
-    // Load points from scan
-    bool scan_cali = readPoints(p, corners, corner_exp);
-    
-    if(!scan_cali) continue;
-    // Load image and detect corners
-    IplImage* image1 = cvLoadImage(i.c_str(), -1);
-    if (!image1) {
+  }
+  vector<CalibView> views;
+  detectViews(files, views, board_w, board_h, chess, quiet, dir, scale);
+
+  for (int count = start; count <= end; count++) {
+    cout << "Reading data " << to_string(count, 3) << endl;
+    if(files[count - start].empty()) continue;
+    CalibView &view = views[count - start];
+    CvPoint3D32f *corners = &scan_corners[(count - start) * corner_exp];
+
+    // Load image for showing the detected corners
+    IplImage* image1 = cvLoadImage(files[count - start].c_str(), -1);
+    if (!image1 || view.corners < 0) {
       cout << "image cannot be loaded" << endl;
       return;
     }
@@ -1037,22 +1113,11 @@ void ExtrCalibFunc(int board_w, int board_h, int start, int end, bool optical, b
     cvUndistort2(image1, image2, intrinsic, distortion);
     cvShowImage("Final Result", image2);
 
-    vector<vector<double> > point_array2(corner_exp, vector<double>(2));
-    IplImage *image;
-    
+    vector<vector<double> > &point_array2 = view.points;
+    IplImage *image = resizeImage(image1, chess ? scale : 1);
 
-    if(chess) {
-      image = detectCorners(image1, corner_exp, board_h, board_w, quiet, point_array2, scale);
-    } else {
-      image = detectBlobs(image1, tmp_corners, board_h, board_w, quiet, point_array2);
-    }
-    if (!image) {
-      cout << "image cannot be loaded" << endl;
-      return;
-    }
     //drawing the lines on the image now
-    if(tmp_corners == corner_exp) {
-      cout << tmp_corners << " " << corner_exp << endl;
+    if(view.corners == corner_exp) {
       drawLines(point_array2, corner_exp, image);
       CvMat* image_points = cvCreateMat(corner_exp, 2, CV_32FC1);
       CvMat* object_points = cvCreateMat(corner_exp, 3, CV_32FC1);
@@ -1147,7 +1212,6 @@ void ExtrCalibFunc(int board_w, int board_h, int start, int end, bool optical, b
   cvReleaseMat(&rotation_vectors_temp);
   cvReleaseMat(&points2D);
   cvReleaseMat(&points3D);
-  delete[] corners;
 }
 
 //bool readFrames(char * dir, int index, double * rPos, rPosTheta) {
@@ -1893,6 +1957,92 @@ bool checkBounds(int px, int py, IplImage *image) {
   return (px < image->width && px >= 0 && py >= 0 && py < image->height); 
 }
 
+/**
+  * Colours the points of a scan that are visible in one image. All points are
+  * projected at once with and without distortion and their depth in the
+  * camera frame is computed in the same pass, without temporary matrices per
+  * point. With correction only the points closest to the camera in their
+  * pixel neighborhood are kept, using a z-buffer of the image.
+  * @param text the coloured points in the format of the output file
+  */
+void ProjectImage(CvMat *point_3Dcloud, CvMat *rod_comI, CvMat *t_comI,
+    CvMat *rot_tmp, CvMat *intrinsic, CvMat *distortion, CvMat *undistort,
+    IplImage *image, bool optical, bool correction, int neighborhood,
+    string &text) {
+  int nr_points = point_3Dcloud->rows;
+  CvMat* point_2Dcloud = cvCreateMat(nr_points, 2, CV_32FC1);
+  CvMat* undistort_2Dcloud = cvCreateMat(nr_points, 2, CV_32FC1);
+  cvProjectPoints2(point_3Dcloud, rod_comI, t_comI, intrinsic, distortion, point_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
+  cvProjectPoints2(point_3Dcloud, rod_comI, t_comI, intrinsic, undistort, undistort_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
+
+  // last row of the rotation gives the viewing direction
+  double dir[3];
+  for(int w = 0; w < 3; w++) {
+    dir[w] = CV_MAT_ELEM(*rot_tmp,float,2,w);
+  }
+  double tz = CV_MAT_ELEM(*t_comI,float,2,0);
+
+  // pixel of every point in front of the camera, -1 if it is not visible
+  vector<int> pixel(nr_points, -1);
+  vector<float> depth(nr_points);
+  for (int k = 0; k < nr_points; k++) {
+    if(!checkBounds(round(CV_MAT_ELEM(*undistort_2Dcloud,float,k,0)),
+                    round(CV_MAT_ELEM(*undistort_2Dcloud,float,k,1)),
+                    image)) continue;
+    int ppx = round(CV_MAT_ELEM(*point_2Dcloud,float,k,0));
+    int ppy = round(CV_MAT_ELEM(*point_2Dcloud,float,k,1));
+    if(!checkBounds(ppx, ppy, image)) continue;
+    double z = dir[0] * CV_MAT_ELEM(*point_3Dcloud,float,k,0)
+             + dir[1] * CV_MAT_ELEM(*point_3Dcloud,float,k,1)
+             + dir[2] * CV_MAT_ELEM(*point_3Dcloud,float,k,2);
+    if(z < 0) continue;
+    pixel[k] = ppy * image->width + ppx;
+    depth[k] = z + tz;
+  }
+  cvReleaseMat(&point_2Dcloud);
+  cvReleaseMat(&undistort_2Dcloud);
+
+  // overlap correction, points behind the closest one in their neighborhood
+  // are occluded
+  if(correction) {
+    double thresh = 4;
+    cv::Mat zbuffer(image->height, image->width, CV_32FC1, cv::Scalar(FLT_MAX));
+    float *zb = (float*)zbuffer.data;
+    for (int k = 0; k < nr_points; k++) {
+      if(pixel[k] >= 0 && depth[k] < zb[pixel[k]]) {
+        zb[pixel[k]] = depth[k];
+      }
+    }
+    if(neighborhood > 1) {
+      int limit = neighborhood / 2;
+      cv::erode(zbuffer, zbuffer, cv::Mat::ones(2*limit + 1, 2*limit + 1, CV_8U));
+    }
+    for (int k = 0; k < nr_points; k++) {
+      if(pixel[k] >= 0 && depth[k] > zb[pixel[k]] + thresh) {
+        pixel[k] = -1;
+      }
+    }
+  }
+
+  // write all the data
+  stringstream outdat;
+  for (int k = 0; k < nr_points; k++) {
+    if(pixel[k] < 0) continue;
+    CvScalar c = cvGet2D(image, pixel[k] / image->width, pixel[k] % image->width);
+
+    outdat << -(CV_MAT_ELEM(*point_3Dcloud,float,k,1))<<" ";
+    outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,2)<<" ";
+    outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,0)<<" ";
+
+    if(optical) {
+      outdat << c.val[2] <<" "<< c.val[1]<<" "<<c.val[0]<<endl;
+    } else {
+      outdat << (c.val[0] - 1000.0)/10.0 << endl;
+    }
+  }
+  text = outdat.str();
+}
+
 /**
   * Main function for projecting the 3D points onto the corresponding image and
   * associating temperature values to the data points.
@@ -1920,10 +2070,12 @@ void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
 
   double starttime = GetCurrentTimeInMilliSec();
 
-  stringstream outdat;
-  int pointcnt = 0;
   string outdir = dir + "/labscan-map"; 
   openOutputDirectory(outdir);
+
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#endif
   
   for (int count = start; count <= end; count++) {
     // filling the rotation matrix 
@@ -1931,9 +2083,6 @@ void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
     CvMat *point_3Dcloud;
     int nr_points = openDirectory(point_3Dcloud, dir, type, count);
     
-    CvMat* point_2Dcloud = cvCreateMat(nr_points, 2, CV_32FC1);
-    CvMat* undistort_2Dcloud = cvCreateMat(nr_points, 2, CV_32FC1);
-    
     cout << "Number of points read: " << nr_points << endl;
     delete Scan::allScans[0];
     Scan::allScans.clear();
@@ -1943,8 +2092,12 @@ void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
     fstream outfile;
     outfile.open(outname.c_str(), ios::out);
 
-
+    // the images are mapped in parallel and written in their order
     int nrP360 = 10;
+    vector<string> coloured(nrP360);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
     for(int p = 0; p < nrP360; p++) {
       //for(int p = 0; p < 9; p++) {
       //double angle = rot_angle * (p%nrP360) + 2.0;
@@ -1954,164 +2107,37 @@ void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
 
       IplImage *image;
       loadImage(image, dir, count0, optical, scale);
-      CvSize size = cvGetSize(image); 
 
       // rotate Rotation and Translation
       CvMat* rod_comI; 
       CvMat* t_comI; 
-      CvMat* rot_tmp = cvCreateMat(3,3,CV_32FC1);
+      CvMat* rot_tmp;
       calculateGlobalPoses(Translation, Rotation, t_comI, rod_comI, angle, rot_tmp);
 
-      // Project Points
-      cvProjectPoints2(point_3Dcloud, rod_comI, t_comI, intrinsic, distortion, point_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
-      cvProjectPoints2(point_3Dcloud, rod_comI, t_comI, intrinsic, undistort, undistort_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
+      ProjectImage(point_3Dcloud, rod_comI, t_comI, rot_tmp, intrinsic,
+                   distortion, undistort, image, optical, correction,
+                   neighborhood, coloured[p]);
 
       cvReleaseMat(&t_comI);
       cvReleaseMat(&rod_comI);
-      cout << "Done projecting points" << endl;
-
-      // checking whether projection lies within the image boundaries
-      cout << "Now project points" << endl; 
-      for (int k = 0; k < nr_points; k++) {
-        if(checkBounds(round(CV_MAT_ELEM(*undistort_2Dcloud,float,k,0)),
-                       round(CV_MAT_ELEM(*undistort_2Dcloud,float,k,1)), 
-                       image))
-        {
-          if(checkBounds( round(CV_MAT_ELEM(*point_2Dcloud,float,k,0)),
-                          round(CV_MAT_ELEM(*point_2Dcloud,float,k,1)),
-                          image))
-          {
-            CvScalar c;
-            if(!checkDirection(c, round(CV_MAT_ELEM(*point_2Dcloud,float,k,0)),
-                                        round(CV_MAT_ELEM(*point_2Dcloud,float,k,1)),
-                                        rot_tmp, point_3Dcloud, k, image
-                                 )) continue;
-            /*
-               outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,0) << " "
-               << CV_MAT_ELEM(*point_3Dcloud,float,k,1) << " "
-               << CV_MAT_ELEM(*point_3Dcloud,float,k,2) << " "
-               << CV_MAT_ELEM(*tmp2, CvPoint3D32f, 0,0).x << " "  
-               << CV_MAT_ELEM(*tmp2, CvPoint3D32f, 0,0).y << " "
-               << CV_MAT_ELEM(*tmp2, CvPoint3D32f, 0,0).z << endl;
-             */
-            // check for overlap
-            /*
-               if(correction) {
-               vector<float> temp_vec;
-               float p_id = 1; // 1 for pixel, 0 for neighboring pixel
-               temp_vec.push_back(-(CV_MAT_ELEM(*point_3Dcloud,float,k,1)));
-               temp_vec.push_back((CV_MAT_ELEM(*point_3Dcloud,float,k,2)));
-               temp_vec.push_back((CV_MAT_ELEM(*point_3Dcloud,float,k,0)));
-               temp_vec.push_back(c.val[2]);
-               temp_vec.push_back(c.val[1]);
-               temp_vec.push_back(c.val[0]);
-               temp_vec.push_back(p_id);
-               if(neighborhood > 1) {
-               int limit = neighborhood / 2;
-
-               int lower_y = ppy - limit > 0 ? ppy - limit : 0;
-               int upper_y = ppy + limit < size.height ? ppy + limit : size.height - 1;
-               int lower_x = ppx - limit > 0 ? ppx - limit : 0;
-               int upper_x = ppx + limit < size.width ? ppx + limit : size.width - 1;
-
-               for (int y = lower_y; y < upper_y; y++) {
-               for (int x = lower_x; x < upper_x; x++) {
-               if(x == ppx && y == ppy) {
-               temp_vec[6] = 1;
-               } else {
-               temp_vec[6] = 0;
-               }
-               data1[y][x].push_back(temp_vec);
-               }
-               }
-
-               } else {
-               data1[ppy][ppx].push_back(temp_vec);
-               }
-               temp_vec.clear();
-               } else {
-             */
-            // write all the data
-
-            outdat << -(CV_MAT_ELEM(*point_3Dcloud,float,k,1))<<" ";
-            outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,2)<<" ";
-            outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,0)<<" ";
-
-            if(optical) {
-              outdat << c.val[2] <<" "<< c.val[1]<<" "<<c.val[0]<<endl;
-            } else {
-              outdat << (c.val[0] - 1000.0)/10.0 << endl;
-            }
-
-            pointcnt++;
-            if(pointcnt > 100) {
-              outfile.write(outdat.str().c_str(), outdat.str().size());
-              pointcnt = 0;
-              outdat.clear();
-              outdat.str("");
-            }
-
-            /*
-               outfile << -(CV_MAT_ELEM(*point_3Dcloud,float,k,1))<<" ";
-               outfile << CV_MAT_ELEM(*point_3Dcloud,float,k,2)<<" ";
-               outfile << CV_MAT_ELEM(*point_3Dcloud,float,k,0)<<" ";
-
-               if(optical) {
-               outfile << c.val[2] <<" "<< c.val[1]<<" "<<c.val[0]<<endl;
-               } else {
-               outfile << (c.val[0] - 1000.0)/10.0 << endl;
-               }
-            //outfile << c.val[2] <<" "<< c.val[1]<<" "<<c.val[0]<<endl;
-             */
-
-            //}
-          } 
-          // second image
-        } 
-
-
-      }
-
-      cout << "Done sorting points" << endl;
-
-      // write data with overlap correction
-      if(correction) {
-        CorrectErrorAndWrite(data1, outfile, size, optical);
-        cout << "Done first image" << endl;
-        if(fabs(rot_angle) > 1) {
-          if(size.width > 0 && size.height > 0) {
-            CorrectErrorAndWrite(data2, outfile, size, optical);
-          }
-        }
-      }
-
-      cout << "Done correction" << endl;
-      // clean up
-      outfile.flush();
+      cvReleaseMat(&rot_tmp);
+      cvReleaseImage(&image);
 
       double endtime = GetCurrentTimeInMilliSec();
       double time = endtime - starttime;
       time = time/1000.0;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
       cout<<"runtime for scan " << count0 << " in seconds is: " << time << endl;
+    }
 
-      cvReleaseImage(&image);
-      if(correction) {
-        for (int i = 0; i < size.height; i++) {
-          for (int j = 0; j < size.width; j++) {
-            data1[i][j].clear();
-            if(fabs(rot_angle) > 1) {
-              data2[i][j].clear();
-            }
-          }
-        }
-      }
-      cvReleaseMat(&rot_tmp);
+    for(int p = 0; p < nrP360; p++) {
+      outfile.write(coloured[p].c_str(), coloured[p].size());
     }
     outfile.close();
 
-    cvReleaseMat(&point_2Dcloud);
     cvReleaseMat(&point_3Dcloud);
-    cvReleaseMat(&undistort_2Dcloud);
 
     }
   // Final cleanup  
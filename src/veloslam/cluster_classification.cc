@@ -2,14 +2,238 @@
 #include "veloslam/svm.h"
 #include "veloslam/cluster_classification.h"
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <iostream>
+using std::cerr;
+using std::endl;
+
 Cluster_Classification::Cluster_Classification(void)
+  : bus_classifier(0), dim(0), warned(false)
 {
 
 }
 
+Cluster_Classification::Cluster_Classification(const string &filename)
+  : bus_classifier(0), dim(0), warned(false)
+{
+	Load(filename);
+}
+
 Cluster_Classification::~Cluster_Classification(void)
 {
+	Free();
+}
 
+void Cluster_Classification::Free(void)
+{
+	if (bus_classifier)
+		svm_free_and_destroy_model(&bus_classifier);
+	bus_classifier = 0;
+	dim = 0;
+	warned = false;
+	sv.clear();
+	start.clear();
 }
 
+bool Cluster_Classification::Load(const string &filename)
+{
+	Free();
+	bus_classifier_filename = filename;
+
+	svm_model *model = svm_load_model(filename.c_str());
+	if (model == 0) {
+		cerr << "Could not load SVM model " << filename << endl;
+		return false;
+	}
+	if (model->param.kernel_type == PRECOMPUTED) {
+		cerr << "SVM model " << filename << " uses a precomputed kernel" << endl;
+		svm_free_and_destroy_model(&model);
+		return false;
+	}
+	bus_classifier = model;
+
+	int i;
+	for (i = 0; i < model->l; i++)
+		for (const svm_node *n = model->SV[i]; n->index != -1; ++n)
+			if (n->index > dim) dim = n->index;
+
+	// the sparse support vectors become rows of a dense matrix
+	sv.assign((size_t)model->l * dim, 0.0);
+	for (i = 0; i < model->l; i++)
+		for (const svm_node *n = model->SV[i]; n->index != -1; ++n)
+			if (n->index > 0)
+				sv[(size_t)i * dim + n->index - 1] = n->value;
+
+	if (model->nSV) {
+		start.resize(model->nr_class);
+		start[0] = 0;
+		for (i = 1; i < model->nr_class; i++)
+			start[i] = start[i-1] + model->nSV[i-1];
+	}
+	return true;
+}
+
+/**
+ * Dot product and squared distance of two dense vectors
+ */
+static inline void DotAndDistance(const double *x, const double *y, int n,
+                                  double &dot, double &dist)
+{
+	int i = 0;
+	dot = dist = 0.0;
+#ifdef __SSE2__
+	__m128d d0 = _mm_setzero_pd(), d1 = _mm_setzero_pd();
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	for (; i + 4 <= n; i += 4) {
+		__m128d x0 = _mm_loadu_pd(x + i), x1 = _mm_loadu_pd(x + i + 2);
+		__m128d y0 = _mm_loadu_pd(y + i), y1 = _mm_loadu_pd(y + i + 2);
+		d0 = _mm_add_pd(d0, _mm_mul_pd(x0, y0));
+		d1 = _mm_add_pd(d1, _mm_mul_pd(x1, y1));
+		__m128d e0 = _mm_sub_pd(x0, y0), e1 = _mm_sub_pd(x1, y1);
+		s0 = _mm_add_pd(s0, _mm_mul_pd(e0, e0));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(e1, e1));
+	}
+	double tmp[2];
+	_mm_storeu_pd(tmp, _mm_add_pd(d0, d1));
+	dot = tmp[0] + tmp[1];
+	_mm_storeu_pd(tmp, _mm_add_pd(s0, s1));
+	dist = tmp[0] + tmp[1];
+#endif
+	for (; i < n; i++) {
+		dot += x[i] * y[i];
+		double e = x[i] - y[i];
+		dist += e * e;
+	}
+}
 
+/**
+ * Decision of svm_predict_values from the kernel values of all support
+ * vectors
+ */
+double Cluster_Classification::Decide(const double *kvalue) const
+{
+	const svm_model *model = bus_classifier;
+	int i, j, k;
+
+	if (model->param.svm_type == ONE_CLASS ||
+	    model->param.svm_type == EPSILON_SVR ||
+	    model->param.svm_type == NU_SVR) {
+		double sum = -model->rho[0];
+		for (i = 0; i < model->l; i++)
+			sum += model->sv_coef[0][i] * kvalue[i];
+		if (model->param.svm_type == ONE_CLASS)
+			return (sum > 0) ? 1 : -1;
+		return sum;
+	}
+
+	int nr_class = model->nr_class;
+	vector<int> vote(nr_class, 0);
+	int p = 0;
+	for (i = 0; i < nr_class; i++) {
+		for (j = i + 1; j < nr_class; j++) {
+			double sum = 0;
+			int si = start[i];
+			int sj = start[j];
+			const double *coef1 = model->sv_coef[j-1];
+			const double *coef2 = model->sv_coef[i];
+			for (k = 0; k < model->nSV[i]; k++)
+				sum += coef1[si+k] * kvalue[si+k];
+			for (k = 0; k < model->nSV[j]; k++)
+				sum += coef2[sj+k] * kvalue[sj+k];
+			sum -= model->rho[p++];
+
+			if (sum > 0)
+				++vote[i];
+			else
+				++vote[j];
+		}
+	}
+
+	int vote_max_idx = 0;
+	for (i = 1; i < nr_class; i++)
+		if (vote[i] > vote[vote_max_idx])
+			vote_max_idx = i;
+	return model->label[vote_max_idx];
+}
+
+void Cluster_Classification::Predict(const double *features, int nr,
+                                     int nfeatures, double *labels) const
+{
+	if (!IsLoaded()) {
+		if (!warned) {
+			cerr << "SVM model " << bus_classifier_filename
+			     << " is not loaded, all labels are 0" << endl;
+			warned = true;
+		}
+		for (int n = 0; n < nr; n++) labels[n] = 0.0;
+		return;
+	}
+
+	const svm_parameter &param = bus_classifier->param;
+	int l = bus_classifier->l;
+	// columns present in both the feature vectors and the support vectors
+	int common = nfeatures < dim ? nfeatures : dim;
+
+	// libsvm omits zero features, so the support vectors may be shorter
+	// than the feature vectors or the other way round. The values beyond
+	// the common columns only add their squares to the distance.
+	vector<double> svtail(l, 0.0);
+	for (int i = 0; i < l; i++)
+		for (int k = common; k < dim; k++)
+			svtail[i] += sv[(size_t)i * dim + k] * sv[(size_t)i * dim + k];
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		vector<double> kvalue(l);
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+		for (int n = 0; n < nr; n++) {
+			const double *x = features + (size_t)n * nfeatures;
+			double xtail = 0.0;
+			for (int k = common; k < nfeatures; k++)
+				xtail += x[k] * x[k];
+			for (int i = 0; i < l; i++) {
+				double dot, dist;
+				DotAndDistance(x, &sv[(size_t)i * dim], common, dot, dist);
+				dist += xtail + svtail[i];
+				switch (param.kernel_type) {
+				case LINEAR:
+					kvalue[i] = dot;
+					break;
+				case POLY:
+					kvalue[i] = pow(param.gamma * dot + param.coef0, param.degree);
+					break;
+				case RBF:
+					kvalue[i] = exp(-param.gamma * dist);
+					break;
+				case SIGMOID:
+					kvalue[i] = tanh(param.gamma * dot + param.coef0);
+					break;
+				}
+			}
+			labels[n] = Decide(&kvalue[0]);
+		}
+	}
+}
+
+double Cluster_Classification::Predict(const double *feature,
+                                       int nfeatures) const
+{
+	double label;
+	Predict(feature, 1, nfeatures, &label);
+	return label;
+}
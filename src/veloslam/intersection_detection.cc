@@ -9,12 +9,19 @@
 
 #include "veloslam/intersection_detection.h"
 #include "veloslam/veloscan.h"
+#include "veloslam/cluster_classification.h"
 #include <iostream>
 #include <fstream>
 #define  DefaultColumnSize 360
 
-svm_model *m = svm_load_model("SegIter.model");
-svm_node *nod=new svm_node[361];
+/**
+ * The intersection model is loaded on first use and kept for all scans
+ */
+static Cluster_Classification& IntersectionClassifier()
+{
+	static Cluster_Classification classifier("SegIter.model");
+	return classifier;
+}
 
 IntersectionDetection::IntersectionDetection()
 {
@@ -627,20 +634,19 @@ int IntersectionDetection::DetectIntersection()
 		CalWideSlashEdge_For_RoadShape(i,startColumn,startRow,slashMaxLength,slashWide);
 	}
 
-	double labelSVM;
+	Cluster_Classification &classifier=IntersectionClassifier();
+	vector<double> feature(360);
 	for(int i=0;i<360;i++)
 	{
-		nod[i].index=i+1;
-		nod[i].value=intersectionFeature[i].slashLength/slashMaxLength;
+		feature[i]=intersectionFeature[i].slashLength/slashMaxLength;
 	}
-	nod[360].index=-1;
-	labelSVM= svm_predict(m,nod);
+	double labelSVM= classifier.Predict(&feature[0], 360);
 
 	ofstream output;
 	output.open("intersection.txt");
 	output<<"labelSVM:"<<labelSVM<<endl;
 	for(int j=0;j<360;j++)
-		output<<j<<":"<<"  "<<nod[j].value;
+		output<<j<<":"<<"  "<<feature[j];
 	output.close();
 
 	if(labelSVM>0.5)
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <math.h>
 #include<cmath>
+#include <algorithm>
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -687,6 +688,18 @@ void TrackerManager::GetTwoScanRoll(Scan *CurrentScan,Scan *preScan)//???
 	//cout<<"delta_pos: "<<delta_Pos[0]<<" "<<delta_Pos[1]<<" "<<delta_Pos[2]<<endl;
 }
 
+/**
+ * Cost of continuing the track of a tracker with a cluster
+ */
+static double AssignmentCost(Tracker &tracker, clusterFeature &glu)
+{
+	float radiusDiff=fabs(tracker.statusList.back().radius-glu.radius);
+	float thetaDiff=fabs(tracker.statusList.back().theta-glu.theta);
+	float sizeDiff =abs(tracker.statusList.back().size-glu.size);
+	float positionDiff = sqrt(sqr(tracker.statusList.back().avg_x -glu.avg_x) + sqr(tracker.statusList.back().avg_z -glu.avg_z) ) ;
+	return radiusDiff*1.0 + thetaDiff*1.0  +  sizeDiff*0.8 + positionDiff * 0.03 ;
+}
+
 CMatrix TrackerManager::ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex)
 {
 	int clusterSize=scanRef.clusterNum;
@@ -705,11 +718,6 @@ CMatrix TrackerManager::ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex)
 	CMatrix costMatrix(maxSize,maxSize);
 
 	int i=0,j,k;
-	double costValue;
-	float radiusDiff;
-	float thetaDiff;
-	float sizeDiff;
-	float positionDiff;
 	CMatrix standardDeviation(2,2),measurementErro(2,1);
 	Measurement predictMeasurement;
 	bool IsSmaller1,IsSmaller2;
@@ -750,12 +758,7 @@ CMatrix TrackerManager::ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex)
 
 			if (IsSmaller1&&IsSmaller2)
 			{
-				radiusDiff=fabs(tracker.statusList.back().radius-glu.radius);
-				thetaDiff=fabs(tracker.statusList.back().theta-glu.theta);
-				sizeDiff =abs(tracker.statusList.back().size-glu.size);
-				positionDiff = sqrt(sqr(tracker.statusList.back().avg_x -glu.avg_x) + sqr(tracker.statusList.back().avg_z -glu.avg_z) ) ;
-				costValue= radiusDiff*1.0 + thetaDiff*1.0  +  sizeDiff*0.8 + positionDiff * 0.03 ;
-				costMatrix.m_pTMatrix[i][k]=costValue;
+				costMatrix.m_pTMatrix[i][k]=AssignmentCost(tracker,glu);
 			}
 			else
 			{
@@ -798,73 +801,223 @@ CMatrix TrackerManager::ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex)
 	return costMatrix;
 }
 
-int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
+/**
+ * Sparse version of ConstructCostMatrix, only the pairs within the gate of
+ * a tracker are listed. The clusters are sorted by x, so that those within
+ * the gate are found by binary search.
+ */
+void TrackerManager::GateTracksWithClusters(VeloScan &scanRef,
+                                            vector<int> &clusterIndex,
+                                            vector<TrackClusterCost> &costs)
 {
-//	cout<<"MatchTracksWithClusters is running!"<<endl;
-	if (tracks.empty())
+	int j;
+	clusterIndex.clear();
+	costs.clear();
+
+	vector<pair<double,int> > byX;
+	for(j=0;j<scanRef.scanClusterArray.size();j++)
 	{
-		return 0;
+		if(clusterStatus.size()!=0&&clusterStatus[j].FilterRet==false)
+			continue;
+		byX.push_back(make_pair((double)scanRef.scanClusterFeatureArray[j].avg_x,
+		                        (int)clusterIndex.size()));
+		clusterIndex.push_back(j);
 	}
+	sort(byX.begin(),byX.end());
 
-	CMatrix costMatrix;
-	int clusterSize=scanRef.clusterNum;
-	int trackSize=getNumberofTracker();
-	int *clusterIndex;
-	clusterIndex=new int[clusterSize];
-	costMatrix=ConstructCostMatrix(scanRef,clusterIndex);
-	int dim=costMatrix.m_nCol;
-
-	//FILE *fp=fopen("F:\\VeloSlamTemp\\bin\\Release\\CostMatix.txt","a");
-	//fprintf(fp,"scanID:%d\n",scanRef.scanid);
-	//for (int m=0;m<dim;m++)
-	//{
-	//	for (int l=0;l<dim;l++)
-	//	{
-	//		fprintf(fp,"%.1f\t",costMatrix.m_pTMatrix[m][l]);
-
-	//	}
-	//	fprintf(fp,"\n");
-	//}
-	//fclose(fp);
-
-	int *colsol,*rowsol;
-	colsol=new int[dim];
-	rowsol=new int[dim];
-
-	double *u,*v;
-	u=new double[dim];
-	v=new double[dim];
+	CMatrix standardDeviation(2,2);
+	Measurement predictMeasurement;
+	float kg;
+
+	int i=0;
+	list<Tracker>::iterator it;
+	for(it=tracks.begin(); it!=tracks.end(); it++, i++)
+	{
+		Tracker &tracker=*it;
+
+		predictMeasurement=tracker.kalmanFilter.GetPredictMeasurement(rollAngle,delta_Pos);
+		standardDeviation=tracker.kalmanFilter.CalMeasureDeviation();
+
+		if (tracker.missMatch)
+		{
+			kg=1.5*KG;
+		}
+		else
+		{
+			kg=KG;
+		}
+
+		double gateX=kg*standardDeviation.m_pTMatrix[0][0];
+		double gateZ=kg*standardDeviation.m_pTMatrix[1][1];
+
+		// one unit of slack, the exact gate is tested below
+		vector<pair<double,int> >::iterator first=lower_bound(byX.begin(),
+		  byX.end(), make_pair(predictMeasurement.x_measurement-gateX-1.0, -1));
+		for(; first!=byX.end() &&
+		      first->first<predictMeasurement.x_measurement+gateX+1.0; ++first)
+		{
+			int k=first->second;
+			clusterFeature &glu=scanRef.scanClusterFeatureArray[clusterIndex[k]];
+
+			if (fabs(glu.avg_x-predictMeasurement.x_measurement)<gateX &&
+			    fabs(glu.avg_z-predictMeasurement.z_measurement)<gateZ)
+			{
+				TrackClusterCost c;
+				c.track=i;
+				c.cluster=k;
+				c.cost=AssignmentCost(tracker,glu);
+				costs.push_back(c);
+			}
+		}
+	}
+}
 
+static int FindRoot(vector<int> &parent, int i)
+{
+	while(parent[i]!=i)
+	{
+		parent[i]=parent[parent[i]];
+		i=parent[i];
+	}
+	return i;
+}
+
+/**
+ * Solves the assignment of one connected part of the gated cost graph
+ * with the dense LAP solver, pairs outside the gates cost BIGNUM as in
+ * ConstructCostMatrix.
+ * @param costs pairs of the part with local track and cluster indices
+ * @param match receives the local cluster of each local track, -1 if none
+ */
+static void SolveAssignment(int trackSize, int clusterSize,
+                            const vector<TrackClusterCost> &costs,
+                            vector<int> &match)
+{
 	int i,j;
-	bool *missFlag;
-	missFlag=new bool[trackSize];
-	for (i=0;i<trackSize;i++)
+	match.assign(trackSize,-1);
+
+	if (trackSize==1 && clusterSize==1)
 	{
-		missFlag[i]=false;
+		match[0]=0;
+		return;
 	}
 
+	int dim=trackSize>clusterSize?trackSize:clusterSize;
+
 	double **assignCost;
 	assignCost = new double*[dim];
 	for (i = 0; i < dim; i++)
-		assignCost[i] = new double[dim];
-
-	for (i=0;i<dim;i++)
 	{
+		assignCost[i] = new double[dim];
 		for (j=0;j<dim;j++)
-		{
-			assignCost[i][j]=costMatrix.m_pTMatrix[i][j];
-		}
+			assignCost[i][j]=BIGNUM;
 	}
+	for (i=0;i<costs.size();i++)
+		assignCost[costs[i].track][costs[i].cluster]=costs[i].cost;
+
+	int *colsol=new int[dim];
+	int *rowsol=new int[dim];
+	double *u=new double[dim];
+	double *v=new double[dim];
 
 	lap(dim,assignCost,rowsol,colsol,u,v);
 
 	for (i=0;i<trackSize;i++)
 	{
 		int col=rowsol[i];
-		if (assignCost[i][col]==BIGNUM)
+		if (assignCost[i][col]!=BIGNUM)
+			match[i]=col;
+	}
+
+	for (i = 0; i < dim; i++)
+		delete[] assignCost[i];
+	delete[] assignCost;
+	delete[] rowsol;
+	delete[] colsol;
+	delete[] u;
+	delete[] v;
+}
+
+/**
+ * Assigns the trackers to the clusters like a LAP over the dense cost
+ * matrix of ConstructCostMatrix. Pairs outside the gates all cost BIGNUM,
+ * so the trackers and clusters that are not connected by gated pairs do
+ * not influence each other and every connected part is solved on its own.
+ */
+int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
+{
+//	cout<<"MatchTracksWithClusters is running!"<<endl;
+	if (tracks.empty())
+	{
+		return 0;
+	}
+
+	int i;
+	int trackSize=getNumberofTracker();
+	vector<int> clusterIndex;
+	vector<TrackClusterCost> costs;
+	GateTracksWithClusters(scanRef,clusterIndex,costs);
+	int clusterSize=clusterIndex.size();
+
+	// trackers are the nodes 0..trackSize-1 of the graph, clusters follow
+	vector<int> parent(trackSize+clusterSize);
+	for (i=0;i<parent.size();i++)
+		parent[i]=i;
+	for (i=0;i<costs.size();i++)
+	{
+		int a=FindRoot(parent,costs[i].track);
+		int b=FindRoot(parent,trackSize+costs[i].cluster);
+		if (a!=b)
+			parent[b]=a;
+	}
+
+	// collect the parts with at least one gated pair, in local indices
+	vector<int> part(trackSize+clusterSize,-1);
+	vector<int> local(trackSize+clusterSize,-1);
+	vector<vector<int> > tracksOf, clustersOf;
+	vector<vector<TrackClusterCost> > costsOf;
+	for (i=0;i<costs.size();i++)
+	{
+		int t=costs[i].track;
+		int c=trackSize+costs[i].cluster;
+		int root=FindRoot(parent,t);
+		if (part[root]<0)
+		{
+			part[root]=tracksOf.size();
+			tracksOf.push_back(vector<int>());
+			clustersOf.push_back(vector<int>());
+			costsOf.push_back(vector<TrackClusterCost>());
+		}
+		int n=part[root];
+		if (local[t]<0)
 		{
-			missFlag[i]=true;
+			local[t]=tracksOf[n].size();
+			tracksOf[n].push_back(t);
 		}
+		if (local[c]<0)
+		{
+			local[c]=clustersOf[n].size();
+			clustersOf[n].push_back(costs[i].cluster);
+		}
+		TrackClusterCost lc;
+		lc.track=local[t];
+		lc.cluster=local[c];
+		lc.cost=costs[i].cost;
+		costsOf[n].push_back(lc);
+	}
+
+	// cluster of each tracker as index into clusterIndex, -1 if missed
+	vector<int> matchOf(trackSize,-1);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int n=0;n<(int)tracksOf.size();n++)
+	{
+		vector<int> match;
+		SolveAssignment(tracksOf[n].size(),clustersOf[n].size(),costsOf[n],match);
+		for (int t=0;t<match.size();t++)
+			if (match[t]>=0)
+				matchOf[tracksOf[n][t]]=clustersOf[n][match[t]];
 	}
 
 	int trackerIndex=-1;
@@ -875,7 +1028,7 @@ int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
 		Tracker &tracker=*it;
 		trackNO ++;
 		trackerIndex++;
-		if (missFlag[trackerIndex])
+		if (matchOf[trackerIndex]<0)
 		{
 			tracker.missMatch=true;
 			tracker.missedTime++;
@@ -883,8 +1036,7 @@ int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
 		}
 		else
 		{
-			int clusterID=rowsol[trackerIndex];
-			int matchID=clusterIndex[clusterID];
+			int matchID=clusterIndex[matchOf[trackerIndex]];
 			//cout<<"TrackerID: "<<tracker.trackerID<<"scanID: "<<scanRef.scanid<<"MatchID: "<<matchID<<endl;
 			scanRef.scanClusterFeatureArray[matchID].trackNO = trackNO;
 
@@ -917,13 +1069,5 @@ int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
 
 	}
 
-	delete[] assignCost;
-	delete[] rowsol;
-	delete[] colsol;
-	delete[] u;
-	delete[] v;
-	delete[] clusterIndex;
-	delete[] missFlag;
-
 	return 0;
 }
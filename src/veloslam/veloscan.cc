@@ -112,6 +112,7 @@ VeloScan::VeloScan()
 //    : BasicScan()
 {
     isTrackerHandled =false;
+    scanColumns=scanRings=0;
 }
 
 /**
@@ -137,10 +138,169 @@ VeloScan::VeloScan(const VeloScan& s)
 { }
 */
 
+/**
+ * Fills in a point of the scan together with its polar coordinates
+ */
+static void SetPolarPoint(Point &pt, const double *xyz, int id)
+{
+    pt.x = xyz[0];
+    pt.y = xyz[1];
+    pt.z = xyz[2];
+
+    pt.point_id = id;  //important   for find point in  scans  ---raw points
+
+    pt.rad = sqrt(pt.x*pt.x + pt.z*pt.z);
+    pt.tan_theta = pt.z/pt.x ;
+}
+
+/**
+ * Azimuth column of a point, looked up in the tangents of one octant
+ * @return column of the point, -1 if it is lost
+ */
+static int AzimuthColumn(const Point &pt, const vector<float> &tanv,
+                         int sectionSize)
+{
+    float flag;
+    int offset;
+    int diff;
+    vector<float>::const_iterator result;
+
+    // some point losted which on the vline or hline
+    if(pt.x >=0 && pt.z>=0 )
+    {
+        if(pt.x > pt.z)
+        {
+            flag= pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize-1;
+            }
+            else
+            {
+                offset=result-tanv.begin();
+            }
+        }
+        else
+        {
+            flag=1/pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize;
+            }
+            else
+            {
+                diff=result-tanv.begin();
+                offset=sectionSize*2-1-(diff);
+            }
+
+        }
+    }
+
+    else if(pt.x <= 0 && pt.z >=0)
+    {
+        if(-pt.x>pt.z)
+        {
+            flag=-pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize*3;
+            }
+            else
+            {
+                offset=sectionSize*4-1-(result-tanv.begin());
+            }
+
+        }
+        else
+        {
+            flag=1/-pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize*3-1;
+            }
+            else
+            {
+                offset=sectionSize*2+(result-tanv.begin());
+            }
+        }
+    }
+
+    else if(pt.x<=0 && pt.z<=0)
+    {
+        if(-pt.x>-pt.z)
+        {
+            flag=pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize*5-1;
+            }
+            else
+            {
+                offset=sectionSize*4+(result-tanv.begin());
+            }
+        }
+        else
+        {
+            flag=1/pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize*5;
+            }
+            else
+            {
+                offset=sectionSize*6-1-(result-tanv.begin());
+            }
+
+        }
+    }
+
+    else if(pt.x>=0&&pt.z<=0)
+    {
+        if(pt.x>-pt.z)
+        {
+            flag=-pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize*7;
+            }
+            else
+            {
+                offset=sectionSize*8-1-(result-tanv.begin());
+            }
+        }
+        else
+        {
+            flag=1/-pt.tan_theta;
+            result=upper_bound(tanv.begin(),tanv.end(),flag);
+            if(result==tanv.end())
+            {
+                offset=sectionSize*7-1;
+            }
+            else
+            {
+                offset=sectionSize*6+(result-tanv.begin());
+            }
+        }
+    }
+
+    else
+    {
+        return -1;
+    }
+
+    return offset;
+}
+
 int VeloScan::TransferToCellArray(int maxDist, int minDist)
 {
 #define  DefaultColumnSize 360
-    Point P;
     DataXYZ xyz(get("xyz"));
     int size= xyz.size();
 
@@ -153,10 +313,8 @@ int VeloScan::TransferToCellArray(int maxDist, int minDist)
     if((MaxRad-MinRad)%CellSize!=0)
         CellSize=10;
 
-    int i,j,count=0;
+    int i,j;
     int CellNumber=(MaxRad-MinRad)/CellSize;
-    float flag;
-    int offset;
 
     if(columnSize==0)
         return -1;
@@ -166,170 +324,69 @@ int VeloScan::TransferToCellArray(int maxDist, int minDist)
 
     int sectionSize=columnSize/8;
 
-    scanCellArray.resize(columnSize);
-    for(i=0; i<columnSize; ++i)
-        scanCellArray[i].resize(CellNumber);
+    scanColumns=columnSize;
+    scanRings=CellNumber;
+    int nrCells=columnSize*CellNumber;
 
     float inc=(M_PI*2)/columnSize;
 
     vector<float> tanv;
-    vector<float>::iterator result;
 
     for(i=0; i<sectionSize; ++i)
     {
         tanv.push_back(tan(inc*i));
     }
 
-    int diff;
+    // find the cell of every point first, then sort the points by cell so
+    // that the points of a cell lie next to each other in scanPoints
+    vector<int> cellOf(size);
 
-    for(i=0; i<size; ++i)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int p=0; p<size; ++p)
     {
-            count++;
             Point pt;
-            pt.x = xyz[i][0];
-            pt.y = xyz[i][1];
-            pt.z = xyz[i][2];
-
-			pt.point_id = i;  //important   for find point in  scans  ---raw points
-
-            pt.rad = sqrt(pt.x*pt.x + pt.z*pt.z);
-            pt.tan_theta = pt.z/pt.x ;
+            SetPolarPoint(pt, xyz[p], p);
+            cellOf[p]=-1;
 
             if(pt.rad <=MinRad || pt.rad>=MaxRad)
                 continue;
 
-            // some point losted which on the vline or hline
-            if(pt.x >=0 && pt.z>=0 )
-            {
-                if(pt.x > pt.z)
-                {
-                    flag= pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize-1;
-                    }
-                    else
-                    {
-                        offset=result-tanv.begin();
-                    }
-                }
-                else
-                {
-                    flag=1/pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize;
-                    }
-                    else
-                    {
-                        diff=result-tanv.begin();
-                        offset=sectionSize*2-1-(diff);
-                    }
-
-                }
-            }
-
-            else if(pt.x <= 0 && pt.z >=0)
-            {
-                if(-pt.x>pt.z)
-                {
-                    flag=-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*3;
-                    }
-                    else
-                    {
-                        offset=sectionSize*4-1-(result-tanv.begin());
-                    }
-
-                }
-                else
-                {
-                    flag=1/-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*3-1;
-                    }
-                    else
-                    {
-                        offset=sectionSize*2+(result-tanv.begin());
-                    }
-                }
-            }
-
-            else if(pt.x<=0 && pt.z<=0)
-            {
-                if(-pt.x>-pt.z)
-                {
-                    flag=pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*5-1;
-                    }
-                    else
-                    {
-                        offset=sectionSize*4+(result-tanv.begin());
-                    }
-                }
-                else
-                {
-                    flag=1/pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*5;
-                    }
-                    else
-                    {
-                        offset=sectionSize*6-1-(result-tanv.begin());
-                    }
+            int offset=AzimuthColumn(pt, tanv, sectionSize);
+            if(offset<0)
+                continue;
 
-                }
-            }
+            int k= (int)((pt.rad-MinRad)/(CellSize*1.0));
+            if(k>=CellNumber)
+                k=CellNumber-1;
+            cellOf[p]=offset*CellNumber+k;
+    }
 
-            else if(pt.x>=0&&pt.z<=0)
-            {
-                if(pt.x>-pt.z)
-                {
-                    flag=-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*7;
-                    }
-                    else
-                    {
-                        offset=sectionSize*8-1-(result-tanv.begin());
-                    }
-                }
-                else
-                {
-                    flag=1/-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*7-1;
-                    }
-                    else
-                    {
-                        offset=sectionSize*6+(result-tanv.begin());
-                    }
-                }
-            }
+    vector<int> start(nrCells+1, 0);
+    for(i=0; i<size; ++i)
+        if(cellOf[i]>=0)
+            ++start[cellOf[i]+1];
+    for(i=0; i<nrCells; ++i)
+        start[i+1]+=start[i];
 
-            else
-            {
-                continue;
-            }
+    scanPoints.resize(start[nrCells]);
+    vector<int> next(start.begin(), start.end()-1);
+    for(i=0; i<size; ++i)
+    {
+        if(cellOf[i]<0)
+            continue;
+        SetPolarPoint(scanPoints[next[cellOf[i]]++], xyz[i], i);
+    }
 
-            int k= (int)((pt.rad-MinRad)/(CellSize*1.0));
-            scanCellArray[offset][k].push_back(&pt);
+    scanCells.clear();
+    scanCells.resize(nrCells);
+    for(i=0; i<nrCells; ++i)
+    {
+        cell &cellObj=scanCells[i];
+        cellObj.reserve(start[i+1]-start[i]);
+        for(j=start[i]; j<start[i+1]; ++j)
+            cellObj.push_back(&scanPoints[j]);
     }
 	return 0;
 }
@@ -439,100 +496,61 @@ int VeloScan::CalcCellFeature(cell& cellobj, cellFeature& f)
 
 int VeloScan::CalcScanCellFeature()
 {
-    int i,j;
+    int nrCells=scanCells.size();
 
-    if( scanCellArray.size()==0)
+    if(nrCells==0)
         return -1;
 
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
-
-    if( scanCellFeatureArray.size()==0)
-    {
-        scanCellFeatureArray.resize(columnSize);
-        for(i=0; i<columnSize; ++i)
-            scanCellFeatureArray[i].resize(cellNumber);
-    }
+    scanCellFeatures.clear();
+    scanCellFeatures.resize(nrCells);
 
-    for(j=0; j <columnSize; j++)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int i=0; i<nrCells; i++)
     {
-        cellColumn &column=scanCellArray[j];
-        cellNumber=column.size();
-        for( i=0; i<cellNumber; i++)
-        {
-            cell &cellObj=scanCellArray[j][i];
-            cellFeature &feature=scanCellFeatureArray[j][i];
+        cell &cellObj=scanCells[i];
+        cellFeature &feature=scanCellFeatures[i];
 
-			feature.columnID=j;
-			feature.cellID=i;
+        feature.columnID=i/scanRings;
+        feature.cellID=i%scanRings;
 
-            feature.pCell=&cellObj;
-            CalcCellFeature(cellObj,feature);
-
-//	         if( feature.delta_y > 120)
-//             {
-//				 scanCellFeatureArray[j][i].cellType |= CELL_TYPE_STATIC;
-//				 for(int k=0;k <scanCellArray[j][i].size(); k++)
-//					 scanCellArray[j][i][k]->type |= POINT_TYPE_ABOVE_DELTA_Y;
-//
-//			 }
-
-        }
+        feature.pCell=&cellObj;
+        CalcCellFeature(cellObj,feature);
     }
 
     return 0;
 }
 
-int VeloScan::SearchNeigh(cluster& clu,charvv& flagvv,int i,int j)
-{
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
-
-	if(i==-1)
-		i= columnSize-1;
-
-	if(i==columnSize)
-		i= 0;
-
-
-    if(i<0||i>=columnSize||j<0||j>=cellNumber)
-        return 0;
-
-    if(flagvv[i][j]==1)
-        return 0;
-    if(scanCellFeatureArray[i][j].size==0)
-    {
-        flagvv[i][j]=1;
-        return 0;
-    }
+/**
+ * Offsets (column, ring) of the neighbours of a cell that come after it in
+ * scan order. Together with the mirrored ones they form the twelve cells a
+ * cluster grows into.
+ */
+static const int forwardNeigh[6][2] =
+  { {0,1}, {0,2}, {1,-1}, {1,0}, {1,1}, {2,0} };
 
-    if(scanCellFeatureArray[i][j].cellType & CELL_TYPE_STATIC)
+static int FindRoot(vector<int> &parent, int i)
+{
+    while(parent[i]!=i)
     {
-        flagvv[i][j]=1;
-
-    	clu.push_back(&scanCellFeatureArray[i][j]);
-
-        SearchNeigh(clu,flagvv,i-1,j-1);
-        SearchNeigh(clu,flagvv,i-1,j);
-        SearchNeigh(clu,flagvv,i-1,j+1);
-        SearchNeigh(clu,flagvv,i,j-1);
-        SearchNeigh(clu,flagvv,i,j+1);
-        SearchNeigh(clu,flagvv,i+1,j-1);
-        SearchNeigh(clu,flagvv,i+1,j);
-        SearchNeigh(clu,flagvv,i+1,j+1);
-
-		SearchNeigh(clu,flagvv,i,j+2);
-		SearchNeigh(clu,flagvv,i,j-2);
-		SearchNeigh(clu,flagvv,i+2,j);
-		SearchNeigh(clu,flagvv,i-2,j);
-
-		//SearchNeigh(clu,flagvv,i,j+3);
-		//SearchNeigh(clu,flagvv,i,j-3);
-		//SearchNeigh(clu,flagvv,i+3,j);
-		//SearchNeigh(clu,flagvv,i-3,j);
+        parent[i]=parent[parent[i]];
+        i=parent[i];
     }
+    return i;
+}
 
-    return 0;
+/**
+ * Joins the sets of two cells, the root of a set is always its first cell
+ */
+static void UniteCells(vector<int> &parent, int a, int b)
+{
+    a=FindRoot(parent,a);
+    b=FindRoot(parent,b);
+    if(a<b)
+        parent[b]=a;
+    else if(b<a)
+        parent[a]=b;
 }
 
 int VeloScan::CalcClusterFeature(cluster& clu, clusterFeature& f)
@@ -604,30 +622,101 @@ int VeloScan::CalcClusterFeature(cluster& clu, clusterFeature& f)
 
 int VeloScan::FindAndCalcScanClusterFeature()
 {
-    int i,j;
+    int i;
 
-    if( scanCellArray.size()==0)
+    if( scanCellFeatures.size()==0)
         return -1;
 
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
+    int columnSize=scanColumns;
+    int cellNumber=scanRings;
+    int nrCells=scanCellFeatures.size();
 
-    charvv searchedFlag;
-    searchedFlag.resize(columnSize);
-    for(i=0; i<columnSize; ++i)
-        searchedFlag[i].resize(cellNumber,0);
+    vector<char> isStatic(nrCells);
+    vector<int> parent(nrCells);
+    for(i=0; i<nrCells; ++i)
+    {
+        isStatic[i]=scanCellFeatures[i].size!=0 &&
+          (scanCellFeatures[i].cellType & CELL_TYPE_STATIC);
+        parent[i]=i;
+    }
+
+    // label the cells of each sector of columns on its own, a union within
+    // a sector only touches cells of that sector
+    int sectors=1;
+#ifdef _OPENMP
+    sectors=omp_get_max_threads();
+#endif
+    if(sectors>columnSize/4)
+        sectors=columnSize/4>0 ? columnSize/4 : 1;
 
-    for(i=0; i<columnSize; ++i)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int s=0; s<sectors; ++s)
     {
-        for(j=0; j<cellNumber; ++j)
+        int first=s*columnSize/sectors;
+        int last=(s+1)*columnSize/sectors;
+        for(int c=first; c<last; ++c)
         {
-            cluster clu;
-            SearchNeigh(clu,searchedFlag,i,j);
-            if(clu.size())
-                scanClusterArray.push_back(clu);
+            for(int r=0; r<cellNumber; ++r)
+            {
+                int id=c*cellNumber+r;
+                if(!isStatic[id])
+                    continue;
+                for(int n=0; n<6; ++n)
+                {
+                    int nc=c+forwardNeigh[n][0];
+                    int nr=r+forwardNeigh[n][1];
+                    if(nc>=last || nr<0 || nr>=cellNumber)
+                        continue;
+                    if(isStatic[nc*cellNumber+nr])
+                        UniteCells(parent,id,nc*cellNumber+nr);
+                }
+            }
         }
     }
 
+    // join the sectors, the last column is followed by the first one
+    for(int s=0; s<sectors; ++s)
+    {
+        int first=s*columnSize/sectors;
+        int last=(s+1)*columnSize/sectors;
+        for(int c=(last-2>first ? last-2 : first); c<last; ++c)
+        {
+            for(int r=0; r<cellNumber; ++r)
+            {
+                int id=c*cellNumber+r;
+                if(!isStatic[id])
+                    continue;
+                for(int n=0; n<6; ++n)
+                {
+                    int nc=c+forwardNeigh[n][0];
+                    int nr=r+forwardNeigh[n][1];
+                    if(nc<last || nr<0 || nr>=cellNumber)
+                        continue;
+                    nc%=columnSize;
+                    if(isStatic[nc*cellNumber+nr])
+                        UniteCells(parent,id,nc*cellNumber+nr);
+                }
+            }
+        }
+    }
+
+    // clusters are numbered in the order of their first cell
+    vector<int> clusterOf(nrCells,-1);
+    for(i=0; i<nrCells; ++i)
+    {
+        if(!isStatic[i])
+            continue;
+        int root=FindRoot(parent,i);
+        if(clusterOf[root]<0)
+        {
+            clusterOf[root]=scanClusterArray.size();
+            scanClusterArray.push_back(cluster());
+        }
+        scanClusterArray[clusterOf[root]].push_back(&scanCellFeatures[i]);
+    }
+
 	int clustersize=scanClusterArray.size();
 	if(scanClusterFeatureArray.size()==0)
 		scanClusterFeatureArray.resize(clustersize);
@@ -644,39 +733,13 @@ int VeloScan::FindAndCalcScanClusterFeature()
 
 void VeloScan::FreeAllCellAndCluterMemory()
 {
-    int i,j;
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
-
-    for(j=0; j <columnSize; j++)
-    {
-        cellColumn &column=scanCellArray[j];
-        cellFeatureColumn &columnFeature=scanCellFeatureArray[j];
-
-        cellNumber=column.size();
-        for( i=0; i<cellNumber; i++)
-        {
-            cell &cellObj=scanCellArray[j][i];
-            cellFeature &feature=scanCellFeatureArray[j][i];
-            cellObj.clear();
-
-        }
-        column.clear();
-        columnFeature.clear();
-    }
-
-	scanCellArray.clear();
-	scanCellFeatureArray.clear();
-    int ClusterSize=scanClusterArray.size();
-    for(j=0; j <ClusterSize; j++)
-    {
-        cluster &cludata=scanClusterArray[j];
-        clusterFeature &clu=scanClusterFeatureArray[j];
-        cludata.clear();
-  //      clu.clear();
-    }
 	scanClusterArray.clear();
 	scanClusterFeatureArray.clear();
+
+	vector<cellFeature>().swap(scanCellFeatures);
+	vector<cell>().swap(scanCells);
+	vector<Point>().swap(scanPoints);
+	scanColumns=scanRings=0;
 }
 
 void VeloScan::calcReducedPoints_byClassifi(double voxelSize, int nrpts, PointType pointtype)
@@ -923,35 +986,26 @@ void VeloScan::ClassifibyTrackingAllObject(int currentNO ,int windowsize )
 
 void VeloScan::MarkStaticorMovingPointCloud()
 {
-	int i,j,k;
-    DataXYZ xyz(get("xyz"));
+	int i,k;
 	DataType Pt(get("type"));
 
-	int startofpoint  = 0;
-	int colMax=  scanCellFeatureArray.size();
-	for(i=0; i<colMax; ++i)
+	int nrCells=  scanCellFeatures.size();
+	for(i=0; i<nrCells; ++i)
 	{
-		cellFeatureColumn  &gFeatureCol = scanCellFeatureArray[i];
-		int rowMax= gFeatureCol.size();
-		for(j=0;j< rowMax; ++j)
-		{
-		   cellFeature &gcellFreature =  gFeatureCol[j];
-		   startofpoint += gcellFreature.pCell->size();
-		   cell &gCell =*( gcellFreature.pCell);
+	   cellFeature &gcellFreature =  scanCellFeatures[i];
+	   cell &gCell =*( gcellFreature.pCell);
 
-		   for( k=0; k< gcellFreature.pCell->size();++k)
-		   {
-			        // find Point in scan raw points by point_id;
-					Point p = *(gCell[k]);
-				   if(gcellFreature.cellType & CELL_TYPE_STATIC)
-					   Pt[p.point_id] = POINT_TYPE_STATIC_OBJECT;
-    			   if(gcellFreature.cellType & CELL_TYPE_MOVING)
-					   Pt[p.point_id] = POINT_TYPE_MOVING_OBJECT;
-    			   if(gcellFreature.cellType & CELL_TYPE_GROUND)
-					   Pt[p.point_id] = POINT_TYPE_GROUND;
-		   }
-
-		}
+	   for( k=0; k< gCell.size();++k)
+	   {
+			// find Point in scan raw points by point_id;
+			const Point &p = *(gCell[k]);
+			if(gcellFreature.cellType & CELL_TYPE_STATIC)
+				Pt[p.point_id] = POINT_TYPE_STATIC_OBJECT;
+			if(gcellFreature.cellType & CELL_TYPE_MOVING)
+				Pt[p.point_id] = POINT_TYPE_MOVING_OBJECT;
+			if(gcellFreature.cellType & CELL_TYPE_GROUND)
+				Pt[p.point_id] = POINT_TYPE_GROUND;
+	   }
 	}
 }
 
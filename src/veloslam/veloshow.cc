@@ -23,6 +23,7 @@
 #include "show/compacttree.h"
 #include "show/NurbsPath.h"
 #include "show/vertexarray.h"
+#include "show/pagedlod.h"
 #include "slam6d/scan.h"
 #include "veloslam/veloscan.h"
 #include "glui/glui.h"  /* Header File For The glui functions */
@@ -70,6 +71,10 @@ vector< ::SDisplay*> displays;
  */
 //Show_BOctTree **octpts;
 vector<colordisplay*> octpts;
+/**
+ * veloshow does not use the out-of-core level of detail hierarchy
+ */
+PagedLOD *paged_lod = 0;
 /**
  * Storing the base directory
  */
@@ -298,6 +303,10 @@ char *selection_file_name;
 
 int current_frame = 0;
 
+// veloshow creates its octrees while reading, nothing is loaded in background
+bool publishLoadedOctrees() { return false; }
+void joinOctreeLoaders() {}
+
 #include "../show/show_menu.cc"
 #include "../show/show_animate.cc"
 #include "../show/show_gl.cc"
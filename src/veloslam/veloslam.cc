@@ -294,6 +294,14 @@ void usage(char* prog)
     << "         start at scan NR (i.e., neglects the first NR scans)" << endl
     << "         [ATTENTION: counting naturally starts with 0]" << endl
     << endl
+    << bold << "  --stream" << normal << "[=NR]" << endl
+    << "         streaming mode, replays the revolutions at NR Hz [default: 10] through a" << endl
+    << "         pipeline of segmentation and registration, drops revolutions that cannot" << endl
+    << "         be taken up in time and reports the latency of each stage" << endl
+    << endl
+    << bold << "  --budget=" << normal << "NR   [default: one revolution]" << endl
+    << "         latency budget of a revolution in streaming mode in ms" << endl
+    << endl
     << bold << "  -t" << normal << " NR, " << bold << "--nns_method=" << normal << "NR   [default: 1]" << endl
     << "         selects the Nearest Neighbor Search Algorithm" << endl
     << "           0 = simple k-d tree " << endl
@@ -398,6 +406,8 @@ void parseFormatFile(string& dir, WriteOnce<IOType>& type, WriteOnce<int>& start
  * @param lum6DAlgo specifies the used algorithm for global SLAM correction
  * @param loopsize defines the minimal loop size
  * @param tracking select sematic algorithm of none/classification/tracking on/off the point classification mode
+ * @param stream_rate revolutions per second in streaming mode, 0 if off
+ * @param budget latency budget of a revolution in streaming mode (ms)
  * @return 0, if the parsing was successful. 1 otherwise
  */
 int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
@@ -407,7 +417,7 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     int &mni_lum, string &net, double &cldist, int &clpairs, int &loopsize,int &trackingAlgo,
     double &epsilonICP, double &epsilonSLAM,  int &nns_method, bool &exportPts, double &distLoop,
     int &iterLoop, double &graphDist, int &octree, IOType &type,
-    bool& scanserver)
+    bool& scanserver, int &stream_rate, double &budget)
 {
   int  c;
   // from unistd.h:
@@ -456,6 +466,8 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     { "graphDist",       required_argument,   0,  '3' }, // use the long format only
     { "trackingAlgo",    required_argument,   0,  'y' }, //tracking algorithm
     { "scanserver",      no_argument,         0,  'S' },
+    { "stream",          optional_argument,   0,  '7' }, // use the long format only
+    { "budget",          required_argument,   0,  '0' }, // use the long format only
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
@@ -607,6 +619,13 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
       case 'S':
         scanserver = true;  // maybe some errors.
         break;
+      case '7':  // = --stream
+        stream_rate = optarg ? atoi(optarg) : 10;
+        if (stream_rate < 1) { cerr << "Error: The revolution rate has to be positive.\n"; exit(1); }
+        break;
+      case '0':  // = --budget
+        budget = atof(optarg);
+        break;
       case '?':
         usage(argv[0]);
         return 1;
@@ -957,6 +976,263 @@ void MatchTwoScan(icp6D *my_icp, VeloScan* currentScan, int scanCount, bool eP )
    				my_icp->match(PreviousScan, currentScan);
 		}
 }
+/**
+ * Milliseconds of wall clock time, usable from several threads
+ */
+static double StreamTime()
+{
+  static const boost::posix_time::ptime epoch =
+    boost::posix_time::microsec_clock::universal_time();
+  return (boost::posix_time::microsec_clock::universal_time() - epoch)
+    .total_microseconds() / 1000.0;
+}
+
+/**
+ * A revolution of the Velodyne on its way through the streaming pipeline
+ */
+struct Revolution {
+  VeloScan *scan;
+  /** index of the revolution in the input */
+  int index;
+  /** points in time the stages started and finished (ms) */
+  double arrival, seg_start, seg_end, icp_start, icp_end;
+};
+
+/**
+ * Hands the revolutions from one stage of the pipeline to the next. It holds
+ * at most a single revolution, i.e., a stage that falls behind always gets
+ * the newest one and the revolutions it missed are dropped.
+ */
+class RevolutionSlot {
+public:
+  RevolutionSlot() : full(false), closed(false) {}
+
+  /**
+   * @param dropped receives the revolution that had not been picked up yet
+   * @return true, if a revolution has been dropped
+   */
+  bool put(const Revolution &r, Revolution &dropped) {
+    boost::mutex::scoped_lock lock(mutex);
+    bool result = full;
+    if (full) dropped = rev;
+    rev = r;
+    full = true;
+    cond.notify_all();
+    return result;
+  }
+
+  /**
+   * Waits for the next revolution
+   * @return false, if the previous stage has finished
+   */
+  bool get(Revolution &r) {
+    boost::mutex::scoped_lock lock(mutex);
+    while (!full && !closed) cond.wait(lock);
+    if (!full) return false;
+    r = rev;
+    full = false;
+    return true;
+  }
+
+  void close() {
+    boost::mutex::scoped_lock lock(mutex);
+    closed = true;
+    cond.notify_all();
+  }
+
+private:
+  Revolution rev;
+  bool full, closed;
+  boost::mutex mutex;
+  boost::condition cond;
+};
+
+/** revolutions dropped by the pipeline, removed by the registration stage */
+static vector <VeloScan *> dropped_scans;
+static boost::mutex dropped_mutex;
+
+static void DropRevolution(const Revolution &r)
+{
+  boost::mutex::scoped_lock lock(dropped_mutex);
+  dropped_scans.push_back(r.scan);
+}
+
+/**
+ * First stage of the streaming mode: replays the revolutions at sensor
+ * rate. Each revolution is decoded from its packets and handed on as soon
+ * as it would have been completed by the sensor.
+ */
+static void ReplayRevolutions(const vector <VeloScan *> *scans, int rate,
+                              int maxDist, int minDist, double red,
+                              int octree, int nns_method, RevolutionSlot *out)
+{
+  double period = 1000.0 / rate;
+  double start = StreamTime();
+  for (unsigned int i = 0; i < scans->size(); i++) {
+    Revolution r;
+    r.scan = (*scans)[i];
+    r.index = i;
+    r.scan->setRangeFilter(maxDist, minDist);
+    r.scan->setReductionParameter(red, octree);
+    r.scan->setSearchTreeParameter(nns_method);
+    r.scan->isTrackerHandled = false;
+    r.scan->get("xyz");
+
+    double wait = start + (i + 1) * period - StreamTime();
+    if (wait > 0)
+      boost::this_thread::sleep(boost::posix_time::microseconds((long)(wait * 1000.0)));
+    r.arrival = StreamTime();
+
+    Revolution dropped;
+    if (out->put(r, dropped)) DropRevolution(dropped);
+  }
+  out->close();
+}
+
+/**
+ * Second stage of the streaming mode: segmentation and classification of
+ * a revolution, runs while the previous revolution is registered. Tracking
+ * needs the registered pose of the previous revolution and is left to the
+ * registration stage.
+ */
+static void SegmentRevolutions(RevolutionSlot *in, RevolutionSlot *out,
+                               int tracking, int maxDist, int minDist,
+                               double red, int octree)
+{
+  Revolution r;
+  while (in->get(r)) {
+    r.seg_start = StreamTime();
+    VeloScan *currentScan = r.scan;
+    if (tracking == 1 || tracking == 2)
+      currentScan->FindingAllofObject(maxDist, minDist);
+    if (tracking == 1)
+      currentScan->ClassifiAllofObject();
+    if (tracking == 0 || tracking == 1) {
+      currentScan->ExchangePointCloud();
+      currentScan->calcReducedPoints_byClassifi(red, octree, PointType());
+      currentScan->createSearchTree();
+    }
+    r.seg_end = StreamTime();
+
+    Revolution dropped;
+    if (out->put(r, dropped)) DropRevolution(dropped);
+  }
+  out->close();
+}
+
+/**
+ * Streaming mode: the revolutions pass a pipeline of replay, segmentation
+ * and registration, so that the segmentation of a revolution overlaps with
+ * the registration of its predecessor. Revolutions a stage could not take
+ * up in time are dropped. The latency of every stage is reported.
+ *
+ * @param my_icp the ICP implementation
+ * @param rate revolutions per second of the sensor
+ * @param budget maximal latency of a revolution (ms)
+ */
+void StreamSLAM(icp6D *my_icp, int rate, double budget, int tracking,
+                int trackingAlgo, int maxDist, int minDist, double red,
+                int octree, int nns_method, bool eP, bool quiet)
+{
+  vector <VeloScan *> scans;
+  for (ScanVector::iterator it = Scan::allScans.begin();
+       it != Scan::allScans.end(); ++it)
+    scans.push_back((VeloScan *)*it);
+
+  cout << "Streaming " << scans.size() << " revolutions at " << rate
+       << " Hz with a latency budget of " << budget << " ms" << endl;
+
+  RevolutionSlot segment_in, icp_in;
+  boost::thread replay(ReplayRevolutions, &scans, rate, maxDist, minDist,
+                       red, octree, nns_method, &segment_in);
+  boost::thread segment(SegmentRevolutions, &segment_in, &icp_in, tracking,
+                        maxDist, minDist, red, octree);
+
+  // sums and maxima of queueing, segmentation, registration and total time
+  double sum[4] = {0.0, 0.0, 0.0, 0.0}, max[4] = {0.0, 0.0, 0.0, 0.0};
+  int processed = 0, late = 0;
+  VeloScan *previous = 0;
+  Revolution r;
+
+  while (icp_in.get(r)) {
+    {
+      // dropped revolutions have to leave the scan list before indexing it
+      boost::mutex::scoped_lock lock(dropped_mutex);
+      for (unsigned int i = 0; i < dropped_scans.size(); i++) {
+        Scan::allScans.erase(std::find(Scan::allScans.begin(),
+                                       Scan::allScans.end(), dropped_scans[i]));
+        delete dropped_scans[i];
+      }
+      dropped_scans.clear();
+    }
+
+    r.icp_start = StreamTime();
+    VeloScan *currentScan = r.scan;
+    currentScan->scanid = scanCount;
+    if (tracking == 2) {
+      int windowsize = 3;
+      int currentNO = std::find(Scan::allScans.begin(), Scan::allScans.end(),
+                                currentScan) - Scan::allScans.begin();
+      currentScan->TrackingAllofObject(trackingAlgo);
+      currentScan->ClassifibyTrackingAllObject(currentNO, windowsize);
+      currentScan->ExchangePointCloud();
+      currentScan->calcReducedPoints_byClassifi(red, octree, PointType());
+      currentScan->createSearchTree();
+    }
+
+    if (previous) {
+      if (eP)
+        currentScan->mergeCoordinatesWithRoboterPosition(previous);
+      my_icp->match(previous, currentScan);
+    }
+    const double* p = currentScan->get_rPos();
+    Point x(p[0], p[1], p[2]);
+    VelodyneTrajectory.path.push_back(x);
+    previous = currentScan;
+    scanCount++;
+    current_sliding_window_pos++;
+    r.icp_end = StreamTime();
+
+    double t[4] = { r.seg_start - r.arrival + r.icp_start - r.seg_end,
+                    r.seg_end - r.seg_start,
+                    r.icp_end - r.icp_start,
+                    r.icp_end - r.arrival };
+    for (int i = 0; i < 4; i++) {
+      sum[i] += t[i];
+      if (t[i] > max[i]) max[i] = t[i];
+    }
+    processed++;
+    if (t[3] > budget) late++;
+
+    if (!quiet) {
+      cout << "revolution " << r.index << ": queued " << t[0]
+           << " ms, segmentation " << t[1] << " ms, registration " << t[2]
+           << " ms, latency " << t[3] << " ms"
+           << (t[3] > budget ? " (over budget)" : "") << endl;
+    }
+  }
+  replay.join();
+  segment.join();
+
+  // revolutions dropped after the last one that was registered
+  for (unsigned int i = 0; i < dropped_scans.size(); i++) {
+    Scan::allScans.erase(std::find(Scan::allScans.begin(),
+                                   Scan::allScans.end(), dropped_scans[i]));
+    delete dropped_scans[i];
+  }
+  dropped_scans.clear();
+
+  if (processed == 0) return;
+  const char *names[4] = { "queued", "segmentation", "registration", "latency" };
+  cout << "Streamed " << processed << " of " << scans.size()
+       << " revolutions, " << scans.size() - processed << " dropped, "
+       << late << " over budget" << endl;
+  for (int i = 0; i < 4; i++) {
+    cout << "  " << names[i] << ": mean " << sum[i] / processed
+         << " ms, max " << max[i] << " ms" << endl;
+  }
+}
+
 /**
  * Main program for 6D SLAM.
  * Usage: bin/slam6D 'dir',
@@ -1017,13 +1293,16 @@ int main(int argc, char **argv)
   IOType type  = UOS;
   int trackingAlgo=0;
   bool scanserver = false;
+  int stream_rate = 0;
+  double budget = -1.0;
 
   parseArgs(argc, argv, dir, red, rand, mdm, mdml, mdmll, mni, start, end,
       maxDist, minDist, quiet, veryQuiet, eP, meta, algo, tracking,
       loopSlam6DAlgo, lum6DAlgo, anim,
       mni_lum, net, cldist, clpairs, loopsize, trackingAlgo,epsilonICP, epsilonSLAM,
       nns_method, exportPts, distLoop, iterLoop, graphDist, octree, type,
-      scanserver);
+      scanserver, stream_rate, budget);
+  if (stream_rate > 0 && budget <= 0.0) budget = 1000.0 / stream_rate;
 	  
 
   cout << "VeloSLAM will proceed with the following parameters:" << endl;
@@ -1056,6 +1335,10 @@ int main(int argc, char **argv)
         StartShow();
     ICPFinished =true;
 
+    if (stream_rate > 0) {
+      StreamSLAM(my_icp, stream_rate, budget, tracking, trackingAlgo,
+                 maxDist, minDist, red, octree, nns_method, eP, quiet);
+    } else
     //Main Loop for ICP with Moving Object Detection and Tracking
     for(ScanVector::iterator it = Scan::allScans.begin();
         it != Scan::allScans.end(); 